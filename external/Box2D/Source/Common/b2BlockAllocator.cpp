@@ -53,13 +53,14 @@ struct b2Block
 	b2Block* next;
 };
 
-b2BlockAllocator::b2BlockAllocator()
+b2BlockAllocator::b2BlockAllocator(b2Arena* arena)
 {
 	b2Assert(b2_blockSizes < UCHAR_MAX);
 
+	m_arena = arena;
 	m_chunkSpace = b2_chunkArrayIncrement;
 	m_chunkCount = 0;
-	m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+	m_chunks = (b2Chunk*)AllocateChunk(m_chunkSpace * sizeof(b2Chunk));
 	
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
@@ -89,10 +90,29 @@ b2BlockAllocator::~b2BlockAllocator()
 {
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
-		b2Free(m_chunks[i].blocks);
+		FreeChunk(m_chunks[i].blocks);
 	}
 
-	b2Free(m_chunks);
+	FreeChunk(m_chunks);
+}
+
+void* b2BlockAllocator::AllocateChunk(int32 size)
+{
+	if (m_arena)
+	{
+		return m_arena->Allocate(size);
+	}
+
+	return b2Alloc(size);
+}
+
+void b2BlockAllocator::FreeChunk(void* p)
+{
+	// Arena memory is reclaimed by its owner, all at once.
+	if (m_arena == NULL)
+	{
+		b2Free(p);
+	}
 }
 
 void* b2BlockAllocator::Allocate(int32 size)
@@ -117,14 +137,14 @@ void* b2BlockAllocator::Allocate(int32 size)
 		{
 			b2Chunk* oldChunks = m_chunks;
 			m_chunkSpace += b2_chunkArrayIncrement;
-			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+			m_chunks = (b2Chunk*)AllocateChunk(m_chunkSpace * sizeof(b2Chunk));
 			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
 			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks);
+			FreeChunk(oldChunks);
 		}
 
 		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		chunk->blocks = (b2Block*)AllocateChunk(b2_chunkSize);
 #if defined(_DEBUG)
 		memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
@@ -196,7 +216,7 @@ void b2BlockAllocator::Clear()
 {
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
-		b2Free(m_chunks[i].blocks);
+		FreeChunk(m_chunks[i].blocks);
 	}
 
 	m_chunkCount = 0;
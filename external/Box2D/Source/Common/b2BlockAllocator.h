@@ -35,7 +35,8 @@ struct b2Chunk;
 class b2BlockAllocator
 {
 public:
-	b2BlockAllocator();
+	/// If an arena is given, chunks are taken from it and never freed.
+	b2BlockAllocator(b2Arena* arena = NULL);
 	~b2BlockAllocator();
 
 	void* Allocate(int32 size);
@@ -45,6 +46,11 @@ public:
 
 private:
 
+	void* AllocateChunk(int32 size);
+	void FreeChunk(void* p);
+
+	b2Arena* m_arena;
+
 	b2Chunk* m_chunks;
 	int32 m_chunkCount;
 	int32 m_chunkSpace;
@@ -149,6 +149,19 @@ void* b2Alloc(int32 size);
 /// If you implement b2Alloc, you should also implement this function.
 void b2Free(void* mem);
 
+/// Optional backing store for the long-lived allocations of a world (block
+/// allocator chunks and the broad-phase). Memory handed out by an arena is
+/// never passed to b2Free; the owner releases it wholesale once the world
+/// has been destructed.
+class b2Arena
+{
+public:
+	virtual ~b2Arena() {}
+
+	/// Return at least size bytes, suitably aligned for any Box2D object.
+	virtual void* Allocate(int32 size) = 0;
+};
+
 /// Version numbering scheme.
 /// See http://en.wikipedia.org/wiki/Software_versioning
 struct b2Version
@@ -147,7 +147,7 @@ void b2Contact::Update(b2ContactListener* listener)
 {
 	int32 oldCount = GetManifoldCount();
 
-	Evaluate(listener);
+	Evaluate((m_flags & e_reportFlag) ? listener : NULL);
 
 	int32 newCount = GetManifoldCount();
 
@@ -161,7 +161,8 @@ void b2Contact::Update(b2ContactListener* listener)
 	}
 
 	// Slow contacts don't generate TOI events.
-	if (body1->IsStatic() || body1->IsBullet() || body2->IsStatic() || body2->IsBullet())
+	if ((body1->IsStatic() || body1->IsBullet() || body2->IsStatic() || body2->IsBullet())
+		&& body1->IsContinuous() && body2->IsContinuous())
 	{
 		m_flags &= ~e_slowFlag;
 	}
@@ -117,6 +117,7 @@ public:
 		e_slowFlag		= 0x0002,
 		e_islandFlag	= 0x0004,
 		e_toiFlag		= 0x0008,
+		e_reportFlag	= 0x0010,
 	};
 
 	static void AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* destroyFcn,
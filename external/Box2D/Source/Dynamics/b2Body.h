@@ -228,6 +228,13 @@ public:
 	/// Should this body be treated like a bullet for continuous collision detection?
 	void SetBullet(bool flag);
 
+	/// Does this body take part in continuous collision detection at all?
+	bool IsContinuous() const;
+
+	/// Enable/disable continuous collision detection for this body. Disabling it
+	/// saves the TOI cost for bodies that are known to move slowly (default: enabled).
+	void SetContinuous(bool flag);
+
 	/// Is this body static (immovable)?
 	bool IsStatic() const;
 
@@ -291,6 +298,7 @@ private:
 		e_allowSleepFlag	= 0x0010,
 		e_bulletFlag		= 0x0020,
 		e_fixedRotationFlag	= 0x0040,
+		e_noContinuousFlag	= 0x0080,
 	};
 
 	// m_type
@@ -450,6 +458,23 @@ inline void b2Body::SetBullet(bool flag)
 	}
 }
 
+inline bool b2Body::IsContinuous() const
+{
+	return (m_flags & e_noContinuousFlag) == 0;
+}
+
+inline void b2Body::SetContinuous(bool flag)
+{
+	if (flag)
+	{
+		m_flags &= ~e_noContinuousFlag;
+	}
+	else
+	{
+		m_flags |= e_noContinuousFlag;
+	}
+}
+
 inline bool b2Body::IsStatic() const
 {
 	return m_type == e_staticType;
@@ -64,6 +64,11 @@ void* b2ContactManager::PairAdded(void* proxyUserData1, void* proxyUserData2)
 	body1 = shape1->GetBody();
 	body2 = shape2->GetBody();
 
+	if (m_world->m_contactFilter == NULL || m_world->m_contactFilter->ShouldReport(shape1, shape2))
+	{
+		c->m_flags |= b2Contact::e_reportFlag;
+	}
+
 	// Insert into the world.
 	c->m_prev = NULL;
 	c->m_next = m_world->m_contactList;
@@ -133,7 +138,7 @@ void b2ContactManager::Destroy(b2Contact* c)
 
 	// Inform the user that this contact is ending.
 	int32 manifoldCount = c->GetManifoldCount();
-	if (manifoldCount > 0 && m_world->m_contactListener)
+	if (manifoldCount > 0 && m_world->m_contactListener && (c->m_flags & b2Contact::e_reportFlag))
 	{
 		b2Body* b1 = shape1->GetBody();
 		b2Body* b2 = shape2->GetBody();
@@ -390,6 +390,11 @@ void b2Island::Report(b2ContactConstraint* constraints)
 	for (int32 i = 0; i < m_contactCount; ++i)
 	{
 		b2Contact* c = m_contacts[i];
+		if ((c->m_flags & b2Contact::e_reportFlag) == 0)
+		{
+			continue;
+		}
+
 		b2ContactConstraint* cc = constraints + i;
 		b2ContactResult cr;
 		cr.shape1 = c->GetShape1();
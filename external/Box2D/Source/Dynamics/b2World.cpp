@@ -26,8 +26,12 @@
 #include "../Collision/Shapes/b2CircleShape.h"
 #include "../Collision/Shapes/b2PolygonShape.h"
 #include <new>
+#include <chrono>
+#include <cstring>
 
-b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
+b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep, b2Arena* arena)
+: m_arena(arena)
+, m_blockAllocator(arena)
 {
 	m_destructionListener = NULL;
 	m_boundaryListener = NULL;
@@ -46,6 +50,8 @@ b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
 	m_positionCorrection = true;
 	m_warmStarting = true;
 	m_continuousPhysics = true;
+	m_maxTOIEvents = 0;
+	memset(&m_toiStats, 0, sizeof(m_toiStats));
 
 	m_allowSleep = doSleep;
 	m_gravity = gravity;
@@ -55,7 +61,7 @@ b2World::b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep)
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_world = this;
-	void* mem = b2Alloc(sizeof(b2BroadPhase));
+	void* mem = m_arena ? m_arena->Allocate(sizeof(b2BroadPhase)) : b2Alloc(sizeof(b2BroadPhase));
 	m_broadPhase = new (mem) b2BroadPhase(worldAABB, &m_contactManager);
 
 	b2BodyDef bd;
@@ -66,7 +72,10 @@ b2World::~b2World()
 {
 	DestroyBody(m_groundBody);
 	m_broadPhase->~b2BroadPhase();
-	b2Free(m_broadPhase);
+	if (m_arena == NULL)
+	{
+		b2Free(m_broadPhase);
+	}
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -499,6 +508,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 	// Find TOI events and solve them.
 	for (;;)
 	{
+		if (m_maxTOIEvents > 0 && m_toiStats.events >= m_maxTOIEvents)
+		{
+			m_toiStats.capped = true;
+			break;
+		}
+
 		// Find the first TOI.
 		b2Contact* minContact = NULL;
 		float32 minTOI = 1.0f;
@@ -549,6 +564,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 				// Compute the time of impact.
 				toi = b2TimeOfImpact(c->m_shape1, b1->m_sweep, c->m_shape2, b2->m_sweep);
+				++m_toiStats.computations;
 
 				b2Assert(0.0f <= toi && toi <= 1.0f);
 
@@ -678,6 +694,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.maxIterations = step.maxIterations;
 
 		island.SolveTOI(subStep);
+		++m_toiStats.events;
 
 		// Post solve cleanup.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -761,9 +778,14 @@ void b2World::Step(float32 dt, int32 iterations)
 	}
 
 	// Handle TOI events.
+	memset(&m_toiStats, 0, sizeof(m_toiStats));
 	if (m_continuousPhysics && step.dt > 0.0f)
 	{
+		// Wall clock, clock() would also count the time of other threads
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 		SolveTOI(step);
+		m_toiStats.microseconds = int32(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count());
 	}
 
 	// Draw debug information.
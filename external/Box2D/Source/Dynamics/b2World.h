@@ -45,6 +45,15 @@ struct b2TimeStep
 	bool positionCorrection;
 };
 
+/// Continuous collision statistics of the last time step.
+struct b2TOIStats
+{
+	int32 events;		///< number of TOI sub-steps solved
+	int32 computations;	///< number of time of impact queries
+	bool capped;		///< the TOI sub-step limit was reached
+	int32 microseconds;	///< wall clock time spent in continuous collision
+};
+
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
 /// management facilities.
@@ -55,7 +64,10 @@ public:
 	/// @param worldAABB a bounding box that completely encompasses all your shapes.
 	/// @param gravity the world gravity vector.
 	/// @param doSleep improve performance by not simulating inactive bodies.
-	b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep);
+	/// @param arena optional backing store for bodies, shapes, joints, contacts
+	/// and the broad-phase. The arena must outlive the world; after the world
+	/// is destructed its memory can be reclaimed in one go by the arena owner.
+	b2World(const b2AABB& worldAABB, const b2Vec2& gravity, bool doSleep, b2Arena* arena = NULL);
 
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
@@ -139,6 +151,13 @@ public:
 	/// Enable/disable continuous physics. For testing.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 
+	/// Limit the number of TOI sub-steps per time step (0 means no limit).
+	/// Remaining TOI events of a step are dropped once the limit is reached.
+	void SetMaxTOIEvents(int32 count) { m_maxTOIEvents = count; }
+
+	/// Get the continuous collision statistics of the last time step.
+	const b2TOIStats& GetTOIStats() const { return m_toiStats; }
+
 	/// Perform validation of internal data structures.
 	void Validate();
 
@@ -172,6 +191,7 @@ private:
 	void DrawShape(b2Shape* shape, const b2XForm& xf, const b2Color& color, bool core);
 	void DrawDebugData();
 
+	b2Arena* m_arena;
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
@@ -213,6 +233,9 @@ private:
 
 	// This is for debugging the solver.
 	bool m_continuousPhysics;
+
+	int32 m_maxTOIEvents;
+	b2TOIStats m_toiStats;
 };
 
 inline b2Body* b2World::GetGroundBody()
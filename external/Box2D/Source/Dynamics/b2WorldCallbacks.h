@@ -70,6 +70,11 @@ public:
 	/// Return true if contact calculations should be performed between these two shapes.
 	/// @warning for performance reasons this is only called when the AABBs begin to overlap.
 	virtual bool ShouldCollide(b2Shape* shape1, b2Shape* shape2);
+
+	/// Return true if the contact listener should be told about contact points between
+	/// these two shapes. Contacts that are not reported are still simulated.
+	/// @warning for performance reasons this is only called when the contact is created.
+	virtual bool ShouldReport(b2Shape* shape1, b2Shape* shape2);
 };
 
 /// The default contact filter.
@@ -23,15 +23,15 @@ static void do_free_stbi(char *ptr)
 }
 
 StbLoader_RGBA *
-StbLoader::decode_image(void *buffer, size_t len)
+StbLoader::decode_image(const void *buffer, size_t len)
 {
     int w, h;
-    stbi_uc *pixels = stbi_load_from_memory((stbi_uc *)buffer, len, &w, &h, NULL, 4);
+    stbi_uc *pixels = stbi_load_from_memory((const stbi_uc *)buffer, len, &w, &h, NULL, 4);
     return new StbLoader_RGBA((char *)pixels, w, h, do_free_stbi);
 }
 
 StbLoader_RGBA *
-StbLoader::render_font(void *buffer, size_t len, StbLoader_Color color, int size, const char *text)
+StbLoader::render_font(const void *buffer, size_t len, StbLoader_Color color, int size, const char *text)
 {
     stbtt_fontinfo font;
     stbtt_fontinfo *f = &font;
@@ -64,10 +64,10 @@ StbLoader::render_font(void *buffer, size_t len, StbLoader_Color color, int size
             continue;
         }
 
-        int cw, ch;
-        int xo, yo;
-        stbtt_FreeBitmap(stbtt_GetCodepointBitmap(f, scale, scale,
-                    codepoint, &cw, &ch, &xo, &yo), nullptr);
+        int x0, y0, x1, y1;
+        stbtt_GetCodepointBitmapBox(f, codepoint, scale, scale, &x0, &y0, &x1, &y1);
+        int cw = x1 - x0;
+        int xo = x0;
 
         int advance, bearing;
         stbtt_GetCodepointHMetrics(f, codepoint, &advance, &bearing);
@@ -131,3 +131,64 @@ StbLoader::render_font(void *buffer, size_t len, StbLoader_Color color, int size
 
     return new StbLoader_RGBA((char *)pixels, w, h, do_free);
 }
+
+StbLoader_Font::StbLoader_Font(const void *buffer, size_t len, int size)
+    : info(new stbtt_fontinfo)
+    , scale(0.f)
+    , h(0)
+    , descent(0)
+{
+    stbtt_InitFont(info, (const unsigned char *)buffer,
+        stbtt_GetFontOffsetForIndex((const unsigned char *)buffer, 0));
+
+    // Same scaling and baseline as render_font()
+    float addscale = 1.25;
+    h = size * addscale;
+    scale = stbtt_ScaleForPixelHeight(info, size * addscale);
+
+    int ascent, lineGap;
+    stbtt_GetFontVMetrics(info, &ascent, &descent, &lineGap);
+    descent *= scale;
+}
+
+StbLoader_Font::~StbLoader_Font()
+{
+    delete info;
+}
+
+StbLoader_RGBA *
+StbLoader_Font::render_glyph(uint32_t codepoint, int *x, int *y, int *advance)
+{
+    int adv, bearing;
+    stbtt_GetCodepointHMetrics(info, codepoint, &adv, &bearing);
+    *advance = adv * scale;
+
+    int cw, ch;
+    int xo, yo;
+    unsigned char *cb = stbtt_GetCodepointBitmap(info, scale, scale,
+            codepoint, &cw, &ch, &xo, &yo);
+    *x = xo;
+    *y = h + yo + descent;
+
+    if (!cb || cw == 0 || ch == 0) {
+        stbtt_FreeBitmap(cb, nullptr);
+        return nullptr;
+    }
+
+    unsigned char *pixels = (unsigned char *)malloc(cw * ch * 4);
+    for (int i=0; i<cw*ch; i++) {
+        pixels[4 * i + 0] = 255;
+        pixels[4 * i + 1] = 255;
+        pixels[4 * i + 2] = 255;
+        pixels[4 * i + 3] = cb[i];
+    }
+
+    stbtt_FreeBitmap(cb, nullptr);
+    return new StbLoader_RGBA((char *)pixels, cw, ch, do_free);
+}
+
+int
+StbLoader_Font::kerning(uint32_t left, uint32_t right)
+{
+    return stbtt_GetCodepointKernAdvance(info, left, right) * scale;
+}
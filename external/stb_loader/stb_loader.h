@@ -25,13 +25,35 @@ struct StbLoader_Color {
     float a;
 };
 
+struct stbtt_fontinfo;
+
+// Parsed once at one pixel size, renders glyphs one at a time
+class StbLoader_Font {
+public:
+    StbLoader_Font(const void *buffer, size_t len, int size);
+    ~StbLoader_Font();
+
+    int height() { return h; }
+
+    // White glyph, alpha is the coverage; x/y is the offset from the pen
+    // position at the top of the line (nullptr for empty glyphs)
+    StbLoader_RGBA *render_glyph(uint32_t codepoint, int *x, int *y, int *advance);
+    int kerning(uint32_t left, uint32_t right);
+
+private:
+    stbtt_fontinfo *info;
+    float scale;
+    int h;
+    int descent;
+};
+
 class StbLoader {
 public:
     static StbLoader_RGBA *
-    decode_image(void *buffer, size_t len);
+    decode_image(const void *buffer, size_t len);
 
     static StbLoader_RGBA *
-    render_font(void *buffer, size_t len, StbLoader_Color color, int size, const char *text);
+    render_font(const void *buffer, size_t len, StbLoader_Color color, int size, const char *text);
 };
 
 #endif /* GABERLN_STB_LOADER_H */
@@ -0,0 +1,15 @@
+PLATFORM ?= sdl2
+$(eval $(call add_platform,$(PLATFORM)))
+$(eval $(call include_makefile,platform/$(PLATFORM)/platform.mk))
+
+$(eval $(call add_external,thp))
+$(eval $(call add_external,tinyxml2))
+$(eval $(call add_external,petals_log))
+$(eval $(call add_external,vmath))
+# Image and font decoding for SoftwareRenderer on all platforms
+$(eval $(call add_external,stb_loader))
+# Vendored stb code, its warnings are not ours to fix
+external/stb_loader/stb_loader.o: CXXFLAGS += -w
+
+include mk/box2d.mk
+include mk/glaserl.mk
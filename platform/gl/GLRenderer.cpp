@@ -22,8 +22,18 @@
 #include "petals_log.h"
 
 #include <initializer_list>
+#include <vector>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
+
+
+// Cached images up to ATLAS_MAX_IMAGE pixels on either side share pages
+static const int ATLAS_SIZE = 1024;
+static const int ATLAS_MAX_IMAGE = 512;
+static const int ATLAS_GUTTER = 2;
+static const size_t ATLAS_MAX_PAGES = 4;
 
 
 struct fRect {
@@ -77,6 +87,14 @@ struct FloatArray {
     size_t size;
 };
 
+static void rgba_split(int rgba, float &r, float &g, float &b, float &a)
+{
+    a = ((rgba & 0xff000000) >> 24) / 255.;
+    r = ((rgba & 0x00ff0000) >> 16) / 255.;
+    g = ((rgba & 0x0000ff00) >> 8) / 255.;
+    b = ((rgba & 0x000000ff)) / 255.;
+}
+
 template <typename T>
 struct Use {
     Use(const T &v) : v(v) { v->enable(); }
@@ -98,18 +116,42 @@ public:
     GLRendererPriv(Vec2 world_size);
     ~GLRendererPriv();
 
-    void submitTextured(Glaserl::Texture &texture, const FloatArray &data);
+    void submitTextured(Glaserl::Texture &texture, const Rect &bounds, const FloatArray &data);
     void submitRewind(Glaserl::Texture &texture, const FloatArray &data);
     void submitSaturation(Glaserl::Texture &texture, const FloatArray &data);
     void submitBlur(Glaserl::Texture &texture, const FloatArray &data);
-    void submitPath(float *data, size_t size);
+    void submitPath(const Rect &bounds, float *data, size_t size);
+    void submitMesh(Glaserl::Buffer &buffer, float x, float y, float angle, int rgba);
     void flush();
 
     void setupProjection(Rect world_rect, Vec2 framebuffer_size, bool offscreen);
 
+    Glaserl::Texture allocate(int w, int h, Vec2 &pos);
+
 private:
-    void drawTextured();
-    void drawPath();
+    enum ProgramType {
+        TEXTURED,
+        PATH,
+    };
+
+    // Textured quads and paths wait here until something needs the GL
+    // state (clip, render target, other programs) or the frame ends.
+    // Each batch is one triangle strip with a single texture.
+    struct Batch {
+        ProgramType program;
+        Glaserl::Texture texture;
+        Rect bounds;
+        std::vector<float> vertices;
+    };
+
+    struct AtlasPage {
+        Glaserl::Texture texture;
+        int x, y;
+        int shelf;
+    };
+
+    void enqueue(ProgramType program, const Glaserl::Texture &texture, const Rect &bounds,
+                 const float *data, size_t size);
 
     vmath::mat4<float> projection;
 
@@ -121,6 +163,10 @@ private:
 
     Glaserl::Program path_program;
     Glaserl::Buffer path_buffer;
+    std::vector<float> path_vertices;
+
+    Glaserl::Program mesh_program;
+    int mesh_rgba;
 
     Glaserl::Program rewind_program;
     Glaserl::Buffer rewind_buffer;
@@ -128,15 +174,10 @@ private:
     Glaserl::Program saturation_program;
     Glaserl::Buffer saturation_buffer;
 
-    enum ProgramType {
-        NONE,
-        TEXTURED,
-        BLUR,
-        PATH,
-        REWIND,
-    };
+    std::vector<Batch> queue;
+    size_t queued;
 
-    enum ProgramType active_program;
+    std::vector<AtlasPage> atlas;
 
     Vec2 world_size;
     Vec2 framebuffer_size;
@@ -160,12 +201,30 @@ const char *textured_vertex_shader_src =
 "}\n"
 ;
 
-const char *textured_fragment_shader_src =
+// Textured quads are multiplied by a vertex colour (white for images),
+// so that images and glyphs from the atlas can share one draw call
+const char *tinted_vertex_shader_src =
+"attribute vec4 vtxcoord;\n"
+"attribute vec2 texcoord;\n"
+"attribute vec4 color;\n"
+"uniform mat4 projection;\n"
+"varying vec2 tex;\n"
+"varying vec4 col;\n"
+"\n"
+"void main() {\n"
+"    gl_Position = projection * vtxcoord;\n"
+"    tex = texcoord;\n"
+"    col = color;\n"
+"}\n"
+;
+
+const char *tinted_fragment_shader_src =
 "varying vec2 tex;\n"
+"varying vec4 col;\n"
 "uniform sampler2D texture;\n"
 "\n"
 "void main() {\n"
-"    gl_FragColor = texture2D(texture, tex);\n"
+"    gl_FragColor = texture2D(texture, tex) * col;\n"
 "}\n"
 ;
 
@@ -262,6 +321,23 @@ const char *path_vertex_shader_src =
 "}\n"
 ;
 
+// Meshes are in body space, transform is (cos, sin, x, y) of the body
+const char *mesh_vertex_shader_src =
+"attribute vec4 vtxcoord;\n"
+"attribute float coverage;\n"
+"uniform mat4 projection;\n"
+"uniform vec4 transform;\n"
+"uniform vec4 color;\n"
+"varying vec4 col;\n"
+"\n"
+"void main() {\n"
+"    vec2 pos = vec2(transform.x * vtxcoord.x - transform.y * vtxcoord.y,\n"
+"                    transform.y * vtxcoord.x + transform.x * vtxcoord.y);\n"
+"    gl_Position = projection * vec4(pos + transform.zw, 0.0, 1.0);\n"
+"    col = vec4(color.rgb, color.a * coverage);\n"
+"}\n"
+;
+
 const char *path_fragment_shader_src =
 "varying vec4 col;\n"
 "\n"
@@ -273,11 +349,12 @@ const char *path_fragment_shader_src =
 GLRendererPriv::GLRendererPriv(Vec2 world_size)
     : projection()
     , textured_program(Glaserl::program(
-                textured_vertex_shader_src,
-                textured_fragment_shader_src,
+                tinted_vertex_shader_src,
+                tinted_fragment_shader_src,
                 // Attributes
                 "vtxcoord", 2,
                 "texcoord", 2,
+                "color", 4,
                 NULL,
                 // Uniforms
                 "projection",
@@ -308,6 +385,20 @@ GLRendererPriv::GLRendererPriv(Vec2 world_size)
                 "projection",
                 NULL))
     , path_buffer(Glaserl::buffer())
+    , path_vertices()
+    , mesh_program(Glaserl::program(
+                mesh_vertex_shader_src,
+                path_fragment_shader_src,
+                // Attributes
+                "vtxcoord", 2,
+                "coverage", 1,
+                NULL,
+                // Uniforms
+                "projection",
+                "transform",
+                "color",
+                NULL))
+    , mesh_rgba(0)
     , rewind_program(Glaserl::program(
                 rewind_vertex_shader_src,
                 rewind_fragment_shader_src,
@@ -336,7 +427,9 @@ GLRendererPriv::GLRendererPriv(Vec2 world_size)
                 "alpha",
                 NULL))
     , saturation_buffer(Glaserl::buffer())
-    , active_program(NONE)
+    , queue()
+    , queued(0)
+    , atlas()
     , world_size(world_size)
     , framebuffer_size(world_size)
     , framebuffer_target_size(framebuffer_size)
@@ -365,7 +458,9 @@ GLRendererPriv::setupProjection(Rect world_rect, Vec2 framebuffer_size, bool off
 
     // TODO: Zoom and center WORLD_WIDTH, WORLD_HEIGHT into available space
     if (offscreen) {
-        projection *= vmath::ortho_matrix<float>(0, framebuffer_size.x, 0, framebuffer_size.y, 0, 1);
+        // world_rect covers the whole render target
+        projection *= vmath::ortho_matrix<float>(world_rect.tl.x, world_rect.br.x,
+                                                 world_rect.tl.y, world_rect.br.y, 0, 1);
     } else {
         projection *= vmath::ortho_matrix<float>(0, framebuffer_size.x, framebuffer_size.y, 0, 0, 1);
     }
@@ -383,7 +478,7 @@ GLRendererPriv::setupProjection(Rect world_rect, Vec2 framebuffer_size, bool off
     }
 
     auto m = vmath::transpose(projection);
-    for (auto p: {textured_program, blur_program, path_program, rewind_program, saturation_program}) {
+    for (auto p: {textured_program, blur_program, path_program, mesh_program, rewind_program, saturation_program}) {
         with (p, [&m] (const Glaserl::Program &program) {
             glUniformMatrix4fv(program->uniform_location("projection"), 1, GL_FALSE, m);
         });
@@ -391,25 +486,49 @@ GLRendererPriv::setupProjection(Rect world_rect, Vec2 framebuffer_size, bool off
 }
 
 void
-GLRendererPriv::submitTextured(Glaserl::Texture &texture, const FloatArray &data)
+GLRendererPriv::enqueue(ProgramType program, const Glaserl::Texture &texture, const Rect &bounds,
+                        const float *data, size_t size)
 {
-    if (active_program != NONE) {
-        flush();
+    // Join the newest batch with the same state, as long as nothing
+    // queued after it overlaps (that would change the blending order)
+    Batch *batch = nullptr;
+    for (size_t i=queued; i-- > 0; ) {
+        if (queue[i].program == program && queue[i].texture == texture) {
+            batch = &queue[i];
+            batch->bounds.expand(bounds.tl);
+            batch->bounds.expand(bounds.br);
+            break;
+        }
+
+        if (queue[i].bounds.intersects(bounds)) {
+            break;
+        }
     }
 
-    textured_buffer->append(data.data, data.size);
+    if (!batch) {
+        if (queued == queue.size()) {
+            queue.emplace_back();
+        }
 
-    with(texture, [this] (const Glaserl::Texture &texture) {
-        Glaserl::Util::render_triangle_strip(textured_program, textured_buffer);
-    });
+        batch = &queue[queued++];
+        batch->program = program;
+        batch->texture = texture;
+        batch->bounds = bounds;
+    }
+
+    batch->vertices.insert(batch->vertices.end(), data, data + size / sizeof(float));
+}
+
+void
+GLRendererPriv::submitTextured(Glaserl::Texture &texture, const Rect &bounds, const FloatArray &data)
+{
+    enqueue(TEXTURED, texture, bounds, data.data, data.size);
 }
 
 void
 GLRendererPriv::submitBlur(Glaserl::Texture &texture, const FloatArray &data)
 {
-    if (active_program != NONE) {
-        flush();
-    }
+    flush();
 
     blur_buffer->append(data.data, data.size);
 
@@ -421,9 +540,7 @@ GLRendererPriv::submitBlur(Glaserl::Texture &texture, const FloatArray &data)
 void
 GLRendererPriv::submitRewind(Glaserl::Texture &texture, const FloatArray &data)
 {
-    if (active_program != NONE) {
-        flush();
-    }
+    flush();
 
     rewind_buffer->append(data.data, data.size);
 
@@ -435,9 +552,7 @@ GLRendererPriv::submitRewind(Glaserl::Texture &texture, const FloatArray &data)
 void
 GLRendererPriv::submitSaturation(Glaserl::Texture &texture, const FloatArray &data)
 {
-    if (active_program != NONE) {
-        flush();
-    }
+    flush();
 
     saturation_buffer->append(data.data, data.size);
 
@@ -447,40 +562,110 @@ GLRendererPriv::submitSaturation(Glaserl::Texture &texture, const FloatArray &da
 }
 
 void
-GLRendererPriv::submitPath(float *data, size_t size)
+GLRendererPriv::submitPath(const Rect &bounds, float *data, size_t size)
 {
-    if (active_program != PATH) {
-        flush();
-    }
-
-    path_buffer->append(data, size);
-    active_program = PATH;
+    enqueue(PATH, Glaserl::Texture(), bounds, data, size);
 }
 
 void
-GLRendererPriv::drawPath()
+GLRendererPriv::submitMesh(Glaserl::Buffer &buffer, float x, float y, float angle, int rgba)
 {
-    Glaserl::Util::render_triangle_strip(path_program, path_buffer);
-    active_program = NONE;
+    flush();
+
+    float c = cosf(angle);
+    float s = sinf(angle);
+    bool recolor = (rgba != mesh_rgba);
+    with(mesh_program, [c, s, x, y, rgba, recolor] (const Glaserl::Program &program) {
+        glUniform4f(program->uniform_location("transform"), c, s, x, y);
+        if (recolor) {
+            float r, g, b, a;
+            rgba_split(rgba, r, g, b, a);
+            glUniform4f(program->uniform_location("color"), r, g, b, a);
+        }
+    });
+    mesh_rgba = rgba;
+
+    Glaserl::Util::render_triangle_strip(mesh_program, buffer);
 }
 
 void
 GLRendererPriv::flush()
 {
-    if (active_program == PATH) {
-        drawPath();
+    for (size_t i=0; i<queued; i++) {
+        Batch &batch = queue[i];
+        if (batch.program == TEXTURED) {
+            textured_buffer->append(batch.vertices.data(), batch.vertices.size() * sizeof(float));
+            with(batch.texture, [this] (const Glaserl::Texture &texture) {
+                Glaserl::Util::render_triangle_strip(textured_program, textured_buffer);
+            });
+        } else {
+            path_buffer->append(batch.vertices.data(), batch.vertices.size() * sizeof(float));
+            Glaserl::Util::render_triangle_strip(path_program, path_buffer);
+        }
+
+        batch.texture.reset();
+        batch.vertices.clear();
+    }
+
+    queued = 0;
+}
+
+Glaserl::Texture
+GLRendererPriv::allocate(int w, int h, Vec2 &pos)
+{
+    if (w > ATLAS_MAX_IMAGE || h > ATLAS_MAX_IMAGE) {
+        return Glaserl::Texture();
+    }
+
+    // Shelf packing: left to right in rows as high as their tallest image
+    w += ATLAS_GUTTER;
+    h += ATLAS_GUTTER;
+    for (auto &page: atlas) {
+        if (page.x + w > ATLAS_SIZE) {
+            page.x = 0;
+            page.y += page.shelf;
+            page.shelf = 0;
+        }
+
+        if (page.y + h <= ATLAS_SIZE) {
+            pos = Vec2(page.x, page.y);
+            page.x += w;
+            page.shelf = std::max(page.shelf, h);
+            return page.texture;
+        }
+    }
+
+    if (atlas.size() == ATLAS_MAX_PAGES) {
+        LOG_DEBUG("Texture atlas full, using a separate texture");
+        return Glaserl::Texture();
     }
+
+    atlas.push_back(AtlasPage{Glaserl::texture(nullptr, ATLAS_SIZE, ATLAS_SIZE), w, 0, h});
+    pos = Vec2(0, 0);
+    return atlas.back().texture;
 }
 
 GLTextureData::GLTextureData(unsigned char *pixels, int width, int height)
     : NP::TextureData(width, height)
     , texture(Glaserl::texture(pixels, width, height))
+    , origin(0, 0)
+    , framebuffer()
 {
 }
 
 GLTextureData::GLTextureData(Glaserl::Texture texture)
     : NP::TextureData(texture->width(), texture->height())
     , texture(texture)
+    , origin(0, 0)
+    , framebuffer()
+{
+}
+
+GLTextureData::GLTextureData(Glaserl::Texture page, const Rect &region)
+    : NP::TextureData(region.br.x - region.tl.x, region.br.y - region.tl.y)
+    , texture(page)
+    , origin(region.tl)
+    , framebuffer()
 {
 }
 
@@ -488,6 +673,26 @@ GLTextureData::~GLTextureData()
 {
 }
 
+GLFontData::GLFontData(int size)
+    : NP::FontData(size)
+    , NP::GlyphCache()
+{
+}
+
+GLFontData::~GLFontData()
+{
+}
+
+GLMeshData::GLMeshData(Glaserl::Buffer buffer)
+    : NP::MeshData()
+    , buffer(buffer)
+{
+}
+
+GLMeshData::~GLMeshData()
+{
+}
+
 GLFramebufferData::GLFramebufferData(int w, int h)
     : NP::FramebufferData(w, h)
     , framebuffer(Glaserl::framebuffer(w, h))
@@ -570,6 +775,22 @@ GLRenderer::load(unsigned char *pixels, int w, int h)
     return NP::Texture(new GLTextureData(pixels, w, h));
 }
 
+NP::Texture
+GLRenderer::loadAtlas(unsigned char *pixels, int w, int h)
+{
+    Vec2 pos;
+    Glaserl::Texture page = priv->allocate(w, h, pos);
+    if (!page) {
+        return load(pixels, w, h);
+    }
+
+    with(page, [pos, w, h, pixels] (const Glaserl::Texture &texture) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    });
+
+    return NP::Texture(new GLTextureData(page, Rect(pos.x, pos.y, pos.x + w, pos.y + h)));
+}
+
 NP::Framebuffer
 GLRenderer::framebuffer(Vec2 size)
 {
@@ -580,6 +801,7 @@ void
 GLRenderer::begin(NP::Framebuffer &rendertarget, Rect world_rect)
 {
     GLFramebufferData *data = static_cast<GLFramebufferData *>(rendertarget.get());
+    priv->flush();
     data->framebuffer->enable();
     priv->setupProjection(world_rect, Vec2(data->w, data->h), true);
 }
@@ -588,6 +810,7 @@ void
 GLRenderer::end(NP::Framebuffer &rendertarget)
 {
     GLFramebufferData *data = static_cast<GLFramebufferData *>(rendertarget.get());
+    priv->flush();
     data->framebuffer->disable();
     priv->setupProjection(Rect(Vec2(0, 0), priv->world_size), priv->framebuffer_size, false);
 }
@@ -596,7 +819,19 @@ NP::Texture
 GLRenderer::retrieve(NP::Framebuffer &rendertarget)
 {
     GLFramebufferData *data = static_cast<GLFramebufferData *>(rendertarget.get());
-    return NP::Texture(new GLTextureData(data->framebuffer->texture));
+    GLTextureData *result = new GLTextureData(data->framebuffer->texture);
+    result->framebuffer = rendertarget;
+    return NP::Texture(result);
+}
+
+void
+GLRenderer::read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels)
+{
+    GLFramebufferData *data = static_cast<GLFramebufferData *>(rendertarget.get());
+    priv->flush();
+    data->framebuffer->enable();
+    glReadPixels(area.tl.x, area.tl.y, area.w(), area.h(), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    data->framebuffer->disable();
 }
 
 Rect
@@ -621,6 +856,7 @@ GLRenderer::clip(Rect rect)
     int w = x2 - x1;
     int h = y2 - y1;
 
+    priv->flush();
     Glaserl::Util::set_scissor(x1, y1, w, h);
 
     std::swap(rect, priv->last_clip);
@@ -632,7 +868,7 @@ GLRenderer::image(const NP::Texture &texture, int x, int y, int w, int h)
 {
     GLTextureData *data = static_cast<GLTextureData *>(texture.get());
 
-    Rect src(0, 0, data->texture->width(), data->texture->height());
+    Rect src(0, 0, data->w, data->h);
     Rect dst(x, y, x+w, y+h);
 
     subimage(texture, src, dst);
@@ -646,25 +882,41 @@ mapTexture(const NP::Texture &texture, const Rect &src)
     float w = data->texture->width();
     float h = data->texture->height();
 
-    float tx1 = float(src.tl.x) / w;
-    float ty1 = float(src.tl.y) / h;
+    float tx1 = float(data->origin.x + src.tl.x) / w;
+    float ty1 = float(data->origin.y + src.tl.y) / h;
     data->texture->map_uv(tx1, ty1);
 
-    float tx2 = float(src.br.x) / w;
-    float ty2 = float(src.br.y) / h;
+    float tx2 = float(data->origin.x + src.br.x) / w;
+    float ty2 = float(data->origin.y + src.br.y) / h;
     data->texture->map_uv(tx2, ty2);
 
     return fRect(tx1, ty1, tx2, ty2);
 }
 
+// First and last vertex are doubled, so that quads can share one strip
 static FloatArray
 vtxtex(const fRect &vtx, const fRect &tex)
 {
     return FloatArray({
+        vtx.x1, vtx.y1, tex.x1, tex.y1,
         vtx.x1, vtx.y1, tex.x1, tex.y1,
         vtx.x1, vtx.y2, tex.x1, tex.y2,
         vtx.x2, vtx.y1, tex.x2, tex.y1,
         vtx.x2, vtx.y2, tex.x2, tex.y2,
+        vtx.x2, vtx.y2, tex.x2, tex.y2,
+    });
+}
+
+static FloatArray
+vtxtexcol(const fRect &vtx, const fRect &tex, float r, float g, float b, float a)
+{
+    return FloatArray({
+        vtx.x1, vtx.y1, tex.x1, tex.y1, r, g, b, a,
+        vtx.x1, vtx.y1, tex.x1, tex.y1, r, g, b, a,
+        vtx.x1, vtx.y2, tex.x1, tex.y2, r, g, b, a,
+        vtx.x2, vtx.y1, tex.x2, tex.y1, r, g, b, a,
+        vtx.x2, vtx.y2, tex.x2, tex.y2, r, g, b, a,
+        vtx.x2, vtx.y2, tex.x2, tex.y2, r, g, b, a,
     });
 }
 
@@ -673,7 +925,8 @@ GLRenderer::subimage(const NP::Texture &texture, const Rect &src, const Rect &ds
 {
     GLTextureData *data = static_cast<GLTextureData *>(texture.get());
 
-    priv->submitTextured(data->texture, vtxtex(dst, mapTexture(texture, src)));
+    priv->submitTextured(data->texture, Rect::order(dst.tl, dst.br),
+                         vtxtexcol(dst, mapTexture(texture, src), 1.f, 1.f, 1.f, 1.f));
 }
 
 void
@@ -722,14 +975,6 @@ GLRenderer::saturation(const NP::Texture &texture, const Rect &src, const Rect &
     priv->submitSaturation(data->texture, vtxtex(dst, mapTexture(texture, src)));
 }
 
-static void rgba_split(int rgba, float &r, float &g, float &b, float &a)
-{
-    a = ((rgba & 0xff000000) >> 24) / 255.;
-    r = ((rgba & 0x00ff0000) >> 16) / 255.;
-    g = ((rgba & 0x0000ff00) >> 8) / 255.;
-    b = ((rgba & 0x000000ff)) / 255.;
-}
-
 void
 GLRenderer::rectangle(const Rect &rect, int rgba, bool fill)
 {
@@ -751,92 +996,101 @@ GLRenderer::rectangle(const Rect &rect, int rgba, bool fill)
         (float)rect.br.x, (float)rect.br.y, r, g, b, a,
         (float)rect.br.x, (float)rect.br.y, r, g, b, a,
     };
-    priv->submitPath(vtxcoords, sizeof(vtxcoords));
+    priv->submitPath(Rect::order(rect.tl, rect.br), vtxcoords, sizeof(vtxcoords));
 }
 
-static float *
-make_segment(b2Vec2 aa, b2Vec2 a, b2Vec2 b, b2Vec2 bb)
+void
+GLRenderer::path(const Path &path, int rgba)
 {
-    static b2Vec2 data[10];
+    float r, g, b, a;
+    rgba_split(rgba, r, g, b, a);
 
-    b2Vec2 a_to_b = 0.5 * (b - a) + 0.5 * (a - aa);
-    a_to_b.Normalize();
-    b2Vec2 a_to_b_90(-a_to_b.y, a_to_b.x);
+    if (path.numPoints() < 2) {
+        return;
+    }
 
-    b2Vec2 b_to_a = 0.5 * (bb - b) + 0.5 * (b - a);
-    b_to_a.Normalize();
-    b2Vec2 b_to_a_90(-b_to_a.y, b_to_a.x);
+    std::vector<float> &points = priv->path_vertices;
+    points.clear();
+    NP::outline(path, [&points, r, g, b, a] (const b2Vec2 &v, float coverage) {
+        points.insert(points.end(), { v.x, v.y, r, g, b, a * coverage });
+    });
+    // The feathered edge reaches 1.9 units past the path
+    Rect bbox = path.bbox();
+    Rect bounds(bbox.tl.x - 2, bbox.tl.y - 2, bbox.br.x + 2, bbox.br.y + 2);
+    priv->submitPath(bounds, points.data(), points.size() * sizeof(float));
+}
 
-    float w = 0.9;
-    float e = 1.0;
+NP::Mesh
+GLRenderer::tessellate(const Path &path)
+{
+    std::vector<float> &points = priv->path_vertices;
+    points.clear();
+    NP::outline(path, [&points] (const b2Vec2 &v, float coverage) {
+        points.insert(points.end(), { v.x, v.y, coverage });
+    });
 
-    int offset = 0;
-    data[offset++] = a + a_to_b_90 * (w + e);
+    auto buffer = Glaserl::buffer();
+    buffer->append(points.data(), points.size() * sizeof(float));
+    buffer->freeze();
+    return NP::Mesh(new GLMeshData(buffer));
+}
 
-    data[offset++] = a + a_to_b_90 * (w + e);
-    data[offset++] = b + b_to_a_90 * (w + e);
-    data[offset++] = a + a_to_b_90 * w;
-    data[offset++] = b + b_to_a_90 * w;
+void
+GLRenderer::mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba)
+{
+    GLMeshData *data = static_cast<GLMeshData *>(mesh.get());
+    priv->submitMesh(data->buffer, x, y, angle, rgba);
+}
 
-    data[offset++] = a - a_to_b_90 * w;
-    data[offset++] = b - b_to_a_90 * w;
-    data[offset++] = a - a_to_b_90 * (w + e);
-    data[offset++] = b - b_to_a_90 * (w + e);
+void
+GLRenderer::createGlyph(GLFontData *font, unsigned int codepoint, NP::GlyphCache::Glyph &glyph)
+{
+    GLFontData::Bitmap bitmap;
+    font->rasterize(codepoint, bitmap);
+
+    glyph.x = bitmap.x;
+    glyph.y = bitmap.y;
+    glyph.advance = bitmap.advance;
+    if (bitmap.w > 0 && bitmap.h > 0) {
+        glyph.texture = loadAtlas(bitmap.pixels.data(), bitmap.w, bitmap.h);
+    }
+}
 
-    data[offset++] = b - b_to_a_90 * (w + e);
+void
+GLRenderer::metrics(const NP::Font &font, const char *text, int *width, int *height)
+{
+    GLFontData *data = static_cast<GLFontData *>(font.get());
 
-    return &(data[0].x);
+    *width = data->layout(text, [this, data] (unsigned int codepoint, NP::GlyphCache::Glyph &glyph) {
+        createGlyph(data, codepoint, glyph);
+    }, [] (const NP::GlyphCache::Glyph &, int) {});
+    *height = data->lineHeight();
 }
 
 void
-GLRenderer::path(const Path &path, int rgba)
+GLRenderer::text(const NP::Font &font, const char *text, int x, int y, int rgb)
 {
-    float r, g, b, a;
-    rgba_split(rgba, r, g, b, a);
-
-    if (path.numPoints() < 2) {
-        return;
-    }
+    GLFontData *data = static_cast<GLFontData *>(font.get());
 
-    int segments = path.numPoints() - 1;
-    int points_len = (2 + 4) * 10 * segments;
-    float *points = new float[points_len];
-    int offset = 0;
-    for (int i=0; i<segments; i++) {
-        // Segment P1 -> P2
-        float *segment = make_segment(
-              (i > 0) ? path[i-1] : path[i],
-              path[i],
-              path[i+1],
-              (i < segments - 1) ? path[i+2] : path[i+1]
-        );
-
-        int soffset = 0;
-        for (int j=0; j<10; j++) {
-            // Vertices
-            points[offset++] = segment[soffset++];
-            points[offset++] = segment[soffset++];
-
-            // Color
-            points[offset++] = r;
-            points[offset++] = g;
-            points[offset++] = b;
-            if ((j < 3 || j > 6)) {
-                // Transparent
-                points[offset++] = 0.f;
-            } else {
-                // Filled
-                points[offset++] = a;
-            }
+    float r, g, b, a;
+    rgba_split(rgb | 0xff000000, r, g, b, a);
+
+    data->layout(text, [this, data] (unsigned int codepoint, NP::GlyphCache::Glyph &glyph) {
+        createGlyph(data, codepoint, glyph);
+    }, [&] (const NP::GlyphCache::Glyph &entry, int pen) {
+        if (entry.texture) {
+            GLTextureData *tex = static_cast<GLTextureData *>(entry.texture.get());
+            Rect src(0, 0, tex->w, tex->h);
+            Rect dst(x + pen + entry.x, y + entry.y, x + pen + entry.x + tex->w, y + entry.y + tex->h);
+            priv->submitTextured(tex->texture, dst, vtxtexcol(dst, mapTexture(entry.texture, src), r, g, b, a));
         }
-    }
-    priv->submitPath(points, points_len * sizeof(float));
-    delete points;
+    });
 }
 
 void
 GLRenderer::clear()
 {
+    priv->flush();
     Glaserl::Util::enable_scissor(false);
     glClear(GL_COLOR_BUFFER_BIT);
     Glaserl::Util::enable_scissor(true);
@@ -19,13 +19,22 @@
 #include "Renderer.h"
 #include "glaserlxx.h"
 
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
 class GLTextureData : public NP::TextureData {
 public:
     GLTextureData(unsigned char *pixels, int width, int height);
     GLTextureData(Glaserl::Texture texture);
+    GLTextureData(Glaserl::Texture page, const Rect &region);
     ~GLTextureData();
 
     Glaserl::Texture texture;
+    // Top left corner inside texture (non-zero for atlas regions)
+    Vec2 origin;
+    // Keeps a pooled framebuffer leased while its contents are in use
+    NP::Framebuffer framebuffer;
 };
 
 class GLFramebufferData : public NP::FramebufferData {
@@ -36,6 +45,39 @@ public:
     Glaserl::Framebuffer framebuffer;
 };
 
+class GLMeshData : public NP::MeshData {
+public:
+    GLMeshData(Glaserl::Buffer buffer);
+    ~GLMeshData();
+
+    Glaserl::Buffer buffer;
+};
+
+/**
+ * Font with a glyph cache
+ *
+ * Platforms rasterize single glyphs and report kerning; GLRenderer keeps
+ * every glyph it has drawn in the texture atlas.
+ **/
+class GLFontData : public NP::FontData, public NP::GlyphCache {
+public:
+    struct Bitmap {
+        Bitmap() : pixels(), w(0), h(0), x(0), y(0), advance(0) {}
+
+        // RGBA, white with the coverage in alpha
+        std::vector<unsigned char> pixels;
+        int w, h;
+        // Offset from the pen position at the top of the line
+        int x, y;
+        int advance;
+    };
+
+    GLFontData(int size);
+    virtual ~GLFontData();
+
+    virtual void rasterize(unsigned int codepoint, Bitmap &bitmap) = 0;
+};
+
 class GLRendererPriv;
 
 class GLRenderer : public NP::Renderer {
@@ -56,6 +98,7 @@ public:
     virtual void begin(NP::Framebuffer &rendertarget, Rect world_rect);
     virtual void end(NP::Framebuffer &rendertarget);
     virtual NP::Texture retrieve(NP::Framebuffer &rendertarget);
+    virtual void read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels);
 
     virtual Rect clip(Rect rect);
 
@@ -66,11 +109,24 @@ public:
     virtual void saturation(const NP::Texture &texture, const Rect &src, const Rect &dst, float a);
     virtual void rectangle(const Rect &r, int rgba, bool fill);
     virtual void path(const Path &p, int rgba);
+    virtual NP::Mesh tessellate(const Path &p);
+    virtual void mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba);
+
+    // For fonts derived from GLFontData
+    virtual void metrics(const NP::Font &font, const char *text, int *width, int *height);
+    virtual void text(const NP::Font &font, const char *text, int x, int y, int rgb);
 
     virtual void clear();
     virtual void flush();
 
+protected:
+    // Places small images into a shared atlas page, so that they can be
+    // drawn together; only for textures that are never freed (cached)
+    NP::Texture loadAtlas(unsigned char *pixels, int w, int h);
+
 private:
+    void createGlyph(GLFontData *font, unsigned int codepoint, NP::GlyphCache::Glyph &glyph);
+
     Vec2 _world_size;
     GLRendererPriv *priv;
 };
@@ -17,22 +17,33 @@
 
 #include "Os.h"
 #include "Config.h"
+#include "Assets.h"
 
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+#include <algorithm>
+#include <cstring>
 
-class SDLFontData : public NP::FontData {
+
+class SDLFontData : public GLFontData {
 public:
     SDLFontData(const char *filename, int size);
     ~SDLFontData();
 
+    virtual int lineHeight();
+    virtual void rasterize(unsigned int codepoint, Bitmap &bitmap);
+    virtual int kerning(unsigned int left, unsigned int right);
+
+    // SDL_ttf reads from the mapping for as long as the font is open
+    Asset m_file;
     TTF_Font *m_font;
 };
 
 SDLFontData::SDLFontData(const char *filename, int size)
-    : NP::FontData(size)
-    , m_font(TTF_OpenFont(filename, size))
+    : GLFontData(size)
+    , m_file(Assets::open(filename))
+    , m_font(TTF_OpenFontRW(SDL_RWFromConstMem(m_file.data(), m_file.size()), 1, size))
 {
 }
 
@@ -41,6 +52,72 @@ SDLFontData::~SDLFontData()
     TTF_CloseFont(m_font);
 }
 
+int
+SDLFontData::lineHeight()
+{
+    return TTF_FontHeight(m_font);
+}
+
+void
+SDLFontData::rasterize(unsigned int codepoint, Bitmap &bitmap)
+{
+    // Rendered as a one character string, so that the glyph sits on the
+    // same baseline as in a whole line (TTF_RenderGlyph_* is UCS-2 only)
+    char text[5] = {};
+    if (codepoint < 0x80) {
+        text[0] = codepoint;
+    } else if (codepoint < 0x800) {
+        text[0] = 0xc0 | (codepoint >> 6);
+        text[1] = 0x80 | (codepoint & 0x3f);
+    } else if (codepoint < 0x10000) {
+        text[0] = 0xe0 | (codepoint >> 12);
+        text[1] = 0x80 | ((codepoint >> 6) & 0x3f);
+        text[2] = 0x80 | (codepoint & 0x3f);
+    } else {
+        text[0] = 0xf0 | (codepoint >> 18);
+        text[1] = 0x80 | ((codepoint >> 12) & 0x3f);
+        text[2] = 0x80 | ((codepoint >> 6) & 0x3f);
+        text[3] = 0x80 | (codepoint & 0x3f);
+    }
+
+    int minx, maxx, miny, maxy, advance;
+    if (codepoint < 0x10000 && TTF_GlyphMetrics(m_font, codepoint, &minx, &maxx, &miny, &maxy, &advance) == 0) {
+        bitmap.advance = advance;
+        // The line starts further right when the glyph reaches left of the pen
+        bitmap.x = std::min(0, minx);
+    } else {
+        TTF_SizeUTF8(m_font, text, &bitmap.advance, nullptr);
+    }
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(m_font, text, white);
+    if (!surface) {
+        return;
+    }
+
+    SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ABGR8888, 0);
+    SDL_FreeSurface(surface);
+
+    bitmap.w = rgba->w;
+    bitmap.h = rgba->h;
+    bitmap.pixels.resize(rgba->w * rgba->h * 4);
+    for (int y=0; y<rgba->h; y++) {
+        memcpy(&bitmap.pixels[y * rgba->w * 4], (char *)rgba->pixels + y * rgba->pitch, rgba->w * 4);
+    }
+    SDL_FreeSurface(rgba);
+}
+
+int
+SDLFontData::kerning(unsigned int left, unsigned int right)
+{
+#if defined(SDL_TTF_VERSION_ATLEAST)
+#if SDL_TTF_VERSION_ATLEAST(2, 0, 14)
+    return TTF_GetFontKerningSizeGlyphs(m_font, left, right);
+#endif
+#endif
+    return 0;
+}
+
 
 SDL2Renderer::SDL2Renderer(Vec2 world_size)
     : GLRenderer(world_size)
@@ -89,13 +166,14 @@ SDL2Renderer::load(const char *filename, bool cache)
         }
     }
 
-    std::string f = Config::findFile(filename);
+    Asset file = Assets::open(filename);
 
-    SDL_Surface *img = IMG_Load(f.c_str());
+    SDL_Surface *img = IMG_Load_RW(SDL_RWFromConstMem(file.data(), file.size()), 1);
     SDL_Surface *tmp = SDL_ConvertSurfaceFormat(img, SDL_PIXELFORMAT_ABGR8888, 0);
     SDL_FreeSurface(img);
 
-    NP::Texture result = GLRenderer::load((unsigned char *)tmp->pixels, img->w, img->h);
+    unsigned char *pixels = (unsigned char *)tmp->pixels;
+    NP::Texture result = cache ? loadAtlas(pixels, tmp->w, tmp->h) : GLRenderer::load(pixels, tmp->w, tmp->h);
     SDL_FreeSurface(tmp);
 
     if (cache) {
@@ -112,42 +190,6 @@ SDL2Renderer::load(const char *filename, int size)
     return NP::Font(new SDLFontData(filename, size));
 }
 
-void
-SDL2Renderer::metrics(const NP::Font &font, const char *text, int *width, int *height)
-{
-    SDLFontData *data = static_cast<SDLFontData *>(font.get());
-
-    TTF_SizeUTF8(data->m_font, text, width, height);
-}
-
-NP::Texture
-SDL2Renderer::text(const NP::Font &font, const char *text, int rgb)
-{
-    if (strlen(text) == 0) {
-        return NP::Texture(new GLTextureData(nullptr, 10, 10));
-    }
-
-    SDLFontData *data = static_cast<SDLFontData *>(font.get());
-
-    int r = (Uint8)((rgb >> 16) & 0xff);
-    int g = (Uint8)((rgb >> 8) & 0xff);
-    int b = (Uint8)((rgb) & 0xff);
-
-    union {
-        Uint32 value;
-        SDL_Color color;
-    } fg;
-
-    fg.value = SDL_MapRGB(m_pixelformat, r, g, b);
-
-    SDL_Surface *surface = TTF_RenderUTF8_Blended(data->m_font, text, fg.color);
-    NP::Texture result = GLRenderer::load((unsigned char *)surface->pixels,
-                                          surface->w, surface->h);
-    SDL_FreeSurface(surface);
-
-    return result;
-}
-
 void
 SDL2Renderer::swap()
 {
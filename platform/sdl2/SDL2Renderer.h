@@ -33,9 +33,6 @@ public:
 
     virtual NP::Font load(const char *filename, int size);
 
-    virtual void metrics(const NP::Font &font, const char *text, int *width, int *height);
-    virtual NP::Texture text(const NP::Font &font, const char *text, int rgb);
-
     virtual void swap();
 
 private:
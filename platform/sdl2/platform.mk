@@ -0,0 +1,13 @@
+# Platform build definition for SDL2
+# Will be processed by makefile
+
+$(eval $(call add_platform,freedesktop))
+$(eval $(call add_platform,gl))
+
+$(eval $(call add_pkgconfig,sdl2))
+$(eval $(call add_pkgconfig,SDL2_image))
+$(eval $(call add_pkgconfig,SDL2_ttf))
+$(eval $(call add_pkgconfig,gio-2.0))
+
+include platform/gl/gl.mk
+include platform/freedesktop/install.mk
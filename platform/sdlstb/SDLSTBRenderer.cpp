@@ -17,21 +17,29 @@
 
 #include "Os.h"
 #include "Config.h"
+#include "Assets.h"
 
 #include "stb_loader.h"
 
 
-class EmscriptenFontData : public NP::FontData {
+class EmscriptenFontData : public GLFontData {
 public:
     EmscriptenFontData(const char *filename, int size);
     ~EmscriptenFontData();
 
-    std::string filename;
+    virtual int lineHeight();
+    virtual void rasterize(unsigned int codepoint, Bitmap &bitmap);
+    virtual int kerning(unsigned int left, unsigned int right);
+
+    // Mapped once, glyphs are rendered straight from it
+    Asset file;
+    StbLoader_Font font;
 };
 
 EmscriptenFontData::EmscriptenFontData(const char *filename, int size)
-    : NP::FontData(size)
-    , filename(filename)
+    : GLFontData(size)
+    , file(Assets::open(filename))
+    , font(file.data(), file.size(), size)
 {
 }
 
@@ -39,6 +47,30 @@ EmscriptenFontData::~EmscriptenFontData()
 {
 }
 
+int
+EmscriptenFontData::lineHeight()
+{
+    return font.height();
+}
+
+void
+EmscriptenFontData::rasterize(unsigned int codepoint, Bitmap &bitmap)
+{
+    StbLoader_RGBA *rgba = font.render_glyph(codepoint, &bitmap.x, &bitmap.y, &bitmap.advance);
+    if (rgba) {
+        bitmap.w = rgba->w;
+        bitmap.h = rgba->h;
+        bitmap.pixels.assign(rgba->data, rgba->data + rgba->w * rgba->h * 4);
+        delete rgba;
+    }
+}
+
+int
+EmscriptenFontData::kerning(unsigned int left, unsigned int right)
+{
+    return font.kerning(left, right);
+}
+
 
 SDLSTBRenderer::SDLSTBRenderer(Vec2 world_size, Vec2 framebuffer_size)
     : GLRenderer(world_size)
@@ -71,10 +103,10 @@ SDLSTBRenderer::load(const char *filename, bool cache)
         }
     }
 
-    Blob *blob = Config::readBlob(filename);
-    StbLoader_RGBA *rgba = StbLoader::decode_image(blob->data, blob->len);
-    delete blob;
-    NP::Texture result = GLRenderer::load((unsigned char *)rgba->data, rgba->w, rgba->h);
+    Asset file = Assets::open(filename);
+    StbLoader_RGBA *rgba = StbLoader::decode_image(file.data(), file.size());
+    unsigned char *pixels = (unsigned char *)rgba->data;
+    NP::Texture result = cache ? loadAtlas(pixels, rgba->w, rgba->h) : GLRenderer::load(pixels, rgba->w, rgba->h);
     delete rgba;
 
     if (cache) {
@@ -91,42 +123,6 @@ SDLSTBRenderer::load(const char *filename, int size)
     return NP::Font(new EmscriptenFontData(filename, size));
 }
 
-void
-SDLSTBRenderer::metrics(const NP::Font &font, const char *text, int *width, int *height)
-{
-    EmscriptenFontData *data = static_cast<EmscriptenFontData *>(font.get());
-
-    Blob *blob = Config::readBlob(data->filename);
-    StbLoader_RGBA *rgba = StbLoader::render_font(blob->data, blob->len,
-            StbLoader_Color(0.f, 0.f, 0.f, 1.f), data->size, text);
-    *width = rgba->w;
-    *height = rgba->h;
-    delete rgba;
-    delete blob;
-}
-
-NP::Texture
-SDLSTBRenderer::text(const NP::Font &font, const char *text, int rgb)
-{
-    if (strlen(text) == 0) {
-        return NP::Texture(new GLTextureData(nullptr, 10, 10));
-    }
-
-    EmscriptenFontData *data = static_cast<EmscriptenFontData *>(font.get());
-
-    float r = 1.f * (Uint8)((rgb >> 16) & 0xff) / 255.f;
-    float g = 1.f * (Uint8)((rgb >> 8) & 0xff) / 255.f;
-    float b = 1.f * (Uint8)((rgb) & 0xff) / 255.f;
-
-    Blob *blob = Config::readBlob(data->filename);
-    StbLoader_RGBA *rgba = StbLoader::render_font(blob->data, blob->len,
-            StbLoader_Color(r, g, b, 1.f), data->size, text);
-    NP::Texture result = GLRenderer::load((unsigned char *)rgba->data, rgba->w, rgba->h);
-    delete rgba;
-    delete blob;
-    return result;
-}
-
 void
 SDLSTBRenderer::swap()
 {
@@ -24,6 +24,9 @@
 #include "Font.h"
 #include "Dialogs.h"
 #include "Event.h"
+#include "Batch.h"
+#include "DemoJournal.h"
+#include "RecordingRenderer.h"
 
 #include "thp_timestep.h"
 #include "thp_format.h"
@@ -42,6 +45,9 @@ class App : private Container, public MainLoop
   bool m_quit;
   Window *m_window;
   thp::Timestep m_timestep;
+  std::string m_record_file;
+  RecordingRenderer *m_recorder;
+  ScopedRenderer *m_recording;
 public:
   App(int argc, char** argv)
     : m_width(WORLD_WIDTH)
@@ -49,6 +55,9 @@ public:
     , m_quit(false)
     , m_window(NULL)
     , m_timestep(ITERATION_RATE)
+    , m_record_file()
+    , m_recorder(NULL)
+    , m_recording(NULL)
   {
       OS->ensurePath(OS->userDataDir());
       OS->init();
@@ -59,12 +68,25 @@ public:
           if (i < argc-1 && strcmp(argv[i], "--lang") == 0) {
               LOG_DEBUG("Trying to load translation for '%s'", argv[i+1]);
               Tr::load(thp::format("i18n/%s", argv[i+1]));
+          } else if (i < argc-1 && strcmp(argv[i], "--record-frames") == 0) {
+              m_record_file = argv[i+1];
           }
       }
 
+      if (!m_record_file.empty()) {
+          // Before the window draws anything, so that the recording
+          // has everything the frames use
+          OS->window(Vec2(m_width, m_height));
+          m_recorder = new RecordingRenderer(OS->renderer());
+          m_recording = new ScopedRenderer(m_recorder, true);
+      }
+
       m_window = new Window(m_width,m_height,"Numpty Physics");
       sizeTo(Vec2(m_width,m_height));
 
+      // Before the scan, so that the demos show up in the list
+      DemoJournal::recover(Config::userRecordingDir());
+
       Levels *levels = new Levels({Config::defaultLevelPath(), OS->userDataDir()});
       levels->dump();
 
@@ -74,12 +96,29 @@ public:
   ~App()
   {
     delete m_window;
+    stopRecording();
   }
 
   const char* name() {return "App";}
 
 private:
 
+  void stopRecording()
+  {
+      if (!m_recorder) {
+          return;
+      }
+
+      delete m_recording;
+      m_recording = NULL;
+      if (m_recorder->save(m_record_file)) {
+          LOG_INFO("Recorded %d frames (%d bytes) to %s", m_recorder->frames(),
+                   int(m_recorder->commands().size()), m_record_file.c_str());
+      }
+      delete m_recorder;
+      m_recorder = NULL;
+  }
+
   void render()
   {
       auto world = OS->renderer()->world_rect();
@@ -87,11 +126,18 @@ private:
       m_window->clear();
       draw(*m_window, world);
       m_window->update();
+
+      if (m_recorder) {
+          LOG_DEBUG("Frame %d: %s", m_recorder->frames(), m_recorder->lastFrame().str().c_str());
+      }
   }
 
 
   bool processEvent(ToolkitEvent &ev)
   {
+      // Any input (or window system event) can change what is on screen
+      dirty();
+
       switch (ev.type) {
           case ToolkitEvent::QUIT:
               m_quit = true;
@@ -107,8 +153,10 @@ private:
                   default:
                       break;
               }
-
+              break;
           case ToolkitEvent::RESIZE:
+              // Some platforms replace the renderer the recorder draws with
+              stopRecording();
               delete m_window;
               m_window = new Window(m_width, m_height, "Numpty Physics");
               break;
@@ -144,7 +192,15 @@ private:
           }
       });
 
-      render();
+      if (isDirty()) {
+          clean();
+          render();
+      } else {
+#if !defined(__EMSCRIPTEN__)
+          // Nothing changed since the last frame, which is still on screen
+          OS->delay(m_timestep.ms_per_tick());
+#endif
+      }
 
       return !m_quit;
   }
@@ -161,5 +217,11 @@ npmain(int argc, char **argv)
         }
     }
     OS->init(argc, argv);
+
+    int result;
+    if (Batch::run(argc, argv, result)) {
+        exit(result);
+    }
+
     return new App(argc, argv);
 }
@@ -0,0 +1,89 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "Arena.h"
+
+#include "petals_log.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+// Enough for the block allocator chunks of a typical level; the b2World
+// itself (~100 KiB, mostly its stack allocator) gets a chunk of its own.
+static const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+static const size_t ARENA_ALIGNMENT = 16;
+
+
+Arena::Arena()
+    : m_chunks()
+    , m_current(0)
+    , m_stats()
+{
+}
+
+Arena::~Arena()
+{
+    for (auto &chunk: m_chunks) {
+        free(chunk.data);
+    }
+}
+
+void *
+Arena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    // After a reset the chunks are handed out again in the same order,
+    // so a level with the same shape as the previous one mallocs nothing.
+    while (m_current < m_chunks.size()) {
+        Chunk &chunk = m_chunks[m_current];
+        if (chunk.used + size <= chunk.size) {
+            void *result = chunk.data + chunk.used;
+            chunk.used += size;
+            m_stats.allocations++;
+            m_stats.bytes += size;
+            return result;
+        }
+        m_current++;
+    }
+
+    size_t chunksize = std::max(size, ARENA_CHUNK_SIZE);
+    char *data = static_cast<char *>(malloc(chunksize));
+    if (!data) {
+        LOG_FATAL("Cannot allocate %d bytes for level arena", int(chunksize));
+    }
+
+    m_chunks.push_back(Chunk{data, chunksize, size});
+    m_stats.chunks++;
+    m_stats.mallocs++;
+    m_stats.allocations++;
+    m_stats.bytes += size;
+
+    return data;
+}
+
+void
+Arena::reset()
+{
+    for (auto &chunk: m_chunks) {
+        chunk.used = 0;
+    }
+
+    m_current = 0;
+    m_stats.allocations = 0;
+    m_stats.bytes = 0;
+    m_stats.resets++;
+}
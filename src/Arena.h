@@ -0,0 +1,72 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_ARENA_H
+#define NUMPTYPHYSICS_ARENA_H
+
+#include "Box2D.h"
+
+#include <vector>
+#include <cstddef>
+
+
+/**
+ * Bump allocator for everything that lives exactly as long as one level:
+ * the b2World (and through it bodies, shapes, joints, contacts and the
+ * broad-phase) and the Stroke objects of the scene.
+ *
+ * Nothing is freed individually. reset() rewinds all chunks in one go,
+ * so a level switch costs no per-object deallocation and the chunks are
+ * reused by the next level instead of going back to the system allocator.
+ **/
+class Arena : public b2Arena {
+public:
+    struct Stats {
+        Stats() : allocations(0), bytes(0), chunks(0), mallocs(0), resets(0) {}
+
+        int allocations; // since the last reset
+        size_t bytes;    // since the last reset
+        int chunks;      // currently owned
+        int mallocs;     // chunk allocations from the system, ever
+        int resets;
+    };
+
+    Arena();
+    ~Arena();
+
+    void *allocate(size_t size);
+    void reset();
+
+    const Stats &stats() const { return m_stats; }
+
+    // b2Arena
+    virtual void *Allocate(int32 size) { return allocate(size); }
+
+private:
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    struct Chunk {
+        char *data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Chunk> m_chunks;
+    size_t m_current;
+    Stats m_stats;
+};
+
+#endif /* NUMPTYPHYSICS_ARENA_H */
@@ -0,0 +1,506 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "AssetPack.h"
+#include "BinaryLevel.h"
+#include "Config.h"
+#include "Scene.h"
+#include "Os.h"
+
+#include "petals_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+
+const char *AssetPack::FILENAME = "assets.pack";
+
+namespace {
+
+// "NPK1" when read back on a host with the same byte order
+const uint32_t NPK_MAGIC = 0x314b504e;
+const uint32_t NPK_VERSION = 2;
+
+const uint32_t NPK_PAGE_SIZE = 4096;
+const char NPK_SEPARATOR = '/';
+
+enum {
+    NPK_DIRECTORY = 1 << 0,
+};
+
+struct NpkHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t entries, entryCount;
+    // Open addressing, entry index + 1 per bucket, 0 if empty
+    uint32_t buckets, bucketCount;
+    // newestChange() of the packed directory
+    uint32_t newest;
+};
+
+struct NpkEntry {
+    uint32_t hash;
+    uint32_t flags;
+    // Path below the root, NPK_SEPARATOR separated; "" for the root
+    uint32_t name, nameLength;
+    // File contents, or first child entry and number of children
+    uint32_t offset, size;
+};
+
+// FNV-1a
+uint32_t
+hashPath(const char *s, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<len; i++) {
+        hash = (hash ^ uint8_t(s[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool
+inRange(size_t size, uint32_t offset, uint32_t count, size_t recordSize)
+{
+    return offset <= size && count <= (size - offset) / recordSize;
+}
+
+const NpkHeader *
+header(const char *data)
+{
+    return reinterpret_cast<const NpkHeader *>(data);
+}
+
+const NpkEntry *
+entries(const char *data)
+{
+    return reinterpret_cast<const NpkEntry *>(data + header(data)->entries);
+}
+
+const uint32_t *
+buckets(const char *data)
+{
+    return reinterpret_cast<const uint32_t *>(data + header(data)->buckets);
+}
+
+bool
+validate(const char *data, size_t size)
+{
+    if (size < sizeof(NpkHeader)) {
+        return false;
+    }
+
+    const NpkHeader *h = header(data);
+    if (h->magic != NPK_MAGIC || h->version != NPK_VERSION || h->size != size ||
+            h->entryCount == 0 || h->entries % 4 != 0 || h->buckets % 4 != 0 ||
+            !inRange(size, h->entries, h->entryCount, sizeof(NpkEntry)) ||
+            !inRange(size, h->buckets, h->bucketCount, sizeof(uint32_t)) ||
+            h->bucketCount < h->entryCount || (h->bucketCount & (h->bucketCount - 1)) != 0) {
+        return false;
+    }
+
+    for (uint32_t i=0; i<h->entryCount; i++) {
+        const NpkEntry &e = entries(data)[i];
+        if (!inRange(size, e.name, e.nameLength, 1)) {
+            return false;
+        }
+        if (e.flags & NPK_DIRECTORY) {
+            if (e.offset > h->entryCount || e.size > h->entryCount - e.offset) {
+                return false;
+            }
+        } else if (!inRange(size, e.offset, e.size, 1)) {
+            return false;
+        }
+    }
+
+    // find() probes until it hits an empty bucket, so there must be one
+    uint32_t used = 0;
+    for (uint32_t i=0; i<h->bucketCount; i++) {
+        if (buckets(data)[i] > h->entryCount) {
+            return false;
+        }
+        if (buckets(data)[i] != 0) {
+            used++;
+        }
+    }
+
+    return used < h->bucketCount;
+}
+
+void
+pad(std::string &out, uint32_t alignment)
+{
+    out.resize((out.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+bool
+isTextLevel(const std::string &name)
+{
+    size_t dot = name.rfind('.');
+    std::string ext = (dot == std::string::npos) ? "" : name.substr(dot);
+    return ext == ".nph" || ext == ".npsvg";
+}
+
+std::string
+stem(const std::string &name)
+{
+    return name.substr(0, name.rfind('.'));
+}
+
+// Hidden files and the pack itself (or its temporary) aren't packed
+bool
+skipped(const std::string &name, bool root)
+{
+    return name[0] == '.' || (root && name.compare(0, strlen(AssetPack::FILENAME), AssetPack::FILENAME) == 0);
+}
+
+// Latest modification time of anything below dir; directories count, so
+// that adding, removing and renaming files is noticed, except for the
+// top level one, which changes whenever the pack is written
+time_t
+newestChange(const std::string &dir, bool root=true)
+{
+    time_t newest = 0;
+
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return newest;
+    }
+
+    while (struct dirent *entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (skipped(name, root)) {
+            continue;
+        }
+
+        std::string path = Config::joinPath(dir, name);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            continue;
+        }
+
+        newest = std::max(newest, st.st_mtime);
+        if (S_ISDIR(st.st_mode)) {
+            newest = std::max(newest, newestChange(path, false));
+        }
+    }
+    closedir(d);
+
+    return newest;
+}
+
+}; /* namespace */
+
+
+AssetPack::AssetPack(const std::string &root)
+    : m_root(root)
+    , m_file()
+    , m_mtime(0)
+{
+    // Without a pack everything is read from loose files
+    std::string filename = Config::joinPath(root, FILENAME);
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return;
+    }
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(filename);
+    if (!file->valid() || !validate(file->data(), file->size())) {
+        LOG_WARNING("Ignoring invalid asset pack %s", filename.c_str());
+        return;
+    }
+
+    // Edited loose files would be shadowed by their old packed copies
+    if (newestChange(root) > time_t(header(file->data())->newest)) {
+        LOG_WARNING("Ignoring asset pack %s, %s has changed since it was built",
+                    filename.c_str(), root.c_str());
+        return;
+    }
+
+    m_file = file;
+    m_mtime = st.st_mtime;
+    LOG_INFO("Using asset pack %s (%d entries)", filename.c_str(),
+             int(header(m_file->data())->entryCount));
+}
+
+int
+AssetPack::find(const std::string &path) const
+{
+    if (!m_file || path.compare(0, m_root.size(), m_root) != 0) {
+        return -1;
+    }
+
+    std::string name;
+    if (path.size() > m_root.size()) {
+        if (path[m_root.size()] != Os::pathSep) {
+            return -1;
+        }
+        name = path.substr(m_root.size() + 1);
+        std::replace(name.begin(), name.end(), Os::pathSep, NPK_SEPARATOR);
+    }
+
+    const char *data = m_file->data();
+    const NpkHeader *h = header(data);
+    uint32_t hash = hashPath(name.data(), name.size());
+    uint32_t mask = h->bucketCount - 1;
+    for (uint32_t i=hash & mask; buckets(data)[i] != 0; i = (i + 1) & mask) {
+        int index = buckets(data)[i] - 1;
+        const NpkEntry &e = entries(data)[index];
+        if (e.hash == hash && e.nameLength == name.size() &&
+                memcmp(data + e.name, name.data(), name.size()) == 0) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+Asset
+AssetPack::open(const std::string &path) const
+{
+    int index = find(path);
+    if (index == -1) {
+        return Asset();
+    }
+
+    const NpkEntry &e = entries(m_file->data())[index];
+    if (e.flags & NPK_DIRECTORY) {
+        return Asset();
+    }
+
+    return Asset(m_file, m_file->data() + e.offset, e.size);
+}
+
+bool
+AssetPack::isFile(const std::string &path, size_t *size) const
+{
+    int index = find(path);
+    if (index == -1) {
+        return false;
+    }
+
+    const NpkEntry &e = entries(m_file->data())[index];
+    if (e.flags & NPK_DIRECTORY) {
+        return false;
+    }
+
+    if (size) {
+        *size = e.size;
+    }
+    return true;
+}
+
+bool
+AssetPack::isDirectory(const std::string &path) const
+{
+    int index = find(path);
+    return index != -1 && (entries(m_file->data())[index].flags & NPK_DIRECTORY);
+}
+
+bool
+AssetPack::list(const std::string &path, std::vector<Entry> &result) const
+{
+    int index = find(path);
+    if (index == -1) {
+        return false;
+    }
+
+    const char *data = m_file->data();
+    const NpkEntry &dir = entries(data)[index];
+    if (!(dir.flags & NPK_DIRECTORY)) {
+        return false;
+    }
+
+    for (uint32_t i=dir.offset; i<dir.offset + dir.size; i++) {
+        const NpkEntry &e = entries(data)[i];
+        std::string name(data + e.name, e.nameLength);
+        size_t sep = name.rfind(NPK_SEPARATOR);
+        if (sep != std::string::npos) {
+            name = name.substr(sep + 1);
+        }
+        result.push_back(Entry{name, (e.flags & NPK_DIRECTORY) != 0});
+    }
+
+    return true;
+}
+
+bool
+AssetPack::build(const std::string &dir, const std::string &filename, bool compile)
+{
+    std::vector<NpkEntry> records;
+    std::vector<std::string> paths; // on disk, for each record
+    std::vector<std::string> contents;
+    std::string names;
+
+    // Taken before reading, a file changed meanwhile makes the pack stale
+    time_t newest = newestChange(dir);
+
+    records.push_back(NpkEntry{hashPath("", 0), NPK_DIRECTORY, 0, 0, 0, 0});
+    paths.push_back(dir);
+    contents.push_back("");
+
+    Scene scene;
+
+    // Breadth first, so that the children of a directory are adjacent
+    for (size_t i=0; i<records.size(); i++) {
+        if (!(records[i].flags & NPK_DIRECTORY)) {
+            continue;
+        }
+
+        DIR *d = opendir(paths[i].c_str());
+        if (!d) {
+            LOG_WARNING("Cannot read %s", paths[i].c_str());
+            return false;
+        }
+
+        std::vector<std::string> children;
+        while (struct dirent *entry = readdir(d)) {
+            std::string name = entry->d_name;
+            if (skipped(name, i == 0)) {
+                continue;
+            }
+            children.push_back(name);
+        }
+        closedir(d);
+        std::sort(children.begin(), children.end());
+
+        std::string prefix(names.data() + records[i].name, records[i].nameLength);
+        if (!prefix.empty()) {
+            prefix += NPK_SEPARATOR;
+        }
+
+        records[i].offset = records.size();
+        for (auto &child: children) {
+            std::string path = Config::joinPath(paths[i], child);
+            std::string name = prefix + child;
+            std::string data;
+            uint32_t flags = 0;
+
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                flags = NPK_DIRECTORY;
+            } else if (compile && isTextLevel(child)) {
+                if (std::binary_search(children.begin(), children.end(),
+                                       stem(child) + BinaryLevel::EXTENSION)) {
+                    // Already compiled next to it
+                    continue;
+                }
+
+                // Straight from disk, never from an older pack
+                MappedFile text(path);
+                if (!text.valid() || !scene.load(text.data(), text.size())) {
+                    LOG_WARNING("Cannot compile %s", path.c_str());
+                    return false;
+                }
+                data = BinaryLevel::serialize(scene);
+                name = stem(name) + BinaryLevel::EXTENSION;
+            } else {
+                MappedFile file(path);
+                if (!file.valid()) {
+                    LOG_WARNING("Cannot read %s", path.c_str());
+                    return false;
+                }
+                data.assign(file.data(), file.size());
+            }
+
+            records.push_back(NpkEntry{hashPath(name.data(), name.size()), flags,
+                                       uint32_t(names.size()), uint32_t(name.size()), 0, 0});
+            paths.push_back(path);
+            contents.push_back(data);
+            names += name;
+        }
+        records[i].size = records.size() - records[i].offset;
+    }
+
+    uint32_t bucketCount = 1;
+    while (bucketCount < records.size() * 2) {
+        bucketCount *= 2;
+    }
+
+    std::vector<uint32_t> table(bucketCount, 0);
+    for (size_t i=0; i<records.size(); i++) {
+        uint32_t mask = bucketCount - 1;
+        uint32_t slot = records[i].hash & mask;
+        while (table[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = i + 1;
+    }
+
+    NpkHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = NPK_MAGIC;
+    h.version = NPK_VERSION;
+    h.entries = sizeof(NpkHeader);
+    h.entryCount = records.size();
+    h.buckets = h.entries + records.size() * sizeof(NpkEntry);
+    h.bucketCount = bucketCount;
+    h.newest = newest;
+
+    uint32_t nameBase = h.buckets + bucketCount * sizeof(uint32_t);
+
+    // Contents go after the index, each on its own pages
+    std::string blobs;
+    uint32_t blobBase = (nameBase + names.size() + NPK_PAGE_SIZE - 1) / NPK_PAGE_SIZE * NPK_PAGE_SIZE;
+    for (size_t i=0; i<records.size(); i++) {
+        records[i].name += nameBase;
+        if (!(records[i].flags & NPK_DIRECTORY)) {
+            pad(blobs, NPK_PAGE_SIZE);
+            records[i].offset = blobBase + blobs.size();
+            records[i].size = contents[i].size();
+            blobs += contents[i];
+        }
+    }
+    h.size = blobBase + blobs.size();
+
+    std::string result;
+    result.reserve(h.size);
+    result.append(reinterpret_cast<const char *>(&h), sizeof(h));
+    result.append(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(NpkEntry));
+    result.append(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(uint32_t));
+    result.append(names);
+    pad(result, NPK_PAGE_SIZE);
+    result.append(blobs);
+
+    std::string tmpname = filename + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "wb");
+    if (!fp) {
+        LOG_WARNING("Cannot write %s", tmpname.c_str());
+        return false;
+    }
+
+    bool ok = (fwrite(result.data(), 1, result.size(), fp) == result.size());
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+#if defined(_WIN32)
+    remove(filename.c_str());
+#endif
+    if (!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LOG_WARNING("Cannot write %s", filename.c_str());
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    LOG_INFO("Packed %d entries into %s (%d bytes)", int(records.size()), filename.c_str(), int(result.size()));
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_ASSETPACK_H
+#define NUMPTYPHYSICS_ASSETPACK_H
+
+#include "Assets.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+
+/**
+ * Read-only image of the data directory in a single file
+ *
+ * The pack starts with a table of all files and directories (children
+ * of a directory are stored next to each other) and a hash table over
+ * their paths, followed by the file contents, each starting on a page
+ * boundary. It is mapped once, after which looking up, listing and
+ * reading packed files costs no system calls at all. Text levels can
+ * be stored compiled to .npb when the pack is built.
+ *
+ * Paths are given the same way as for loose files (below the root
+ * directory the pack was opened for); anything not in the pack, such as
+ * user data, has to be read from the file system as before. A pack
+ * older than the newest file in its directory is not used at all.
+ **/
+class AssetPack {
+public:
+    static const char *FILENAME;
+
+    struct Entry {
+        std::string name;
+        bool directory;
+    };
+
+    // Opens root/FILENAME if it exists
+    AssetPack(const std::string &root);
+
+    bool valid() const { return m_file != nullptr; }
+    long mtime() const { return m_mtime; }
+
+    // Invalid Asset if path is not a packed file
+    Asset open(const std::string &path) const;
+    bool isFile(const std::string &path, size_t *size=nullptr) const;
+    bool isDirectory(const std::string &path) const;
+    // Direct children of a packed directory
+    bool list(const std::string &path, std::vector<Entry> &entries) const;
+
+    // compile: store .nph/.npsvg levels as .npb
+    static bool build(const std::string &dir, const std::string &filename, bool compile);
+
+private:
+    int find(const std::string &path) const;
+
+    std::string m_root;
+    std::shared_ptr<MappedFile> m_file;
+    long m_mtime;
+};
+
+#endif /* NUMPTYPHYSICS_ASSETPACK_H */
@@ -0,0 +1,66 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "Assets.h"
+#include "AssetPack.h"
+#include "Config.h"
+
+#include <unordered_map>
+#include <mutex>
+
+
+static std::mutex
+g_assets_mutex;
+
+static std::unordered_map<std::string, std::weak_ptr<MappedFile>>
+g_assets;
+
+
+const AssetPack &
+Assets::pack()
+{
+    static AssetPack pack(OS->globalDataDir());
+    return pack;
+}
+
+Asset
+Assets::open(const std::string &name)
+{
+    Asset packed = pack().open(name);
+    if (packed.valid()) {
+        return packed;
+    }
+
+    std::string filename = Config::findFile(name);
+    packed = pack().open(filename);
+    if (packed.valid()) {
+        return packed;
+    }
+
+    std::lock_guard<std::mutex> lock(g_assets_mutex);
+
+    auto &entry = g_assets[filename];
+    std::shared_ptr<MappedFile> file = entry.lock();
+    if (!file) {
+        file = std::make_shared<MappedFile>(filename);
+        if (!file->valid()) {
+            g_assets.erase(filename);
+            return Asset();
+        }
+        entry = file;
+    }
+
+    return Asset(file, file->data(), file->size());
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_ASSETS_H
+#define NUMPTYPHYSICS_ASSETS_H
+
+#include "MappedFile.h"
+
+#include <string>
+#include <memory>
+
+
+class AssetPack;
+
+/**
+ * Shared read-only view of a whole file
+ *
+ * Copies are cheap and refer to the same mapping (of the file itself or
+ * of the asset pack containing it), which stays valid until the last
+ * copy is gone.
+ **/
+class Asset {
+public:
+    Asset() : m_file(), m_data(nullptr), m_size(0) {}
+
+    bool valid() const { return m_file != nullptr; }
+    const char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    std::string str() const { return valid() ? std::string(m_data, m_size) : std::string(); }
+
+private:
+    friend class Assets;
+    friend class AssetPack;
+
+    Asset(const std::shared_ptr<MappedFile> &file, const char *data, size_t size)
+        : m_file(file)
+        , m_data(data)
+        , m_size(size)
+    {
+    }
+
+    std::shared_ptr<MappedFile> m_file;
+    const char *m_data;
+    size_t m_size;
+};
+
+/**
+ * Maps data and user files on demand
+ *
+ * Files in the asset pack of the global data directory are served from
+ * the pack; everything else is mapped on its own. While an Asset of a
+ * file is alive, opening the file again hands out the same mapping
+ * instead of reading it a second time.
+ **/
+class Assets {
+public:
+    // name is looked up with Config::findFile()
+    static Asset open(const std::string &name);
+
+    // Pack of the global data directory, opened on first use
+    static const AssetPack &pack();
+};
+
+#endif /* NUMPTYPHYSICS_ASSETS_H */
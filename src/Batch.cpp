@@ -0,0 +1,544 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "Batch.h"
+#include "BinaryLevel.h"
+#include "Config.h"
+#include "Scene.h"
+#include "SVGReader.h"
+#include "Assets.h"
+#include "AssetPack.h"
+#include "Path.h"
+#include "Canvas.h"
+#include "SoftwareRenderer.h"
+#include "RecordingRenderer.h"
+#include "Thumbnails.h"
+#include "Os.h"
+
+#include "thp_format.h"
+
+#include "petals_log.h"
+
+#include <sys/types.h>
+#include <dirent.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#include <mutex>
+#include <atomic>
+#endif
+
+
+static const int BENCHMARK_ROUNDS = 20;
+
+static bool
+hasExtension(const std::string &file, const char *ext)
+{
+    size_t len = strlen(ext);
+    return file.size() > len && file.compare(file.size() - len, len, ext) == 0;
+}
+
+static bool
+isTextLevel(const std::string &file)
+{
+    // Demos stay in their text format, they are written by the game
+    return hasExtension(file, ".nph") || hasExtension(file, ".npsvg");
+}
+
+static void
+findLevels(const std::string &path, std::vector<std::string> &result)
+{
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        if (isTextLevel(path)) {
+            result.push_back(path);
+        }
+        return;
+    }
+
+    std::vector<std::string> entries;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            entries.push_back(path + Os::pathSep + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end());
+    for (auto &entry: entries) {
+        findLevels(entry, result);
+    }
+}
+
+static std::string
+compiledName(const std::string &file, const std::string &outdir)
+{
+    std::string name = file.substr(0, file.find_last_of('.')) + BinaryLevel::EXTENSION;
+    if (outdir.empty()) {
+        return name;
+    }
+    return Config::joinPath(outdir, Config::baseName(name));
+}
+
+static double
+elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    auto d = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+static int
+convert(int argc, char **argv)
+{
+    std::string outdir;
+    std::vector<std::string> files;
+    for (int i=2; i<argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i < argc-1) {
+            outdir = argv[++i];
+            OS->ensurePath(outdir);
+        } else {
+            findLevels(argv[i], files);
+        }
+    }
+
+    int failed = 0;
+    Scene scene;
+    for (auto &file: files) {
+        std::string target = compiledName(file, outdir);
+        Asset data = Assets::open(file);
+        if (scene.load(data.data(), data.size()) && BinaryLevel::write(scene, target)) {
+            printf("%s -> %s\n", file.c_str(), target.c_str());
+        } else {
+            fprintf(stderr, "Failed to convert %s\n", file.c_str());
+            failed++;
+        }
+    }
+
+    printf("Converted %d of %d levels\n", int(files.size()) - failed, int(files.size()));
+    return failed ? 1 : 0;
+}
+
+static int
+benchmark(int argc, char **argv)
+{
+    std::vector<std::string> files;
+    for (int i=2; i<argc; i++) {
+        findLevels(argv[i], files);
+    }
+
+    Scene scene;
+    double textTotal = 0.0, binaryTotal = 0.0;
+    size_t textBytes = 0, binaryBytes = 0;
+
+    for (auto &file: files) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i=0; i<BENCHMARK_ROUNDS; i++) {
+            Asset data = Assets::open(file);
+            scene.load(data.data(), data.size());
+        }
+        double text = elapsedMs(start) / BENCHMARK_ROUNDS;
+
+        std::string compiled = BinaryLevel::serialize(scene);
+        start = std::chrono::steady_clock::now();
+        for (int i=0; i<BENCHMARK_ROUNDS; i++) {
+            scene.loadBinary(compiled.data(), compiled.size());
+        }
+        double binary = elapsedMs(start) / BENCHMARK_ROUNDS;
+
+        size_t size = Assets::open(file).size();
+        printf("%8.3f ms %8.3f ms %7d -> %6d bytes  %s\n", text, binary,
+               int(size), int(compiled.size()), file.c_str());
+
+        textTotal += text;
+        binaryTotal += binary;
+        textBytes += size;
+        binaryBytes += compiled.size();
+    }
+
+    if (files.size()) {
+        printf("%d levels: text %.3f ms/level (%d bytes), compiled %.3f ms/level (%d bytes), %.1fx\n",
+               int(files.size()), textTotal / files.size(), int(textBytes),
+               binaryTotal / files.size(), int(binaryBytes),
+               binaryTotal > 0.0 ? textTotal / binaryTotal : 0.0);
+    }
+
+    return 0;
+}
+
+class PathCollector : public SVGReader::Handler {
+public:
+    PathCollector(std::vector<std::string> &paths)
+        : SVGReader::Handler()
+        , paths(paths)
+    {
+    }
+
+    virtual void element(const SVGReader::Range &name, const SVGReader &reader)
+    {
+        const SVGReader::Range *data = reader.attribute("d");
+        if (name == "path" && data) {
+            paths.push_back(std::string(data->begin, data->end));
+        }
+    }
+
+private:
+    std::vector<std::string> &paths;
+};
+
+template <typename F>
+static void
+parseThroughput(const char *what, const std::vector<std::string> &inputs, F parse)
+{
+    size_t bytes = 0;
+    for (auto &input: inputs) {
+        bytes += input.size();
+    }
+
+    size_t points = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<BENCHMARK_ROUNDS; i++) {
+        for (auto &input: inputs) {
+            points += parse(input).size();
+        }
+    }
+    double ms = elapsedMs(start);
+
+    printf("%-16s %8d bytes %7d points %8.3f ms/round %8.1f MB/s\n", what, int(bytes),
+           int(points / BENCHMARK_ROUNDS), ms / BENCHMARK_ROUNDS,
+           ms > 0.0 ? (bytes * BENCHMARK_ROUNDS / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0);
+}
+
+static int
+benchmarkParse(int argc, char **argv)
+{
+    std::vector<std::string> files;
+    for (int i=2; i<argc; i++) {
+        findLevels(argv[i], files);
+    }
+
+    std::vector<std::string> svgPaths;
+    for (auto &file: files) {
+        Asset data = Assets::open(file);
+        if (data.valid()) {
+            PathCollector collector(svgPaths);
+            SVGReader(data.data(), data.size()).parse(collector);
+        }
+    }
+
+    // The same points in the "x,y x,y" form of .nph stroke lines
+    std::vector<std::string> nphPaths;
+    for (auto &svg: svgPaths) {
+        std::string nph;
+        for (auto &p: Path::fromSVG(svg)) {
+            nph += thp::format("%s%d,%d", nph.empty() ? "" : " ", p.x, p.y);
+        }
+        nphPaths.push_back(nph);
+    }
+
+    printf("%d levels, %d paths\n", int(files.size()), int(svgPaths.size()));
+    parseThroughput("svg path data", svgPaths, [] (const std::string &s) {
+        return Path::fromSVG(s);
+    });
+    parseThroughput("nph point lists", nphPaths, [] (const std::string &s) {
+        return Path(s.c_str());
+    });
+
+    return 0;
+}
+
+static int
+buildPack(int argc, char **argv)
+{
+    std::string dir, output;
+    bool compile = false;
+    for (int i=2; i<argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            compile = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i < argc-1) {
+            output = argv[++i];
+        } else {
+            dir = argv[i];
+        }
+    }
+
+    if (dir.empty()) {
+        fprintf(stderr, "Usage: %s --build-pack [-c] [-o FILE] DIR\n", argv[0]);
+        return 1;
+    }
+
+    if (output.empty()) {
+        output = Config::joinPath(dir, AssetPack::FILENAME);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!AssetPack::build(dir, output, compile)) {
+        fprintf(stderr, "Failed to pack %s\n", dir.c_str());
+        return 1;
+    }
+
+    printf("Packed %s into %s in %.1f ms\n", dir.c_str(), output.c_str(), elapsedMs(start));
+    return 0;
+}
+
+static int
+renderThumbnails(int argc, char **argv)
+{
+    std::string dir = Thumbnails::cacheDir();
+    int jobs = 0;
+    std::vector<std::string> files;
+    for (int i=2; i<argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i < argc-1) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i < argc-1) {
+            jobs = atoi(argv[++i]);
+        } else {
+            findLevels(argv[i], files);
+        }
+    }
+
+    // Set up front, the workers would race for them
+    OS->globalDataDir();
+    if (!OS->ensurePath(dir)) {
+        fprintf(stderr, "Cannot create %s\n", dir.c_str());
+        return 1;
+    }
+
+    // Same size as in the level selector
+    Vec2 size(WORLD_WIDTH / ICON_SCALE_FACTOR, WORLD_HEIGHT / ICON_SCALE_FACTOR);
+    Rect world(Vec2(0, 0), Vec2(WORLD_WIDTH, WORLD_HEIGHT));
+
+    int rendered = 0, cached = 0, failed = 0;
+    auto start = std::chrono::steady_clock::now();
+
+#if !defined(__EMSCRIPTEN__)
+    if (jobs < 1) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::mutex mutex;
+    std::atomic<size_t> next(0);
+#else
+    jobs = 1;
+    size_t next = 0;
+#endif
+
+    // Each worker draws with a renderer of its own and takes the next
+    // level when it is done with one
+    auto worker = [&] () {
+        SoftwareRenderer renderer(world.size(), size);
+        ScopedRenderer scoped(&renderer);
+        RenderTarget target(size, world);
+
+        for (size_t i=next++; i<files.size(); i=next++) {
+            bool hit = false;
+            bool ok = Thumbnails::render(files[i], dir, size, target, hit);
+
+#if !defined(__EMSCRIPTEN__)
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            if (!ok) {
+                fprintf(stderr, "Failed to render %s\n", files[i].c_str());
+                failed++;
+            } else if (hit) {
+                cached++;
+            } else {
+                rendered++;
+            }
+        }
+    };
+
+#if !defined(__EMSCRIPTEN__)
+    std::vector<std::thread> threads;
+    for (int i=0; i<jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+#else
+    worker();
+#endif
+
+    printf("Rendered %d, already cached %d of %d thumbnails into %s (%d threads, %.1f ms)\n",
+           rendered, cached, int(files.size()), dir.c_str(), jobs, elapsedMs(start));
+    return failed ? 1 : 0;
+}
+
+// FNV-1a
+static uint64_t
+checksum(const std::vector<unsigned char> &pixels)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: pixels) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static int
+checkRender(int argc, char **argv)
+{
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s --check-render LEVEL [CHECKSUM]\n", argv[0]);
+        return 1;
+    }
+
+    std::string file = argv[2];
+
+    // Same size as in the level selector
+    Vec2 size(WORLD_WIDTH / ICON_SCALE_FACTOR, WORLD_HEIGHT / ICON_SCALE_FACTOR);
+    Rect world(Vec2(0, 0), Vec2(WORLD_WIDTH, WORLD_HEIGHT));
+
+    SoftwareRenderer renderer(world.size(), size);
+    ScopedRenderer scoped(&renderer);
+    RenderTarget target(size, world);
+
+    std::vector<unsigned char> pixels;
+    if (!Thumbnails::draw(file, size, target, pixels)) {
+        fprintf(stderr, "Failed to render %s\n", file.c_str());
+        return 1;
+    }
+
+    std::string result = thp::format("%016llx", (unsigned long long)checksum(pixels));
+    printf("%s  %s\n", result.c_str(), file.c_str());
+    if (argc == 4 && result != argv[3]) {
+        fprintf(stderr, "Rendering of %s changed, expected %s\n", file.c_str(), argv[3]);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+replayFrames(int argc, char **argv)
+{
+    std::string file;
+    int rounds = 1;
+    for (int i=2; i<argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i < argc-1) {
+            rounds = std::max(1, atoi(argv[++i]));
+        } else {
+            file = argv[i];
+        }
+    }
+
+    if (file.empty()) {
+        fprintf(stderr, "Usage: %s --replay-frames [-n ROUNDS] FILE\n", argv[0]);
+        return 1;
+    }
+
+    std::string commands;
+    Vec2 world_size, framebuffer_size;
+    if (!RenderReplay::load(file, commands, world_size, framebuffer_size)) {
+        return 1;
+    }
+
+    // Images and fonts are looked up relative to it
+    OS->globalDataDir();
+
+    RecordingRenderer::Histogram total;
+    std::vector<double> times;
+    for (int round=0; round<rounds; round++) {
+        // A fresh renderer each round, so that every round loads the
+        // images and fonts again like the recorded session did
+        SoftwareRenderer renderer(world_size, framebuffer_size);
+        RenderReplay replay(commands, &renderer);
+
+        int frame = 0;
+        RecordingRenderer::Histogram histogram;
+        auto start = std::chrono::steady_clock::now();
+        while (replay.frame(histogram)) {
+            double ms = elapsedMs(start);
+            if (round == 0) {
+                times.push_back(ms);
+                printf("frame %4d %8.3f ms  %s\n", frame, ms, histogram.str().c_str());
+                for (int i=0; i<RecordingRenderer::COMMANDS; i++) {
+                    total.counts[i] += histogram.counts[i];
+                }
+            } else if (size_t(frame) < times.size()) {
+                times[frame] = std::min(times[frame], ms);
+            }
+
+            frame++;
+            histogram = RecordingRenderer::Histogram();
+            start = std::chrono::steady_clock::now();
+        }
+
+        if (replay.failed()) {
+            fprintf(stderr, "Failed to replay %s\n", file.c_str());
+            return 1;
+        }
+    }
+
+    if (times.empty()) {
+        printf("No frames in %s\n", file.c_str());
+        return 0;
+    }
+
+    // The first frame loads everything, leave it out of the average
+    double sum = 0.0;
+    for (size_t i=1; i<times.size(); i++) {
+        sum += times[i];
+    }
+    double average = (times.size() > 1) ? sum / (times.size() - 1) : times[0];
+
+    printf("%d frames at %dx%d, %d commands: %.3f ms/frame (best of %d), first frame %.3f ms\n",
+           int(times.size()), framebuffer_size.x, framebuffer_size.y, total.total(),
+           average, rounds, times[0]);
+    printf("%s\n", total.str().c_str());
+    return 0;
+}
+
+bool
+Batch::run(int argc, char **argv, int &result)
+{
+    if (argc < 2) {
+        return false;
+    }
+
+    if (strcmp(argv[1], "--convert-npb") == 0) {
+        result = convert(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--benchmark-load") == 0) {
+        result = benchmark(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--benchmark-parse") == 0) {
+        result = benchmarkParse(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--build-pack") == 0) {
+        result = buildPack(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--render-thumbnails") == 0) {
+        result = renderThumbnails(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--check-render") == 0) {
+        result = checkRender(argc, argv);
+        return true;
+    } else if (strcmp(argv[1], "--replay-frames") == 0) {
+        result = replayFrames(argc, argv);
+        return true;
+    }
+
+    return false;
+}
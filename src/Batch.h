@@ -0,0 +1,42 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_BATCH_H
+#define NUMPTYPHYSICS_BATCH_H
+
+/**
+ * Command line tools that run without opening a window:
+ *
+ *   --convert-npb [-o DIR] PATH...   compile levels/collections to .npb
+ *   --benchmark-load PATH...         compare text and compiled load times
+ *   --benchmark-parse PATH...        path data parsing throughput in MB/s
+ *   --build-pack [-c] [-o FILE] DIR  pack DIR into one file, -c compiles levels
+ *   --render-thumbnails [-j N] [-o DIR] PATH...
+ *                                    fill the thumbnail cache (or DIR) with a
+ *                                    software renderer on N threads
+ *   --check-render LEVEL [CHECKSUM]  checksum of the software rendered
+ *                                    thumbnail of LEVEL, fails if it is not
+ *                                    CHECKSUM ("make check")
+ *   --replay-frames [-n ROUNDS] FILE replay frames recorded with the game's
+ *                                    --record-frames FILE on the software
+ *                                    renderer, with times and command counts
+ **/
+class Batch {
+public:
+    // Returns true if argv[1] is a batch command; its exit status goes to result
+    static bool run(int argc, char **argv, int &result);
+};
+
+#endif /* NUMPTYPHYSICS_BATCH_H */
@@ -0,0 +1,370 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "BinaryLevel.h"
+#include "Scene.h"
+#include "Stroke.h"
+#include "JetStream.h"
+#include "FileWriter.h"
+
+#include "petals_log.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+const char *BinaryLevel::EXTENSION = ".npb";
+
+namespace {
+
+// "NPB1" in little-endian byte order
+const uint32_t NPB_MAGIC = 0x3142504e;
+const uint32_t NPB_VERSION = 2;
+
+enum {
+    NPB_GRAVITY = 1 << 0,
+    NPB_DYNAMIC_GRAVITY = 1 << 1,
+};
+
+struct NpbString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct NpbHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t flags;
+    float gravity[2];
+    NpbString title;
+    NpbString author;
+    NpbString background;
+    uint32_t strokes, strokeCount;
+    uint32_t jetStreams, jetStreamCount;
+    uint32_t interactions, interactionCount;
+    uint32_t events, eventBytes; // ScriptLog::encode()
+    uint32_t eventCount;
+};
+
+struct NpbPoint {
+    int32_t x, y;
+};
+
+struct NpbStroke {
+    int32_t attributes;
+    int32_t colour;
+    NpbPoint origin;
+    uint32_t points; // rawCount raw points, followed by shapeCount shape points
+    uint32_t rawCount;
+    uint32_t shapeCount;
+};
+
+struct NpbJetStream {
+    int32_t x1, y1, x2, y2;
+    float force[2];
+};
+
+struct NpbInteraction {
+    int32_t colour;
+    NpbString action;
+};
+
+class Writer {
+public:
+    Writer()
+        : points()
+        , strings()
+    {
+    }
+
+    uint32_t addPoints(const Path &path)
+    {
+        uint32_t offset = points.size() * sizeof(NpbPoint);
+        for (auto &p: path) {
+            points.push_back(NpbPoint{p.x, p.y});
+        }
+        return offset;
+    }
+
+    NpbString addString(const std::string &s)
+    {
+        NpbString result = { uint32_t(strings.size()), uint32_t(s.size()) };
+        strings.append(s);
+        return result;
+    }
+
+    std::vector<NpbPoint> points;
+    std::string strings;
+};
+
+template <typename T>
+void
+append(std::string &out, const std::vector<T> &records)
+{
+    out.append(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T));
+}
+
+bool
+inRange(size_t size, uint32_t offset, uint32_t count, size_t recordSize)
+{
+    return offset <= size && count <= (size - offset) / recordSize;
+}
+
+bool
+validArray(size_t size, uint32_t offset, uint32_t count, size_t recordSize)
+{
+    return inRange(size, offset, count, recordSize) && offset % 4 == 0;
+}
+
+bool
+readString(const char *data, size_t size, const NpbString &s, std::string &result)
+{
+    if (!inRange(size, s.offset, s.length, 1)) {
+        return false;
+    }
+
+    result.assign(data + s.offset, s.length);
+    return true;
+}
+
+}; /* namespace */
+
+
+bool
+BinaryLevel::isBinary(const std::string &filename)
+{
+    size_t len = strlen(EXTENSION);
+    return filename.size() > len && filename.compare(filename.size() - len, len, EXTENSION) == 0;
+}
+
+std::string
+BinaryLevel::serialize(Scene &scene)
+{
+    Writer writer;
+
+    NpbHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = NPB_MAGIC;
+    header.version = NPB_VERSION;
+    header.title = writer.addString(scene.m_title);
+    header.author = writer.addString(scene.m_author);
+    header.background = writer.addString(scene.m_bg);
+
+    if (scene.m_customGravity) {
+        header.flags |= NPB_GRAVITY;
+        header.gravity[0] = scene.m_gravity.x;
+        header.gravity[1] = scene.m_gravity.y;
+    }
+    if (scene.m_dynamicGravity) {
+        header.flags |= NPB_DYNAMIC_GRAVITY;
+    }
+
+    std::vector<NpbStroke> strokes;
+    for (auto &stroke: scene.m_strokes) {
+        // Do the simplification once here instead of on every activation
+        stroke->process();
+
+        NpbStroke record;
+        record.attributes = stroke->m_attributes;
+        record.colour = stroke->m_colour;
+        record.origin = NpbPoint{stroke->m_origin.x, stroke->m_origin.y};
+        record.points = writer.addPoints(stroke->m_rawPath);
+        writer.addPoints(stroke->m_shapePath);
+        record.rawCount = stroke->m_rawPath.size();
+        record.shapeCount = stroke->m_shapePath.size();
+        strokes.push_back(record);
+    }
+
+    std::vector<NpbJetStream> jetStreams;
+    for (auto &stream: scene.m_jetStreams) {
+        const Rect &r = stream->rect;
+        jetStreams.push_back(NpbJetStream{r.tl.x, r.tl.y, r.br.x, r.br.y,
+                                          {stream->force.x, stream->force.y}});
+    }
+
+    std::vector<NpbInteraction> interactions;
+    for (auto &interaction: scene.m_interactions.m_interactions) {
+        interactions.push_back(NpbInteraction{interaction.first, writer.addString(interaction.second)});
+    }
+
+    std::string events;
+    scene.m_log.encode(events);
+    uint32_t eventBytes = events.size();
+    // Keep the point pool aligned
+    events.resize((events.size() + 3) & ~3, '\0');
+
+    // Records first, then the point pool, then the (unaligned) strings
+    uint32_t offset = sizeof(NpbHeader);
+    header.strokes = offset;
+    header.strokeCount = strokes.size();
+    offset += strokes.size() * sizeof(NpbStroke);
+    header.jetStreams = offset;
+    header.jetStreamCount = jetStreams.size();
+    offset += jetStreams.size() * sizeof(NpbJetStream);
+    header.interactions = offset;
+    header.interactionCount = interactions.size();
+    offset += interactions.size() * sizeof(NpbInteraction);
+    header.events = offset;
+    header.eventBytes = eventBytes;
+    header.eventCount = scene.m_log.size();
+    offset += events.size();
+
+    uint32_t pointBase = offset;
+    offset += writer.points.size() * sizeof(NpbPoint);
+    uint32_t stringBase = offset;
+    offset += writer.strings.size();
+    header.size = offset;
+
+    for (auto &stroke: strokes) {
+        stroke.points += pointBase;
+    }
+    for (auto &interaction: interactions) {
+        interaction.action.offset += stringBase;
+    }
+    header.title.offset += stringBase;
+    header.author.offset += stringBase;
+    header.background.offset += stringBase;
+
+    std::string result;
+    result.reserve(header.size);
+    result.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    append(result, strokes);
+    append(result, jetStreams);
+    append(result, interactions);
+    result.append(events);
+    append(result, writer.points);
+    result.append(writer.strings);
+
+    return result;
+}
+
+bool
+BinaryLevel::write(Scene &scene, const std::string &filename)
+{
+    // Never truncated in place, the old file may still be mapped
+    return FileWriter::write(filename, serialize(scene));
+}
+
+bool
+BinaryLevel::info(const char *data, size_t size, std::string &title, std::string &author, int &strokes)
+{
+    if (size < sizeof(NpbHeader)) {
+        return false;
+    }
+
+    const NpbHeader *header = reinterpret_cast<const NpbHeader *>(data);
+    if (header->magic != NPB_MAGIC || header->version != NPB_VERSION || header->size != size ||
+            !readString(data, size, header->title, title) ||
+            !readString(data, size, header->author, author)) {
+        return false;
+    }
+
+    strokes = header->strokeCount;
+    return true;
+}
+
+bool
+BinaryLevel::read(Scene &scene, const char *data, size_t size)
+{
+    if (size < sizeof(NpbHeader)) {
+        LOG_WARNING("Compiled level too short");
+        return false;
+    }
+
+    const NpbHeader *header = reinterpret_cast<const NpbHeader *>(data);
+    if (header->magic != NPB_MAGIC || header->version != NPB_VERSION || header->size != size) {
+        LOG_WARNING("Not a compiled level of version %d", NPB_VERSION);
+        return false;
+    }
+
+    if (!validArray(size, header->strokes, header->strokeCount, sizeof(NpbStroke)) ||
+            !validArray(size, header->jetStreams, header->jetStreamCount, sizeof(NpbJetStream)) ||
+            !validArray(size, header->interactions, header->interactionCount, sizeof(NpbInteraction)) ||
+            !inRange(size, header->events, header->eventBytes, 1) ||
+            !readString(data, size, header->title, scene.m_title) ||
+            !readString(data, size, header->author, scene.m_author) ||
+            !readString(data, size, header->background, scene.m_bg)) {
+        LOG_WARNING("Corrupt compiled level header");
+        return false;
+    }
+
+    if (header->flags & NPB_GRAVITY) {
+        scene.setGravity(b2Vec2(header->gravity[0], header->gravity[1]));
+        scene.m_customGravity = true;
+    }
+    scene.m_dynamicGravity = (header->flags & NPB_DYNAMIC_GRAVITY) != 0;
+
+    const NpbStroke *strokes = reinterpret_cast<const NpbStroke *>(data + header->strokes);
+    scene.m_strokes.reserve(header->strokeCount);
+    for (uint32_t i=0; i<header->strokeCount; i++) {
+        const NpbStroke &s = strokes[i];
+        // In 64 bits, so that the sum of the two counts can't wrap around
+        if (s.rawCount < 1 || uint64_t(s.rawCount) + s.shapeCount > UINT32_MAX ||
+                !validArray(size, s.points, s.rawCount + s.shapeCount, sizeof(NpbPoint))) {
+            LOG_WARNING("Corrupt compiled stroke");
+            return false;
+        }
+
+        const NpbPoint *points = reinterpret_cast<const NpbPoint *>(data + s.points);
+        Path raw, shape;
+        raw.reserve(s.rawCount);
+        for (uint32_t j=0; j<s.rawCount; j++) {
+            raw.push_back(Vec2(points[j].x, points[j].y));
+        }
+        points += s.rawCount;
+        shape.reserve(s.shapeCount);
+        for (uint32_t j=0; j<s.shapeCount; j++) {
+            shape.push_back(Vec2(points[j].x, points[j].y));
+        }
+
+        scene.m_strokes.push_back(new (scene.m_arena) Stroke(s.attributes, s.colour,
+                    Vec2(s.origin.x, s.origin.y), std::move(raw), std::move(shape)));
+    }
+
+    const NpbJetStream *jetStreams = reinterpret_cast<const NpbJetStream *>(data + header->jetStreams);
+    for (uint32_t i=0; i<header->jetStreamCount; i++) {
+        const NpbJetStream &j = jetStreams[i];
+        auto js = new JetStream(Rect(j.x1, j.y1, j.x2, j.y2), b2Vec2(j.force[0], j.force[1]));
+        scene.m_jetStreams.push_back(js);
+        js->activate();
+    }
+
+    const NpbInteraction *interactions = reinterpret_cast<const NpbInteraction *>(data + header->interactions);
+    for (uint32_t i=0; i<header->interactionCount; i++) {
+        std::string action;
+        if (!readString(data, size, interactions[i].action, action)) {
+            LOG_WARNING("Corrupt compiled interaction");
+            return false;
+        }
+        scene.m_interactions.m_interactions[interactions[i].colour] = action;
+    }
+
+    // Each encoded event takes at least two bytes
+    if (header->eventCount > header->eventBytes / 2) {
+        LOG_WARNING("Corrupt events in compiled level");
+        return false;
+    }
+
+    scene.m_log.reserve(header->eventCount);
+    if (!scene.m_log.decode(data + header->events, header->eventBytes) ||
+            scene.m_log.size() != header->eventCount) {
+        LOG_WARNING("Corrupt events in compiled level");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_BINARYLEVEL_H
+#define NUMPTYPHYSICS_BINARYLEVEL_H
+
+#include <string>
+#include <cstddef>
+
+class Scene;
+
+
+/**
+ * Compiled level format (.npb)
+ *
+ * A fixed header followed by flat arrays of 4-byte aligned records
+ * (strokes with their already simplified raw and shape paths, jet
+ * streams, interactions and the event log) and a string table. Loading
+ * only validates offsets and copies records out of the (mmap'ed) file,
+ * there is no text to tokenize.
+ *
+ * Integers and floats are stored in host byte order, which is
+ * little-endian on every platform we build for. Nothing is swapped: a
+ * file from a host with the other byte order fails the magic check. The version must be bumped whenever a record
+ * layout, an Attribute value or SceneEventDef.h changes.
+ **/
+class BinaryLevel {
+public:
+    static const char *EXTENSION;
+
+    static bool isBinary(const std::string &filename);
+
+    static std::string serialize(Scene &scene);
+    static bool write(Scene &scene, const std::string &filename);
+    static bool read(Scene &scene, const char *data, size_t size);
+    // Header fields only, for the level catalog
+    static bool info(const char *data, size_t size, std::string &title,
+                     std::string &author, int &strokes);
+};
+
+#endif /* NUMPTYPHYSICS_BINARYLEVEL_H */
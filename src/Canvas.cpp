@@ -15,14 +15,39 @@
  */
 
 #include <string>
+#include <vector>
 #include "Common.h"
 #include "Config.h"
 #include "Canvas.h"
 #include "Path.h"
 #include "Renderer.h"
 
+#include "petals_log.h"
 
-static NP::Renderer *RENDERER() { return OS->renderer(); }
+
+// Set by ScopedRenderer
+static thread_local NP::Renderer *thread_renderer = nullptr;
+static thread_local bool thread_renderer_pooled = false;
+
+static NP::Renderer *RENDERER() { return thread_renderer ? thread_renderer : OS->renderer(); }
+
+// Presented frames an unused framebuffer is kept around for
+static const int FRAMEBUFFER_IDLE_FRAMES = 120;
+
+// Last Window::offscreenVersion() handed out
+static unsigned offscreen_versions = 0;
+
+namespace {
+
+struct PooledFramebuffer {
+    NP::Framebuffer framebuffer;
+    int idle;
+};
+
+std::vector<PooledFramebuffer> framebuffer_pool;
+FramebufferPool::Stats framebuffer_stats;
+
+}; /* namespace */
 
 
 Canvas::Canvas( int w, int h )
@@ -65,7 +90,18 @@ void Canvas::clear()
 void Canvas::drawImage(Image &image, int x, int y)
 {
     EVAL_LOCAL(RENDERER);
-    RENDERER->image(image.texture(), x, y, image.width(), image.height());
+    if (image.source().isEmpty()) {
+        RENDERER->image(image.texture(), x, y, image.width(), image.height());
+    } else {
+        RENDERER->subimage(image.texture(), image.source(),
+                           Rect(x, y, x + image.width(), y + image.height()));
+    }
+}
+
+void Canvas::drawText(const NP::Font &font, const std::string &text, int x, int y, int color)
+{
+    EVAL_LOCAL(RENDERER);
+    RENDERER->text(font, text.c_str(), x, y, color);
 }
 
 void Canvas::drawAtlas(Image &image, const Rect &src, const Rect &dst)
@@ -98,6 +134,18 @@ void Canvas::drawPath( const Path& path, int color, int a )
     RENDERER->path(path, color | ((a & 0xff) << 24));
 }
 
+NP::Mesh Canvas::tessellate( const Path& path )
+{
+    EVAL_LOCAL(RENDERER);
+    return RENDERER->tessellate(path);
+}
+
+void Canvas::drawMesh( const NP::Mesh& mesh, float x, float y, float angle, int color, int a )
+{
+    EVAL_LOCAL(RENDERER);
+    RENDERER->mesh(mesh, x, y, angle, color | ((a & 0xff) << 24));
+}
+
 void Canvas::drawRect( int x, int y, int w, int h, int c, bool fill, int a )
 {
     drawRect(Rect(x, y, x+w, y+h), c, fill, a);
@@ -121,6 +169,7 @@ Window::Window(int w, int h, const char *title)
     : Canvas(w, h)
     , m_offscreen_target(nullptr)
     , m_offscreen_image(nullptr)
+    , m_offscreen_version(0)
     , m_title(title)
 {
     OS->window(Vec2(w, h));
@@ -135,6 +184,7 @@ Window::~Window()
 {
     delete m_offscreen_image;
     delete m_offscreen_target;
+    FramebufferPool::trim();
 }
 
 void Window::update()
@@ -142,6 +192,7 @@ void Window::update()
     EVAL_LOCAL(RENDERER);
     RENDERER->flush();
     RENDERER->swap();
+    FramebufferPool::frame();
 }
 
 void
@@ -154,6 +205,7 @@ void
 Window::endOffscreen()
 {
     m_offscreen_target->end();
+    m_offscreen_version = ++offscreen_versions;
 }
 
 Image *
@@ -162,9 +214,101 @@ Window::offscreen()
     return m_offscreen_image;
 }
 
+ScopedRenderer::ScopedRenderer(NP::Renderer *renderer, bool pooled)
+    : m_previous(thread_renderer)
+    , m_previous_pooled(thread_renderer_pooled)
+{
+    thread_renderer = renderer;
+    thread_renderer_pooled = pooled;
+}
+
+ScopedRenderer::~ScopedRenderer()
+{
+    thread_renderer = m_previous;
+    thread_renderer_pooled = m_previous_pooled;
+}
+
+NP::Renderer *
+ScopedRenderer::current()
+{
+    return RENDERER();
+}
+
+NP::Framebuffer
+FramebufferPool::lease(Vec2 size)
+{
+    if (thread_renderer && !thread_renderer_pooled) {
+        // The pool holds framebuffers of the window renderer only
+        return thread_renderer->framebuffer(size);
+    }
+
+    framebuffer_stats.leases++;
+
+    for (auto &entry: framebuffer_pool) {
+        // Only referenced by the pool: nobody is using it
+        if (entry.framebuffer.use_count() == 1 &&
+                entry.framebuffer->w == size.x && entry.framebuffer->h == size.y) {
+            entry.idle = 0;
+            return entry.framebuffer;
+        }
+    }
+
+    NP::Framebuffer result = RENDERER()->framebuffer(size);
+    framebuffer_pool.push_back(PooledFramebuffer{result, 0});
+    framebuffer_stats.allocations++;
+    framebuffer_stats.pooled = framebuffer_pool.size();
+    return result;
+}
+
+void
+FramebufferPool::frame()
+{
+    if (framebuffer_stats.allocations) {
+        LOG_DEBUG("Allocated %d of %d framebuffer leases this frame, %d pooled",
+                  framebuffer_stats.allocations, framebuffer_stats.leases,
+                  framebuffer_stats.pooled);
+    }
+
+    for (auto it = framebuffer_pool.begin(); it != framebuffer_pool.end(); ) {
+        if (it->framebuffer.use_count() > 1) {
+            it->idle = 0;
+            ++it;
+        } else if (++it->idle > FRAMEBUFFER_IDLE_FRAMES) {
+            it = framebuffer_pool.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    framebuffer_stats = Stats();
+    framebuffer_stats.pooled = framebuffer_pool.size();
+}
+
+void
+FramebufferPool::trim()
+{
+    for (auto it = framebuffer_pool.begin(); it != framebuffer_pool.end(); ) {
+        if (it->framebuffer.use_count() == 1) {
+            it = framebuffer_pool.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    framebuffer_stats.pooled = framebuffer_pool.size();
+}
+
+const FramebufferPool::Stats &
+FramebufferPool::stats()
+{
+    return framebuffer_stats;
+}
+
+
 RenderTarget::RenderTarget(Vec2 fb_size, Rect world_rect)
     : Canvas(world_rect.w(), world_rect.h())
-    , m_framebuffer(RENDERER()->framebuffer(fb_size))
+    , m_size(fb_size)
+    , m_framebuffer(FramebufferPool::lease(fb_size))
     , m_world_rect(world_rect)
     , m_save_clip(world_rect)
 {
@@ -183,6 +327,21 @@ RenderTarget::begin()
     clear();
 }
 
+void
+RenderTarget::begin(const Rect &area)
+{
+    // Stretch the world rect so that m_world_rect lands on area
+    Vec2 world = m_world_rect.br - m_world_rect.tl;
+    Vec2 tl = m_world_rect.tl - Vec2(area.tl.x * world.x / area.w(), area.tl.y * world.y / area.h());
+    Vec2 br = tl + Vec2(m_size.x * world.x / area.w(), m_size.y * world.y / area.h());
+
+    EVAL_LOCAL(RENDERER);
+    RENDERER->begin(m_framebuffer, Rect(tl, br));
+    m_save_clip = RENDERER->clip(m_world_rect);
+    // clear() would wipe the whole target
+    drawRect(m_world_rect, 0x000000);
+}
+
 void
 RenderTarget::end()
 {
@@ -199,23 +358,41 @@ RenderTarget::contents()
     return RENDERER->retrieve(m_framebuffer);
 }
 
+void
+RenderTarget::read(const Rect &area, unsigned char *pixels)
+{
+    EVAL_LOCAL(RENDERER);
+    RENDERER->read(m_framebuffer, area, pixels);
+}
+
 
 Image::Image(NP::Texture texture)
     : m_texture(texture)
+    , m_source(false)
     , m_width(m_texture->w)
     , m_height(m_texture->h)
 {
 }
 
+Image::Image(NP::Texture texture, const Rect &source)
+    : m_texture(texture)
+    , m_source(source)
+    , m_width(source.w())
+    , m_height(source.h())
+{
+}
+
 Image::Image(std::string filename, bool cache)
     : m_texture(RENDERER()->load(filename.c_str(), cache))
+    , m_source(false)
     , m_width(m_texture->w)
     , m_height(m_texture->h)
 {
 }
 
-Image::Image(NP::Font font, const char *text, int rgb)
-    : m_texture(RENDERER()->text(font, text, rgb))
+Image::Image(unsigned char *pixels, int w, int h)
+    : m_texture(RENDERER()->load(pixels, w, h))
+    , m_source(false)
     , m_width(m_texture->w)
     , m_height(m_texture->h)
 {
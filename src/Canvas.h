@@ -36,11 +36,14 @@ public:
   int  makeColour( int r, int g, int b ) const;
   void clear();
   void drawImage(Image &image, int x=0, int y=0);
+  void drawText(const NP::Font &font, const std::string &text, int x, int y, int color);
   void drawAtlas(Image &image, const Rect &src, const Rect &dst);
   void drawBlur(Image &image, const Rect &src, const Rect &dst, float rx, float ry);
   void drawRewind(Image &image, const Rect &src, const Rect &dst, float time, float alpha);
   void drawSaturation(Image &image, const Rect &src, const Rect &dst, float alpha);
   void drawPath( const Path& path, int color, int a=255 );
+  NP::Mesh tessellate( const Path& path );
+  void drawMesh( const NP::Mesh& mesh, float x, float y, float angle, int color, int a=255 );
   void drawRect( int x, int y, int w, int h, int c, bool fill=true, int a=255 );
   void drawRect( const Rect& r, int c, bool fill=true, int a=255 );
   Rect clip(const Rect &r);
@@ -49,6 +52,62 @@ protected:
   int m_height;
 };
 
+/**
+ * Draws everything on the current thread with renderer instead of the
+ * renderer of the window, for as long as it exists
+ *
+ * Meant for renderers that don't need the window, e.g. a SoftwareRenderer
+ * on a worker thread, or for decorators of the window renderer such as a
+ * RecordingRenderer; pooled says that framebuffers may come from (and go
+ * back to) the FramebufferPool, which is only right for the latter.
+ * Fonts load with it too, but Font::titleFont() and friends are shared
+ * and keep the renderer of whoever used them first.
+ **/
+class ScopedRenderer
+{
+public:
+    ScopedRenderer(NP::Renderer *renderer, bool pooled=false);
+    ~ScopedRenderer();
+
+    // The renderer everything on this thread draws with
+    static NP::Renderer *current();
+
+private:
+    NP::Renderer *m_previous;
+    bool m_previous_pooled;
+};
+
+/**
+ * Framebuffers for render targets, reused by size
+ *
+ * A framebuffer stays leased as long as anything holds a reference to
+ * it (its RenderTarget, or on GL an image of its contents) and goes back
+ * to the pool after that, so effect passes that create a target of the
+ * same size every frame don't create GL objects every frame. Framebuffers
+ * that nobody leased for a while are freed.
+ **/
+class FramebufferPool
+{
+public:
+    struct Stats {
+        Stats() : leases(0), allocations(0), pooled(0) {}
+
+        // In the current frame
+        int leases;
+        int allocations;
+        // Framebuffers held by the pool, leased or not
+        int pooled;
+    };
+
+    static NP::Framebuffer lease(Vec2 size);
+    // Called once per presented frame
+    static void frame();
+    // Free everything that is not leased
+    static void trim();
+
+    static const Stats &stats();
+};
+
 class RenderTarget : public Canvas
 {
 public:
@@ -56,11 +115,17 @@ public:
     ~RenderTarget();
 
     void begin();
+    // Draw the world rect into area (framebuffer coordinates) only,
+    // leaving the rest of the target as it is
+    void begin(const Rect &area);
     void end();
 
     NP::Texture contents();
+    // RGBA copy of area, for Image(pixels, w, h)
+    void read(const Rect &area, unsigned char *pixels);
 
 private:
+    Vec2 m_size;
     NP::Framebuffer m_framebuffer;
     Rect m_world_rect;
     Rect m_save_clip;
@@ -76,10 +141,15 @@ public:
     void beginOffscreen();
     void endOffscreen();
     Image *offscreen();
+    // false until something has been drawn into offscreen()
+    bool offscreenDrawn() const { return m_offscreen_version != 0; }
+    // Changes (across all windows) whenever offscreen() is drawn into
+    unsigned offscreenVersion() const { return m_offscreen_version; }
 
 private:
     RenderTarget *m_offscreen_target;
     Image *m_offscreen_image;
+    unsigned m_offscreen_version;
 
 protected:
     std::string m_title;
@@ -90,8 +160,10 @@ class Image
 {
 public:
     Image(NP::Texture texture);
+    // Part of a texture, e.g. a cell of an atlas
+    Image(NP::Texture texture, const Rect &source);
+    Image(unsigned char *pixels, int w, int h);
     Image(std::string filename, bool cache=false);
-    Image(NP::Font font, const char *text, int rgb);
     ~Image();
 
     int width() const { return m_width; }
@@ -100,9 +172,12 @@ public:
     void scale(float scale) { m_width *= scale; m_height *= scale; }
 
     NP::Texture texture() const { return m_texture; }
+    // Empty if the whole texture is used
+    const Rect &source() const { return m_source; }
 
 private:
     NP::Texture m_texture;
+    Rect m_source;
     int m_width;
     int m_height;
 };
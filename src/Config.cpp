@@ -15,9 +15,8 @@
  */
 
 #include "Config.h"
-
-#include <sstream>
-#include <fstream>
+#include "Assets.h"
+#include "AssetPack.h"
 
 
 const Rect BOUNDS_RECT( -WORLD_WIDTH/4, -WORLD_HEIGHT,
@@ -26,50 +25,17 @@ const Rect BOUNDS_RECT( -WORLD_WIDTH/4, -WORLD_HEIGHT,
 std::string Config::findFile(const std::string &name)
 {
     std::string global_name(OS->globalDataDir() + Os::pathSep + name);
-    if (OS->exists(global_name)) {
+    if (Assets::pack().isFile(global_name) || OS->exists(global_name)) {
         return global_name;
     }
 
     return name;
 }
 
-Blob *
-Config::readBlob(const std::string &name)
-{
-    std::string filename = findFile(name);
-    std::ifstream is(filename.c_str(), std::ios::in);
-
-    is.seekg(0, is.end);
-    size_t length = is.tellg();
-    is.seekg(0, is.beg);
-
-    char *buffer = new char [length];
-
-    is.read (buffer, length);
-    is.close();
-
-    return new Blob(buffer, length);
-}
-
 std::string
 Config::readFile(const std::string &name)
 {
-    std::string filename = findFile(name);
-    std::ifstream is(filename.c_str(), std::ios::in);
-
-    is.seekg(0, is.end);
-    size_t length = is.tellg();
-    is.seekg(0, is.beg);
-
-    char *buffer = new char [length+1];
-    buffer[length] = '\0';
-
-    is.read (buffer,length);
-    is.close();
-    std::string result = buffer;
-    delete[] buffer;
-
-    return result;
+    return Assets::open(name).str();
 }
 
 std::string
@@ -84,10 +50,22 @@ Config::userLevelFileName(const std::string &name)
     return OS->userDataDir() + Os::pathSep + name;
 }
 
+std::string
+Config::userRecordingDir()
+{
+    return OS->userDataDir() + Os::pathSep + "Recordings";
+}
+
 std::string
 Config::userRecordingCollectionDir(const std::string &name)
 {
-    return OS->userDataDir() + Os::pathSep + "Recordings" + Os::pathSep + name;
+    return userRecordingDir() + Os::pathSep + name;
+}
+
+std::string
+Config::userCacheFileName(const std::string &name)
+{
+    return OS->userDataDir() + Os::pathSep + ".cache" + Os::pathSep + name;
 }
 
 std::string
@@ -100,5 +78,5 @@ std::string
 Config::baseName(const std::string &name)
 {
     size_t sep = name.rfind(Os::pathSep);
-    return (sep == std::string::npos) ? name : name.substr(sep);
+    return (sep == std::string::npos) ? name : name.substr(sep + 1);
 }
@@ -64,31 +64,28 @@ constexpr const int REWIND_JUMP_LENGTH = 100;
 
 constexpr const float ROPE_SEGMENT_LENGTHf = 15.f;
 
-extern const Rect BOUNDS_RECT;
-
+constexpr const float STROKE_HALF_THICKNESSf = 0.1f /* metres */;
+constexpr const float CCD_THRESHOLDf = 0.5f /* stroke thicknesses per step */;
+constexpr const int MAX_TOI_EVENTS = 32 /* per step */;
 
-class Blob {
-public:
-    Blob(char *data, size_t len) : data(data), len(len) {}
-    ~Blob() { free(data); }
+extern const Rect BOUNDS_RECT;
 
-    char *data;
-    size_t len;
-};
 
 class Config {
 public:
     static std::string defaultLevelPath();
 
     static std::string userLevelFileName(const std::string &name);
+    static std::string userRecordingDir();
     static std::string userRecordingCollectionDir(const std::string &name);
+    static std::string userCacheFileName(const std::string &name);
 
     static std::string joinPath(const std::string &dir, const std::string &name);
     static std::string baseName(const std::string &name);
 
     static std::string findFile(const std::string &name);
+    // Copy of the file contents; use Assets::open() to avoid the copy
     static std::string readFile(const std::string &name);
-    static Blob *readBlob(const std::string &name);
 };
 
 #endif //CONFIG_H
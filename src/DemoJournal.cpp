@@ -0,0 +1,466 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "DemoJournal.h"
+#include "FileWriter.h"
+#include "MappedFile.h"
+#include "Config.h"
+#include "Scene.h"
+#include "Os.h"
+
+#include "petals_log.h"
+
+#include <sys/types.h>
+#include <dirent.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+// "NPJ1" when read back on a host with the same byte order
+const uint32_t JOURNAL_MAGIC = 0x314a504e;
+const uint32_t JOURNAL_VERSION = 1;
+const uint32_t CHUNK_SEALED = 0x4c414553;
+const size_t JOURNAL_INITIAL_SIZE = 64 * 1024;
+const char *JOURNAL_EXTENSION = ".journal";
+const char *RECOVERED_COLLECTION = "Recovered";
+
+// Followed by the level file name, padded to 4 bytes, and the chunks
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t level;
+    uint32_t reserved;
+};
+
+// Followed by size bytes of ScriptLog::encode() output, padded to 4 bytes.
+// The chunk being appended to has an up to date size and event count but
+// no checksum yet.
+struct JournalChunk {
+    uint32_t size;
+    uint32_t events;
+    uint32_t checksum;
+    uint32_t sealed;
+};
+
+size_t
+align4(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+uint32_t
+checksum(const char *data, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<size; i++) {
+        hash = (hash ^ uint8_t(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool
+hasExtension(const std::string &file, const char *ext)
+{
+    size_t len = strlen(ext);
+    return file.size() > len && file.compare(file.size() - len, len, ext) == 0;
+}
+
+void
+findJournals(const std::string &path, std::vector<std::string> &result)
+{
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        if (hasExtension(path, JOURNAL_EXTENSION)) {
+            result.push_back(path);
+        }
+        return;
+    }
+
+    std::vector<std::string> entries;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            entries.push_back(path + Os::pathSep + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    for (auto &entry: entries) {
+        findJournals(entry, result);
+    }
+}
+
+// Reads the level name and all events that made it into the journal; a
+// torn chunk at the end (if the machine went down) and everything after
+// it is left out
+bool
+readJournal(const std::string &filename, std::string &level, ScriptLog &log)
+{
+    MappedFile file(filename);
+    const char *data = file.data();
+    size_t size = file.size();
+
+    const JournalHeader *header = reinterpret_cast<const JournalHeader *>(data);
+    if (size < sizeof(JournalHeader) || header->magic != JOURNAL_MAGIC ||
+            header->version != JOURNAL_VERSION ||
+            header->level > size - sizeof(JournalHeader)) {
+        LOG_WARNING("%s is not a journal of version %d", filename.c_str(), JOURNAL_VERSION);
+        return false;
+    }
+
+    level.assign(data + sizeof(JournalHeader), header->level);
+
+    size_t offset = sizeof(JournalHeader) + align4(header->level);
+    while (offset + sizeof(JournalChunk) <= size) {
+        const JournalChunk *chunk = reinterpret_cast<const JournalChunk *>(data + offset);
+        const char *events = data + offset + sizeof(JournalChunk);
+        if (chunk->size == 0 || chunk->size > size - offset - sizeof(JournalChunk)) {
+            break;
+        }
+
+        bool sealed = (chunk->sealed == CHUNK_SEALED);
+        if (sealed && checksum(events, chunk->size) != chunk->checksum) {
+            LOG_WARNING("Torn chunk at offset %d of %s", int(offset), filename.c_str());
+            break;
+        }
+
+        size_t count = log.size();
+        if (!log.decode(events, chunk->size)) {
+            break;
+        }
+        if (log.size() - count != chunk->events) {
+            log.erase(log.begin() + count, log.end());
+            break;
+        }
+
+        if (!sealed) {
+            // Nothing gets appended after the open chunk
+            break;
+        }
+        offset += sizeof(JournalChunk) + align4(chunk->size);
+    }
+
+    return true;
+}
+
+void
+recoverJournal(const std::string &filename)
+{
+    std::string level;
+    ScriptLog log;
+    bool ok = readJournal(filename, level, log);
+
+    if (ok && !log.empty()) {
+        Scene scene(true);
+        if (scene.loadFile(level)) {
+            scene.getLog()->swap(log);
+
+            std::string name = Config::baseName(filename);
+            name.resize(name.size() - strlen(JOURNAL_EXTENSION));
+            std::string dir = Config::userRecordingCollectionDir(RECOVERED_COLLECTION);
+            std::string demo = Config::joinPath(dir, name);
+
+            TextBuffer out;
+            scene.serializeHeader(out, true);
+            scene.serializeEvents(out, 0);
+            Scene::serializeFooter(out);
+
+            OS->ensurePath(dir);
+            if (!FileWriter::write(demo, out.release())) {
+                LOG_WARNING("Cannot recover %s", filename.c_str());
+                return;
+            }
+
+            LOG_INFO("Recovered %d events of %s to %s", int(scene.getLog()->size()),
+                     level.c_str(), demo.c_str());
+        } else {
+            LOG_WARNING("Cannot recover %s, level %s is gone", filename.c_str(), level.c_str());
+        }
+    }
+
+    remove(filename.c_str());
+}
+
+}; /* namespace */
+
+
+DemoJournal::DemoJournal()
+    : m_level()
+    , m_dir()
+    , m_filename()
+    , m_journal()
+    , m_fd(-1)
+    , m_data(nullptr)
+    , m_capacity(0)
+    , m_size(0)
+    , m_chunk(0)
+    , m_synced(0)
+    , m_events(0)
+    , m_mapped(false)
+    , m_scratch()
+{
+}
+
+DemoJournal::~DemoJournal()
+{
+    cancel();
+}
+
+void
+DemoJournal::start(const std::string &level, const std::string &dir, const std::string &filename)
+{
+    cancel();
+
+    m_level = level;
+    m_dir = dir;
+    m_filename = filename;
+    m_journal = filename + JOURNAL_EXTENSION;
+}
+
+void
+DemoJournal::cancel()
+{
+    if (m_data) {
+        close();
+        FileWriter::queueRemove(m_journal);
+    }
+
+    m_filename.clear();
+    m_events = 0;
+}
+
+bool
+DemoJournal::open()
+{
+    // The journal of the last run of this level may still be queued for removal
+    FileWriter::flush();
+    OS->ensurePath(m_dir);
+
+#if !defined(_WIN32)
+    m_fd = ::open(m_journal.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd == -1) {
+        LOG_WARNING("Cannot create %s, recording without journal", m_journal.c_str());
+    }
+    m_mapped = (m_fd != -1);
+#endif
+
+    size_t header = sizeof(JournalHeader) + align4(m_level.size());
+    if (!reserve(header + sizeof(JournalChunk))) {
+        close();
+        return false;
+    }
+
+    JournalHeader *h = reinterpret_cast<JournalHeader *>(m_data);
+    h->magic = JOURNAL_MAGIC;
+    h->version = JOURNAL_VERSION;
+    h->level = m_level.size();
+    memcpy(m_data + sizeof(JournalHeader), m_level.data(), m_level.size());
+
+    m_chunk = header;
+    m_size = m_chunk + sizeof(JournalChunk);
+    m_synced = 0;
+    return true;
+}
+
+void
+DemoJournal::close()
+{
+#if !defined(_WIN32)
+    if (m_mapped) {
+        munmap(m_data, m_capacity);
+        ::close(m_fd);
+    } else
+#endif
+    {
+        free(m_data);
+    }
+
+    m_fd = -1;
+    m_data = nullptr;
+    m_capacity = m_size = m_chunk = m_synced = 0;
+    m_mapped = false;
+}
+
+bool
+DemoJournal::reserve(size_t size)
+{
+    if (size <= m_capacity) {
+        return true;
+    }
+
+    size_t capacity = std::max(m_capacity, JOURNAL_INITIAL_SIZE);
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+#if !defined(_WIN32)
+    if (m_mapped) {
+        void *addr = MAP_FAILED;
+        if (ftruncate(m_fd, capacity) == 0) {
+            addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        }
+
+        if (addr != MAP_FAILED) {
+            if (m_data) {
+                munmap(m_data, m_capacity);
+            }
+            m_data = static_cast<char *>(addr);
+            m_capacity = capacity;
+            return true;
+        }
+
+        // Carry on in memory, the file is written at sync points
+        LOG_WARNING("Cannot map %s, recording without journal", m_journal.c_str());
+        char *data = static_cast<char *>(calloc(1, capacity));
+        if (data && m_data) {
+            memcpy(data, m_data, m_size);
+            munmap(m_data, m_capacity);
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        m_mapped = false;
+        // The file has been grown with zeros, the next sync rewrites it
+        m_synced = 0;
+        m_data = data;
+        m_capacity = data ? capacity : 0;
+        return data != nullptr;
+    }
+#endif
+
+    char *data = static_cast<char *>(realloc(m_data, capacity));
+    if (!data) {
+        return false;
+    }
+    memset(data + m_capacity, 0, capacity - m_capacity);
+    m_data = data;
+    m_capacity = capacity;
+    return true;
+}
+
+void
+DemoJournal::onRecord(const ScriptLog &log)
+{
+    if (!active()) {
+        return;
+    }
+
+    if (log.size() < m_events) {
+        // The log was cut short, start over
+        close();
+        m_events = 0;
+    }
+
+    if (!m_data && !open()) {
+        return;
+    }
+
+    m_scratch.clear();
+    log.encode(m_scratch, m_events);
+
+    // Room for sealing this chunk and opening the next one, too
+    if (!reserve(align4(m_size + m_scratch.size()) + sizeof(JournalChunk))) {
+        return;
+    }
+
+    memcpy(m_data + m_size, m_scratch.data(), m_scratch.size());
+    m_size += m_scratch.size();
+
+    JournalChunk *chunk = reinterpret_cast<JournalChunk *>(m_data + m_chunk);
+    chunk->events += log.size() - m_events;
+    chunk->size = m_size - m_chunk - sizeof(JournalChunk);
+    m_events = log.size();
+}
+
+void
+DemoJournal::sync()
+{
+    if (!m_data) {
+        return;
+    }
+
+    JournalChunk *chunk = reinterpret_cast<JournalChunk *>(m_data + m_chunk);
+    if (chunk->size == 0) {
+        return;
+    }
+
+    chunk->checksum = checksum(m_data + m_chunk + sizeof(JournalChunk), chunk->size);
+    chunk->sealed = CHUNK_SEALED;
+
+    m_chunk = align4(m_size);
+    m_size = m_chunk + sizeof(JournalChunk);
+
+#if !defined(_WIN32)
+    if (m_mapped) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t begin = m_synced & ~(page - 1);
+        msync(m_data + begin, m_chunk - begin, MS_ASYNC);
+        m_synced = m_chunk;
+        return;
+    }
+#endif
+
+    // Only the chunk sealed just now is new, unless the file has to be
+    // started over (first sync, or the mapping was given up)
+    if (m_synced == 0) {
+        FileWriter::queueWrite(m_journal, std::string(m_data, m_chunk));
+    } else {
+        FileWriter::queueAppend(m_journal, std::string(m_data + m_synced, m_chunk - m_synced));
+    }
+    m_synced = m_chunk;
+}
+
+void
+DemoJournal::finish(Scene &scene)
+{
+    if (!active()) {
+        return;
+    }
+
+    LOG_INFO("Saving demo to %s", m_filename.c_str());
+    OS->ensurePath(m_dir);
+
+    TextBuffer out;
+    scene.serializeHeader(out, true);
+    scene.serializeEvents(out, 0);
+    Scene::serializeFooter(out);
+    FileWriter::queueWrite(m_filename, out.release());
+
+    // Queued after the demo, so there is always one of them on disk
+    cancel();
+}
+
+void
+DemoJournal::recover(const std::string &dir)
+{
+    std::vector<std::string> journals;
+    findJournals(dir, journals);
+
+    for (auto &journal: journals) {
+        recoverJournal(journal);
+    }
+}
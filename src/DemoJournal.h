@@ -0,0 +1,84 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_DEMOJOURNAL_H
+#define NUMPTYPHYSICS_DEMOJOURNAL_H
+
+#include "Script.h"
+
+#include <string>
+#include <cstddef>
+
+class Scene;
+
+
+/**
+ * Crash-safe recording of the level being played
+ *
+ * Every event is appended to <demo>.journal as soon as the recorder
+ * has it, in the compact ScriptLog encoding, behind a small header that
+ * names the level. The file is memory mapped (and grown by doubling),
+ * so appending is a memcpy and the data survives the game crashing.
+ * sync() seals the events written since the last call as a chunk with
+ * a checksum and schedules writeback, so after a power loss at most
+ * the events of one interval are lost.
+ *
+ * finish() writes the whole demo from the scene (it is text, the
+ * journal can't simply be renamed) and drops the journal. A journal that is
+ * still there on startup belongs to a session that never ended;
+ * recover() turns it into a demo in the "Recovered" recordings by
+ * decoding the events, nothing is simulated again.
+ **/
+class DemoJournal : public ScriptSink {
+public:
+    DemoJournal();
+    ~DemoJournal();
+
+    // Drops the unfinished recording, if any
+    void start(const std::string &level, const std::string &dir, const std::string &filename);
+    void cancel();
+
+    void onRecord(const ScriptLog &log);
+    void sync();
+    void finish(Scene &scene);
+
+    bool active() const { return !m_filename.empty(); }
+
+    static void recover(const std::string &dir);
+
+private:
+    DemoJournal(const DemoJournal &) = delete;
+    DemoJournal &operator=(const DemoJournal &) = delete;
+
+    bool open();
+    void close();
+    bool reserve(size_t size);
+
+    std::string m_level;
+    std::string m_dir;
+    std::string m_filename;
+    std::string m_journal;
+    int m_fd;
+    char *m_data;
+    size_t m_capacity;
+    size_t m_size;
+    size_t m_chunk; // offset of the chunk being appended to
+    size_t m_synced;
+    size_t m_events;
+    bool m_mapped;
+    std::string m_scratch;
+};
+
+#endif /* NUMPTYPHYSICS_DEMOJOURNAL_H */
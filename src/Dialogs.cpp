@@ -23,6 +23,7 @@
 #include "Scene.h"
 #include "Colour.h"
 #include "I18n.h"
+#include "Thumbnails.h"
 
 #include "petals_log.h"
 #include "thp_format.h"
@@ -88,19 +89,32 @@ public:
 
 class LevelSelector : public MenuPage
 {
-  static const int THUMB_COUNT = 32;
+  // Drawing a scene costs far more than uploading cached pixels
+  static const int THUMB_RENDERS_PER_TICK = 2;
+  static const int THUMB_UPLOADS_PER_TICK = 8;
+  struct Thumb {
+    IconButton *button;
+    std::string file;
+    int cell;
+    bool requested;
+  };
   Levels* m_levels;
   int m_collection;
   int m_dispbase;
   int m_dispcount;
-  IconButton* m_thumbs[THUMB_COUNT];
+  std::vector<Thumb> m_thumbs;
   ScrollArea* m_scroll;
+  Thumbnails m_thumbnails;
+  ThumbnailAtlas m_atlas;
 public:
   LevelSelector(GameControl* game, int initialLevel)
     : m_levels(game->m_levels),
       m_collection(0),
       m_dispbase(0),
-      m_dispcount(0)
+      m_dispcount(0),
+      m_thumbs(),
+      m_thumbnails(Vec2(WORLD_WIDTH / ICON_SCALE_FACTOR, WORLD_HEIGHT / ICON_SCALE_FACTOR)),
+      m_atlas(m_thumbnails.size())
   {
     m_scroll = new ScrollArea();
     m_scroll->fitToParent(true);
@@ -122,6 +136,9 @@ public:
     m_dispcount = m_levels->collectionSize(c);
     m_scroll->virtualSize(Vec2(WORLD_WIDTH,150+(WORLD_HEIGHT/ICON_SCALE_FACTOR+40)*((m_dispcount+2)/3)));
 
+    m_thumbnails.clear();
+    m_atlas.clear();
+    m_thumbs.clear();
     m_scroll->empty();
     Box *vbox = new VBox();
     vbox->add( new Spacer(),  10, 0 );
@@ -153,34 +170,98 @@ public:
 	hbox->add( new Spacer(),  0, 1 );
 	accumw = WORLD_WIDTH / ICON_SCALE_FACTOR;
       }
-      m_thumbs[i] = new IconButton(Tr::copy("--"),"",Event(Event::PLAY, //SELECT,
-						 m_levels->collectionLevel(c,i)));
-      m_thumbs[i]->font(Font::blurbFont());
-      m_thumbs[i]->setBg(NP::Colour::SELECTED_BG);
-      m_thumbs[i]->border(false);
-      hbox->add( m_thumbs[i],  WORLD_WIDTH / ICON_SCALE_FACTOR, 0 );
+      int level = m_levels->collectionLevel(c,i);
+      // Just the name until the thumbnail is ready
+      IconButton *thumb = new IconButton(Tr::copy(m_levels->levelName(level)),"",
+                                         Event(Event::PLAY, level));
+      thumb->font(Font::blurbFont());
+      thumb->setBg(NP::Colour::SELECTED_BG);
+      thumb->border(false);
+      m_thumbs.push_back(Thumb{thumb, m_levels->levelName(level, false), -1, false});
+      hbox->add( thumb,  WORLD_WIDTH / ICON_SCALE_FACTOR, 0 );
       hbox->add( new Spacer(), 0, 1 );
     }
     vbox->add(hbox, WORLD_HEIGHT/ICON_SCALE_FACTOR+30, 4);
     vbox->add( new Spacer(), 110, 10 );
     m_scroll->add(vbox,0,0);
+  }
+  void releaseThumb(Thumb &thumb)
+  {
+    thumb.button->image(nullptr);
+    m_atlas.release(thumb.cell);
+    thumb.cell = -1;
+  }
+  int allocateThumb(const Rect &view)
+  {
+    int cell = m_atlas.allocate();
+    if (cell == -1) {
+      // Atlas full, take the cell of the thumbnail farthest from the view
+      Thumb *farthest = nullptr;
+      int distance = -1;
+      for (auto &thumb: m_thumbs) {
+        int d = abs(thumb.button->position().centroid().y - view.centroid().y);
+        if (thumb.cell != -1 && d > distance) {
+          farthest = &thumb;
+          distance = d;
+        }
+      }
+      if (farthest) {
+        releaseThumb(*farthest);
+        cell = m_atlas.allocate();
+      }
+    }
+    return cell;
+  }
+  void onTick(int tick)
+  {
+    MenuPage::onTick(tick);
+
+    // Rows in view get their thumbnails, rows more than a page away give
+    // their atlas cells back
+    Rect view = m_scroll->position();
+    Rect keep(view.tl - Vec2(0, view.height()), view.br + Vec2(0, view.height()));
+    for (int i=0; i<m_thumbs.size(); i++) {
+      Thumb &thumb = m_thumbs[i];
+      const Rect &pos = thumb.button->position();
+      if (thumb.cell == -1 && !thumb.requested && pos.intersects(view)) {
+        m_thumbnails.request(i, thumb.file);
+        thumb.requested = true;
+      } else if (thumb.cell != -1 && !pos.intersects(keep)) {
+        releaseThumb(thumb);
+      }
+    }
 
-    for (int i=0; i<THUMB_COUNT && i+m_dispbase<m_dispcount; i++) {
-      Scene scene( true );
-      int level = m_levels->collectionLevel(c,i);
-      if (scene.load(m_levels->load(level))) {
-          auto size = Vec2(WORLD_WIDTH, WORLD_HEIGHT);
-          RenderTarget temp(size, Rect(Vec2(0, 0), size));
-
-          temp.begin();
-          scene.draw(temp, true);
-          temp.end();
-
-          m_thumbs[i]->text( Tr::copy(m_levels->levelName(level)) );
-          Image *image = new Image(temp.contents());
-          image->scale(1. / ICON_SCALE_FACTOR);
-          m_thumbs[i]->image(image);
+    int renders = 0, uploads = 0;
+    Thumbnails::Ready ready;
+    while (renders < THUMB_RENDERS_PER_TICK && uploads < THUMB_UPLOADS_PER_TICK &&
+           m_thumbnails.next(ready)) {
+      Thumb &thumb = m_thumbs[ready.id];
+      thumb.requested = false;
+      if (!thumb.button->position().intersects(keep)) {
+        // Scrolled away in the meantime
+        continue;
+      }
+
+      int cell = allocateThumb(view);
+      if (cell == -1) {
+        continue;
       }
+
+      if (ready.scene) {
+        m_atlas.draw(cell, *ready.scene);
+
+        Vec2 size = m_thumbnails.size();
+        std::vector<unsigned char> pixels(size.x * size.y * 4);
+        m_atlas.read(cell, pixels.data());
+        m_thumbnails.store(ready.key, std::move(pixels));
+        renders++;
+      } else {
+        m_atlas.draw(cell, ready.pixels.data());
+        uploads++;
+      }
+
+      thumb.cell = cell;
+      thumb.button->image(m_atlas.image(cell));
     }
   }
   bool onEvent(Event& ev)
@@ -192,16 +273,6 @@ public:
     case Event::NEXT:
       setCollection(m_collection+1);
       return true;
-//     case Event::SELECT:
-//       for (int i=0; i<THUMB_COUNT && i+m_dispbase<m_dispcount; i++) {
-// 	m_thumbs[i]->transparent(true);
-//       }
-//       m_thumbs[m_dispbase+ev.x]->transparent(false);
-//       m_game->gotoLevel(m_levels->collectionLevel(m_collection,m_dispbase+ev.x));
-//       add( new LevelLauncher(m_levels->collectionLevel(m_collection,m_dispbase+ev.x), m_thumbs[m_dispbase+ev.x]->image()) );
-//       //Event closeEvent(Event::CLOSE);
-//       //m_parent->dispatchEvent(closeEvent);
-//       return true;
        default:
       /* do nothing */
         break;
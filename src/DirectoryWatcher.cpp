@@ -0,0 +1,158 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "DirectoryWatcher.h"
+#include "Os.h"
+
+#include "petals_log.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+#if defined(__linux__)
+// Regular files are reported once they have been written, not when created
+static const uint32_t WATCH_EVENTS = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO |
+                                     IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR;
+#endif
+
+
+DirectoryWatcher::DirectoryWatcher(const std::string &root)
+    : m_fd(-1)
+    , m_dirs()
+{
+#if defined(__linux__)
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1) {
+        LOG_WARNING("Cannot watch %s: inotify not available", root.c_str());
+        return;
+    }
+
+    add(root, nullptr);
+    if (m_dirs.empty()) {
+        LOG_WARNING("Cannot watch %s", root.c_str());
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#if defined(__linux__)
+    if (m_fd != -1) {
+        close(m_fd);
+    }
+#endif
+}
+
+void
+DirectoryWatcher::add(const std::string &dir, const Callback *callback)
+{
+#if defined(__linux__)
+    int wd = inotify_add_watch(m_fd, dir.c_str(), WATCH_EVENTS);
+    if (wd == -1) {
+        LOG_WARNING("Cannot watch %s", dir.c_str());
+        return;
+    }
+    m_dirs[wd] = dir;
+
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+
+    while (struct dirent *entry = readdir(d)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        std::string path = dir + Os::pathSep + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            add(path, callback);
+        } else if (callback) {
+            (*callback)(dir, entry->d_name, true);
+        }
+    }
+    closedir(d);
+#endif
+}
+
+void
+DirectoryWatcher::poll(const Callback &callback)
+{
+#if defined(__linux__)
+    if (m_fd == -1) {
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t len = read(m_fd, buffer, sizeof(buffer));
+        if (len == -1 && errno == EINTR) {
+            continue;
+        } else if (len <= 0) {
+            if (len == -1 && errno != EAGAIN) {
+                LOG_WARNING("Cannot read directory changes");
+            }
+            break;
+        }
+
+        for (char *pos = buffer; pos < buffer + len; ) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG_WARNING("Directory change queue overflowed");
+                callback("", "", false);
+                continue;
+            }
+
+            auto it = m_dirs.find(event->wd);
+            if (it == m_dirs.end()) {
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                // Directory removed, the kernel dropped the watch
+                m_dirs.erase(it);
+                continue;
+            }
+
+            std::string dir = it->second;
+            std::string name = event->len ? event->name : "";
+            if (name.empty()) {
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    add(dir + Os::pathSep + name, &callback);
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                callback(dir, name, true);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                callback(dir, name, false);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_DIRECTORYWATCHER_H
+#define NUMPTYPHYSICS_DIRECTORYWATCHER_H
+
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+
+/**
+ * Reports files appearing in and disappearing from a directory tree
+ *
+ * Uses inotify where available. Events are queued by the kernel and only
+ * read (without blocking) in poll(), so nothing happens behind the
+ * caller's back. Subdirectories are watched as they are created; files
+ * that were written into a new subdirectory before its watch was added
+ * are reported when the directory itself is.
+ *
+ * If the kernel queue overflowed, the changes are lost and the callback
+ * is called with an empty name to ask for a full resync.
+ **/
+class DirectoryWatcher {
+public:
+    // directory, file name, whether the file now exists
+    typedef std::function<void(const std::string &, const std::string &, bool)> Callback;
+
+    DirectoryWatcher(const std::string &root);
+    ~DirectoryWatcher();
+
+    // false if changes can't be watched; callers have to check files themselves
+    bool valid() const { return m_fd != -1; }
+
+    void poll(const Callback &callback);
+
+private:
+    DirectoryWatcher(const DirectoryWatcher &) = delete;
+    DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+    void add(const std::string &dir, const Callback *callback);
+
+    int m_fd;
+    std::unordered_map<int, std::string> m_dirs;
+};
+
+#endif /* NUMPTYPHYSICS_DIRECTORYWATCHER_H */
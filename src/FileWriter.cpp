@@ -0,0 +1,283 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+
+#include "FileWriter.h"
+
+#include "petals_log.h"
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <deque>
+#include <algorithm>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+
+TextBuffer::TextBuffer(size_t capacity)
+    : m_data(capacity, '\0')
+    , m_size(0)
+{
+}
+
+void
+TextBuffer::reserve(size_t extra)
+{
+    if (m_size + extra > m_data.size()) {
+        m_data.resize(std::max(m_data.size() * 2, m_size + extra));
+    }
+}
+
+void
+TextBuffer::append(const char *s)
+{
+    append(s, strlen(s));
+}
+
+void
+TextBuffer::append(const char *s, size_t len)
+{
+    reserve(len);
+    memcpy(&m_data[m_size], s, len);
+    m_size += len;
+}
+
+void
+TextBuffer::printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    size_t avail = m_data.size() - m_size;
+    int len = vsnprintf(&m_data[m_size], avail, fmt, ap);
+    va_end(ap);
+
+    if (len < 0) {
+        LOG_WARNING("Cannot format \"%s\"", fmt);
+        return;
+    }
+
+    if (size_t(len) >= avail) {
+        // vsnprintf() needs room for the terminating NUL
+        reserve(len + 1);
+        va_start(ap, fmt);
+        vsnprintf(&m_data[m_size], len + 1, fmt, ap);
+        va_end(ap);
+    }
+
+    m_size += len;
+}
+
+std::string
+TextBuffer::release()
+{
+    m_data.resize(m_size);
+    m_size = 0;
+    return std::move(m_data);
+}
+
+
+namespace {
+
+struct Job {
+    enum Kind {
+        WRITE,
+        APPEND,
+        REMOVE,
+    };
+
+    Kind kind;
+    std::string filename;
+    // Contents for WRITE and APPEND
+    std::string data;
+};
+
+bool
+writeFile(const std::string &filename, const std::string &data, bool append)
+{
+    // Appends go straight to the file, everything else via a temporary
+    std::string target = append ? filename : filename + ".tmp";
+    FILE *fp = fopen(target.c_str(), append ? "ab" : "wb");
+    if (!fp) {
+        LOG_WARNING("Cannot open %s for writing", target.c_str());
+        return false;
+    }
+
+    bool ok = (fwrite(data.data(), 1, data.size(), fp) == data.size());
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+    if (!append) {
+#if defined(_WIN32)
+        remove(filename.c_str());
+#endif
+        if (!ok || rename(target.c_str(), filename.c_str()) != 0) {
+            remove(target.c_str());
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        LOG_WARNING("Cannot write %s", filename.c_str());
+    }
+    return ok;
+}
+
+void
+run(const Job &job)
+{
+    switch (job.kind) {
+        case Job::WRITE:
+            writeFile(job.filename, job.data, false);
+            break;
+        case Job::APPEND:
+            writeFile(job.filename, job.data, true);
+            break;
+        case Job::REMOVE:
+            remove(job.filename.c_str());
+            break;
+    }
+}
+
+#if !defined(__EMSCRIPTEN__)
+class WriterThread {
+public:
+    WriterThread()
+        : m_jobs()
+        , m_busy(false)
+        , m_quit(false)
+        , m_mutex()
+        , m_wakeup()
+        , m_done()
+        , m_thread(&WriterThread::loop, this)
+    {
+    }
+
+    ~WriterThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wakeup.notify_one();
+        m_thread.join();
+    }
+
+    void queue(Job &&job)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+        m_wakeup.notify_one();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] () { return m_jobs.empty() && !m_busy; });
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_wakeup.wait(lock, [this] () { return m_quit || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                // Only quit once everything is on disk
+                break;
+            }
+
+            Job job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_busy = true;
+
+            lock.unlock();
+            run(job);
+            lock.lock();
+
+            m_busy = false;
+            m_done.notify_all();
+        }
+    }
+
+    std::deque<Job> m_jobs;
+    bool m_busy;
+    bool m_quit;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_done;
+    std::thread m_thread;
+};
+
+WriterThread &
+writer()
+{
+    static WriterThread thread;
+    return thread;
+}
+
+void
+queue(Job &&job)
+{
+    writer().queue(std::move(job));
+}
+#else
+void
+queue(Job &&job)
+{
+    run(job);
+}
+#endif
+
+}; /* namespace */
+
+
+bool
+FileWriter::write(const std::string &filename, const std::string &data)
+{
+    flush();
+    return writeFile(filename, data, false);
+}
+
+void
+FileWriter::queueWrite(const std::string &filename, std::string &&data)
+{
+    queue(Job{Job::WRITE, filename, std::move(data)});
+}
+
+void
+FileWriter::queueAppend(const std::string &filename, std::string &&data)
+{
+    queue(Job{Job::APPEND, filename, std::move(data)});
+}
+
+void
+FileWriter::queueRemove(const std::string &filename)
+{
+    queue(Job{Job::REMOVE, filename, ""});
+}
+
+void
+FileWriter::flush()
+{
+#if !defined(__EMSCRIPTEN__)
+    writer().flush();
+#endif
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+
+#ifndef NUMPTYPHYSICS_FILEWRITER_H
+#define NUMPTYPHYSICS_FILEWRITER_H
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * Growable output buffer for level files
+ *
+ * Formats straight into one preallocated block instead of building a
+ * temporary string per line.
+ **/
+class TextBuffer {
+public:
+    TextBuffer(size_t capacity=64*1024);
+
+    void append(const char *s);
+    void append(const char *s, size_t len);
+    void printf(const char *fmt, ...);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    // Hands out the contents and leaves the buffer empty
+    std::string release();
+
+private:
+    void reserve(size_t extra);
+
+    std::string m_data;
+    size_t m_size;
+};
+
+/**
+ * Atomic file writes, optionally on a background thread
+ *
+ * Files are replaced by writing a temporary file next to them and
+ * renaming it, so readers never see a half written level. Queued
+ * operations run in order on a single thread (synchronously with
+ * emscripten); write() and flush() wait for everything queued before.
+ **/
+class FileWriter {
+public:
+    static bool write(const std::string &filename, const std::string &data);
+
+    static void queueWrite(const std::string &filename, std::string &&data);
+    static void queueAppend(const std::string &filename, std::string &&data);
+    static void queueRemove(const std::string &filename);
+
+    static void flush();
+};
+
+#endif /* NUMPTYPHYSICS_FILEWRITER_H */
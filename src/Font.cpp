@@ -23,7 +23,7 @@
 Font::Font( const std::string& file, int ptsize )
 {
     std::string fname = Config::findFile(file);
-    m_font = OS->renderer()->load(fname.c_str(), ptsize);
+    m_font = ScopedRenderer::current()->load(fname.c_str(), ptsize);
     m_height = metrics("M").y;
 }
 
@@ -31,15 +31,14 @@ Font::Font( const std::string& file, int ptsize )
 Vec2 Font::metrics( const std::string& text ) const
 {
     Vec2 m;
-    OS->renderer()->metrics(m_font, text.c_str(), &m.x, &m.y);
+    ScopedRenderer::current()->metrics(m_font, text.c_str(), &m.x, &m.y);
     return m;
 }
 
 void Font::drawLeft( Canvas* canvas, Vec2 pt,
 		     const std::string& text, int colour ) const
 {
-    Image temp(m_font, text.c_str(), colour);
-    canvas->drawImage(temp, pt.x, pt.y);
+    canvas->drawText(m_font, text, pt.x, pt.y, colour);
 }
 
 void Font::drawRight( Canvas* canvas, Vec2 pt,
@@ -29,6 +29,7 @@
 #include "Ui.h"
 #include "Colour.h"
 #include "I18n.h"
+#include "DemoJournal.h"
 
 #include "petals_log.h"
 
@@ -57,6 +58,9 @@ clickModeName(enum ClickMode cm)
 }
 
 
+// Ticks between sync points of the demo journal
+static const int DEMO_JOURNAL_INTERVAL = ITERATION_RATE;
+
 static float BUTTON_BORDER() { return WORLD_WIDTH * 0.02f; }
 static float BUTTON_SIZE() { return WORLD_WIDTH * 0.1f; }
 
@@ -73,6 +77,8 @@ class Game : public GameControl, public Container
   Widget           *m_left_button;
   Widget           *m_right_button;
   int               m_reset_countdown;
+  unsigned          m_drawnChanges;
+  DemoJournal       m_journal;
 public:
   Game( Levels* levels, int width, int height ) 
   : m_pauseLabel( NULL ),
@@ -85,6 +91,8 @@ public:
   , m_left_button(new Button(Tr("MENU"), Event(Event::OPTION, 1)))
   , m_right_button(new Button(Tr("TOOL"), Event(Event::OPTION, 2)))
   , m_reset_countdown(0)
+  , m_drawnChanges(0)
+  , m_journal()
   {
     EVAL_LOCAL(BUTTON_BORDER);
     EVAL_LOCAL(BUTTON_SIZE);
@@ -100,6 +108,7 @@ public:
     transparent(true); //don't clear
     m_greedyMouse = true; //get mouse clicks outside the window!
 
+    m_scene.recordTo(&m_journal);
     m_levels = levels;
     gotoLevel(0);
     //add( new Button("O",Event::OPTION), Rect(800-32,0,32,32) );
@@ -119,7 +128,7 @@ public:
           return;
       }
 
-      if (m_scene.load(m_levels->load(level))) {
+      if (m_scene.loadFile(m_levels->levelName(level, false))) {
           m_replaying = m_scene.start();
 
           if (m_edit) {
@@ -129,6 +138,13 @@ public:
 
           m_level = level;
           m_stats.reset(OS->ticks());
+
+          std::string path = m_levels->demoPath(level);
+          if (path != "") {
+              m_journal.start(m_levels->levelName(level, false), path, m_levels->demoName(level));
+          } else {
+              m_journal.cancel();
+          }
       }
   }
 
@@ -157,12 +173,9 @@ public:
 
   void saveDemo()
   {
-    std::string path = m_levels->demoPath(m_level);
-    if (path != "") {
-      OS->ensurePath(path);
-      path = m_levels->demoName(m_level);
-      LOG_INFO("Saving demo of level %d to %s", m_level, path.c_str());
-      m_scene.save(path, true);
+    if (m_journal.active()) {
+      LOG_INFO("Saving demo of level %d", m_level);
+      m_journal.finish(m_scene);
     } else {
       LOG_INFO("Not saving demo of demo");
     }
@@ -288,6 +301,10 @@ public:
   {
     m_scene.step();
 
+    if (m_scene.getTicks() % DEMO_JOURNAL_INTERVAL == 0) {
+      m_journal.sync();
+    }
+
     if (m_reset_countdown > 0) {
         m_reset_countdown--;
         if (m_reset_countdown == REWIND_ANIMATION_TICKS / 2) {
@@ -339,6 +356,10 @@ public:
       }
     }
 
+    if (m_scene.changes() != m_drawnChanges || m_reset_countdown > 0) {
+      dirty();
+    }
+
     Container::onTick(tick);
   }
 
@@ -350,7 +371,12 @@ public:
       auto world_size = OS->renderer()->world_size();
       auto world_rect = OS->renderer()->world_rect();
 
-      if (window) {
+      // Unless the scene changed, the offscreen still holds it (and its effect)
+      if (window && (!window->offscreenDrawn() || m_reset_countdown > 0 ||
+                     m_scene.changes() != m_drawnChanges)) {
+          // Before any of the render targets below is active
+          m_scene.updateStaticLayer();
+
           // If we draw an effect
           std::function<void(Image *, const Rect &src, const Rect &dst)> effect;
 
@@ -385,6 +411,7 @@ public:
           window->beginOffscreen();
           effect(img.get(), fb_rect, fb_rect);
           window->endOffscreen();
+          m_drawnChanges = m_scene.changes();
       }
 
       // Draw the whole backbuffer to the screen
@@ -489,7 +516,7 @@ public:
       if (m_level==0 && m_isCompleted) {
 	// from title try to find the first uncompleted level
 	while (m_level < m_levels->numLevels()
-	       && m_os->exists(m_levels->demoName(m_level))) {
+	       && m_levels->hasDemo(m_level)) {
 	  m_level++;
 	}
 	gotoLevel(m_level);
@@ -14,11 +14,10 @@
  */
 
 #include "Interactions.h"
+#include "FileWriter.h"
 
-#include "thp_format.h"
 #include "petals_log.h"
 
-#include <sstream>
 #include <cctype>
 
 namespace NP {
@@ -85,21 +84,23 @@ Interactions::parse(const std::string &line)
 bool
 Interactions::add(const std::string &color, const std::string &action)
 {
-    m_interactions[atoi(color.c_str())] = action;
-    return true;
+    return add(atoi(color.c_str()), action);
 }
 
-std::string
-Interactions::serialize()
+bool
+Interactions::add(int color, const std::string &action)
 {
-    std::stringstream s;
+    m_interactions[color] = action;
+    return true;
+}
 
+void
+Interactions::serialize(TextBuffer &out)
+{
     for (auto &interaction: m_interactions) {
-        s << thp::format("<np:interaction np:color=\"%d\" np_action=\"%s\" />",
-                         interaction.first, interaction.second.c_str()) << std::endl;
+        out.printf("<np:interaction np:color=\"%d\" np_action=\"%s\" />\n",
+                   interaction.first, interaction.second.c_str());
     }
-
-    return s.str();
 }
 
 }; /* namespace NP */
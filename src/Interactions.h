@@ -19,6 +19,9 @@
 #include <string>
 #include <map>
 
+class BinaryLevel;
+class TextBuffer;
+
 namespace NP {
 
 class Interactions {
@@ -31,10 +34,13 @@ public:
 
     bool parse(const std::string &line);
     bool add(const std::string &color, const std::string &action);
-    std::string serialize();
+    bool add(int color, const std::string &action);
+    void serialize(TextBuffer &out);
 
 private:
     std::map<int,std::string> m_interactions;
+
+    friend class ::BinaryLevel;
 };
 
 }; /* namespace NP */
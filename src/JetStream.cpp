@@ -1,6 +1,6 @@
 #include "JetStream.h"
 
-#include "thp_format.h"
+#include "FileWriter.h"
 #include "petals_log.h"
 
 JetStream::JetStream(const Rect &rect, const b2Vec2 &force)
@@ -73,12 +73,12 @@ JetStream::update(std::vector<Stroke *> &strokes)
     }
 }
 
-std::string
-JetStream::asString()
+void
+JetStream::serialize(TextBuffer &out)
 {
-    return thp::format("<rect class=\"jetstream\" x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
-                       "np:force=\"%.2f,%.2f\" fill=\"blue\" stroke=\"none\" />",
-                       rect.tl.x, rect.tl.y, rect.w(), rect.h(), force.x, force.y);
+    out.printf("<rect class=\"jetstream\" x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+               "np:force=\"%.2f,%.2f\" fill=\"blue\" stroke=\"none\" />\n",
+               rect.tl.x, rect.tl.y, rect.w(), rect.h(), force.x, force.y);
 }
 
 void
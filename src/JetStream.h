@@ -7,6 +7,8 @@
 
 #include <string>
 
+class TextBuffer;
+
 class JetStream {
 public:
     JetStream(const Rect &rect, const b2Vec2 &force);
@@ -14,7 +16,7 @@ public:
     void draw(Canvas &canvas);
     void tick();
     void update(std::vector<Stroke *> &strokes);
-    std::string asString();
+    void serialize(TextBuffer &out);
 
     void activate();
     void resize(const Vec2 &mouse);
@@ -25,6 +27,8 @@ private:
     Rect rect;
     b2Vec2 force;
     std::vector<b2Vec2> particles;
+
+    friend class BinaryLevel;
 };
 
 #endif /* NUMPTYPHYSICS_JETSTREAM_H */
@@ -0,0 +1,383 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "LevelCatalog.h"
+#include "BinaryLevel.h"
+#include "Assets.h"
+#include "AssetPack.h"
+#include "SVGReader.h"
+#include "Os.h"
+
+#include "petals_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <algorithm>
+
+
+static const char *CATALOG_HEADER = "numptyphysics-catalog 1";
+
+// Stored instead of an mtime that may still change within the same second
+static const long UNSTABLE_MTIME = -1;
+
+
+static long
+stableMtime(time_t mtime)
+{
+    // A change later in the same second would leave the mtime as it is
+    return (mtime >= time(nullptr) - 1) ? UNSTABLE_MTIME : long(mtime);
+}
+
+static std::string
+singleLine(const std::string &s)
+{
+    std::string result(s);
+    std::replace(result.begin(), result.end(), '\n', ' ');
+    std::replace(result.begin(), result.end(), '\r', ' ');
+    return result;
+}
+
+class LevelInfoHandler : public SVGReader::Handler {
+public:
+    LevelInfoHandler(LevelCatalog::Level &level)
+        : SVGReader::Handler()
+        , level(level)
+    {
+    }
+
+    virtual void element(const SVGReader::Range &name, const SVGReader &reader)
+    {
+        if (name == "np:meta") {
+            const SVGReader::Range *attr;
+
+            attr = reader.attribute("title");
+            if (attr) {
+                level.title = attr->str();
+            }
+
+            attr = reader.attribute("author");
+            if (attr) {
+                level.author = attr->str();
+            }
+        } else if (name == "path" && reader.attribute("class")) {
+            level.strokes++;
+        }
+    }
+
+private:
+    LevelCatalog::Level &level;
+};
+
+static void
+readLevelInfo(const std::string &file, LevelCatalog::Level &level)
+{
+    Asset data = Assets::open(file);
+    if (!data.valid()) {
+        return;
+    }
+
+    if (BinaryLevel::isBinary(file)) {
+        BinaryLevel::info(data.data(), data.size(), level.title, level.author, level.strokes);
+        return;
+    }
+
+    static const char *SVG_TAG = "<svg";
+    const char *end = data.data() + data.size();
+    if (std::search(data.data(), end, SVG_TAG, SVG_TAG + strlen(SVG_TAG)) != end) {
+        LevelInfoHandler handler(level);
+        SVGReader(data.data(), data.size()).parse(handler);
+        return;
+    }
+
+    // NPH format
+    const char *line = data.data();
+    while (line < end) {
+        const char *eol = std::find(line, end, '\n');
+        const char *value = std::find(line, eol, ':');
+        value = (value == eol) ? eol : value + 1;
+        switch (*line) {
+            case 'T':
+                level.title.assign(value, eol);
+                break;
+            case 'A':
+                level.author.assign(value, eol);
+                break;
+            case 'S':
+                level.strokes++;
+                break;
+            default:
+                break;
+        }
+        line = (eol == end) ? end : eol + 1;
+    }
+}
+
+// Most file systems tell the type right in the entry, saving a stat()
+// per file when a directory with many recordings is rescanned
+static bool
+isDirectory(const std::string &dir, const struct dirent *entry)
+{
+#if defined(DT_UNKNOWN)
+    if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) {
+        return entry->d_type == DT_DIR;
+    }
+#endif
+
+    std::string filename = dir + Os::pathSep + entry->d_name;
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+LevelCatalog::LevelCatalog(const std::string &filename)
+    : m_filename(filename)
+    , m_directories()
+    , m_levels()
+    , m_dirty(false)
+    , m_stats()
+{
+    load();
+}
+
+void
+LevelCatalog::load()
+{
+    std::ifstream is(m_filename.c_str(), std::ios::in);
+    std::string line;
+    if (!std::getline(is, line) || line != CATALOG_HEADER) {
+        return;
+    }
+
+    Directory *dir = nullptr;
+    Level *level = nullptr;
+    while (std::getline(is, line)) {
+        long a, b;
+        int strokes, flag;
+        int pos = 0;
+        const char *s = line.c_str();
+
+        if (sscanf(s, "d %ld %n", &a, &pos) == 1 && pos > 0) {
+            dir = &m_directories[s + pos];
+            dir->mtime = a;
+            level = nullptr;
+        } else if (sscanf(s, "e %d %n", &flag, &pos) == 1 && pos > 0 && dir) {
+            dir->entries.push_back(Entry{s + pos, flag != 0});
+        } else if (sscanf(s, "l %ld %ld %d %d %n", &a, &b, &strokes, &flag, &pos) == 4 && pos > 0) {
+            level = &m_levels[s + pos];
+            level->size = a;
+            level->mtime = b;
+            level->strokes = strokes;
+            level->demo = (flag != 0);
+            dir = nullptr;
+        } else if (line.compare(0, 2, "t ") == 0 && level) {
+            level->title = line.substr(2);
+        } else if (line.compare(0, 2, "a ") == 0 && level) {
+            level->author = line.substr(2);
+        } else {
+            LOG_WARNING("Ignoring corrupt level catalog %s", m_filename.c_str());
+            m_directories.clear();
+            m_levels.clear();
+            return;
+        }
+    }
+}
+
+const LevelCatalog::Directory *
+LevelCatalog::directory(const std::string &path)
+{
+    // Packed directories only change together with the pack
+    const AssetPack &pack = Assets::pack();
+    bool packed = pack.isDirectory(path);
+
+    struct stat st;
+    if (packed) {
+        st.st_mtime = pack.mtime();
+    } else if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return nullptr;
+    }
+
+    m_stats.directories++;
+
+    auto it = m_directories.find(path);
+    if (it != m_directories.end() && it->second.mtime == long(st.st_mtime) &&
+            it->second.mtime != UNSTABLE_MTIME) {
+        it->second.changed = false;
+        it->second.used = true;
+        return &it->second;
+    }
+
+    Directory &result = m_directories[path];
+    result.mtime = stableMtime(st.st_mtime);
+    result.changed = true;
+    result.used = true;
+    result.entries.clear();
+
+    m_stats.scanned++;
+    m_dirty = true;
+
+    if (packed) {
+        std::vector<AssetPack::Entry> entries;
+        pack.list(path, entries);
+        for (auto &entry: entries) {
+            result.entries.push_back(Entry{entry.name, entry.directory});
+        }
+        return &result;
+    }
+
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        m_directories.erase(path);
+        return nullptr;
+    }
+
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        result.entries.push_back(Entry{entry->d_name, isDirectory(path, entry)});
+    }
+    closedir(dir);
+
+    return &result;
+}
+
+const LevelCatalog::Level &
+LevelCatalog::level(const std::string &file, bool verify)
+{
+    m_stats.levels++;
+
+    auto it = m_levels.find(file);
+    if (it != m_levels.end() && !verify) {
+        it->second.used = true;
+        return it->second;
+    }
+
+    struct stat st;
+    long size = 0, mtime = UNSTABLE_MTIME;
+    size_t packedSize;
+    if (Assets::pack().isFile(file, &packedSize)) {
+        size = packedSize;
+        mtime = stableMtime(Assets::pack().mtime());
+    } else if (stat(file.c_str(), &st) == 0) {
+        size = st.st_size;
+        mtime = stableMtime(st.st_mtime);
+    }
+
+    if (it != m_levels.end() && it->second.size == size && it->second.mtime == mtime &&
+            mtime != UNSTABLE_MTIME) {
+        it->second.used = true;
+        return it->second;
+    }
+
+    Level &result = m_levels[file];
+    bool demo = result.demo;
+    result = Level();
+    result.size = size;
+    result.mtime = mtime;
+    result.demo = demo;
+    result.used = true;
+    readLevelInfo(file, result);
+
+    m_stats.parsed++;
+    m_dirty = true;
+    return result;
+}
+
+void
+LevelCatalog::setDemo(const std::string &file, bool demo)
+{
+    auto it = m_levels.find(file);
+    if (it != m_levels.end() && it->second.demo != demo) {
+        it->second.demo = demo;
+        m_dirty = true;
+    }
+}
+
+bool
+LevelCatalog::save()
+{
+    // Forget what wasn't seen in this run (deleted files, removed dirs)
+    for (auto it = m_directories.begin(); it != m_directories.end(); ) {
+        if (!it->second.used) {
+            it = m_directories.erase(it);
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_levels.begin(); it != m_levels.end(); ) {
+        if (!it->second.used) {
+            it = m_levels.erase(it);
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+
+    if (!m_dirty) {
+        return true;
+    }
+
+    size_t sep = m_filename.rfind(Os::pathSep);
+    if (sep != std::string::npos) {
+        OS->ensurePath(m_filename.substr(0, sep));
+    }
+
+    std::string tmpname = m_filename + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "w");
+    if (!fp) {
+        LOG_WARNING("Cannot write level catalog %s", tmpname.c_str());
+        return false;
+    }
+
+    fprintf(fp, "%s\n", CATALOG_HEADER);
+    for (auto &it: m_directories) {
+        fprintf(fp, "d %ld %s\n", it.second.mtime, it.first.c_str());
+        for (auto &entry: it.second.entries) {
+            fprintf(fp, "e %d %s\n", entry.directory ? 1 : 0, entry.name.c_str());
+        }
+    }
+    for (auto &it: m_levels) {
+        const Level &level = it.second;
+        fprintf(fp, "l %ld %ld %d %d %s\n", level.size, level.mtime, level.strokes,
+                level.demo ? 1 : 0, it.first.c_str());
+        fprintf(fp, "t %s\n", singleLine(level.title).c_str());
+        fprintf(fp, "a %s\n", singleLine(level.author).c_str());
+    }
+
+    bool ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+#if defined(_WIN32)
+    remove(m_filename.c_str());
+#endif
+    if (!ok || rename(tmpname.c_str(), m_filename.c_str()) != 0) {
+        LOG_WARNING("Cannot write level catalog %s", m_filename.c_str());
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
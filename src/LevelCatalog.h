@@ -0,0 +1,98 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_LEVELCATALOG_H
+#define NUMPTYPHYSICS_LEVELCATALOG_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+/**
+ * Persistent cache of the level directories
+ *
+ * A directory is only read again when its mtime differs from the one
+ * stored in the catalog, otherwise the cached listing is used and
+ * nothing inside it is touched. For each level file the catalog keeps
+ * the size, mtime, title, author, stroke count and whether a recorded
+ * solution exists; files in rescanned directories are only parsed again
+ * if their size or mtime changed.
+ *
+ * Files rewritten in place (e.g. a demo recorded again) don't change
+ * the mtime of their directory and keep their old metadata until
+ * something else in that directory changes. Everything inside the
+ * asset pack shares the mtime of the pack.
+ **/
+class LevelCatalog {
+public:
+    struct Entry {
+        std::string name;
+        bool directory;
+    };
+
+    struct Directory {
+        Directory() : mtime(0), changed(true), used(false), entries() {}
+
+        long mtime;
+        bool changed; // rescanned in this run
+        bool used;
+        std::vector<Entry> entries;
+    };
+
+    struct Level {
+        Level() : size(0), mtime(0), title(), author(), strokes(0), demo(false), used(false) {}
+
+        long size;
+        long mtime;
+        std::string title;
+        std::string author;
+        int strokes;
+        bool demo;
+        bool used;
+    };
+
+    struct Stats {
+        Stats() : directories(0), scanned(0), levels(0), parsed(0) {}
+
+        int directories;
+        int scanned;
+        int levels;
+        int parsed;
+    };
+
+    LevelCatalog(const std::string &filename);
+
+    // nullptr if path is not a readable directory
+    const Directory *directory(const std::string &path);
+    // verify: stat() the file and re-read it if it changed
+    const Level &level(const std::string &file, bool verify);
+    void setDemo(const std::string &file, bool demo);
+
+    bool save();
+
+    const Stats &stats() const { return m_stats; }
+
+private:
+    void load();
+
+    std::string m_filename;
+    std::unordered_map<std::string, Directory> m_directories;
+    std::unordered_map<std::string, Level> m_levels;
+    bool m_dirty;
+    Stats m_stats;
+};
+
+#endif /* NUMPTYPHYSICS_LEVELCATALOG_H */
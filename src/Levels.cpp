@@ -15,23 +15,24 @@
  */
 
 #include <cstring>
-#include <sys/types.h>
-#include <dirent.h>
 #include <string.h>
 
 #include "Levels.h"
 #include "Config.h"
 #include "Os.h"
+#include "BinaryLevel.h"
 
 #include "petals_log.h"
 
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <unordered_set>
 
 
 static const char MISC_COLLECTION[] = "C99_My Levels";
 static const char DEMO_COLLECTION[] = "D00_My Solutions";
+static const char CATALOG_FILE[] = "levels.catalog";
 
 
 static std::string nameFromPath(const std::string& path)
@@ -163,6 +164,10 @@ void
 LevelDesc::swap(LevelDesc &a, LevelDesc &b)
 {
     std::swap(a.file, b.file);
+    std::swap(a.title, b.title);
+    std::swap(a.author, b.author);
+    std::swap(a.strokes, b.strokes);
+    std::swap(a.demo, b.demo);
 }
 
 bool
@@ -179,12 +184,29 @@ Collection::swap(Collection &a, Collection &b)
     std::swap(a.levels, b.levels);
 }
 
-Levels::Levels(std::vector<std::string> dirs)
+static std::string recordingDir()
+{
+  // Has to exist before it can be watched
+  std::string dir = Config::userRecordingDir();
+  OS->ensurePath(dir);
+  return dir;
+}
+
+Levels::Levels(std::vector<std::string> dirs, const std::string &catalog)
     : m_numLevels(0)
+    , m_collections()
+    , m_catalog(catalog.empty() ? Config::userCacheFileName(CATALOG_FILE) : catalog)
+    , m_offsets()
+    , m_levelCollection()
+    , m_levelIds()
+    , m_demoIds()
+    , m_recordings(recordingDir())
 {
     for (auto &dir: dirs) {
-        addPath(dir);
+        scanPath(dir);
     }
+
+    finishScan();
 }
 
 static std::string fileExtension(const std::string &path)
@@ -198,35 +220,98 @@ static std::string fileExtension(const std::string &path)
     return "";
 }
 
+static std::string demoDir(const std::string &collection, const std::string &file)
+{
+  std::string ext = fileExtension(file);
+  if (ext == ".npd" || ext == ".npdsvg") {
+    /* Kludge: If the level from which we want to save a demo is
+     * already a demo file, return an empty string to signal
+     * "don't have this demo" - see Game.cpp */
+    return "";
+  }
+
+  return Config::userRecordingCollectionDir(collection);
+}
+
+static std::string demoFile(const std::string &collection, const std::string &file)
+{
+  std::string name = Config::baseName(file);
+
+  if (fileExtension(name) == ".nph") {
+      name.resize(name.length()-4);
+  }
+  if (fileExtension(name) == ".npsvg") {
+      name.resize(name.length()-6);
+  }
+  if (fileExtension(name) == BinaryLevel::EXTENSION) {
+      name.resize(name.length()-strlen(BinaryLevel::EXTENSION));
+  }
+
+  return Config::joinPath(demoDir(collection, file), name + ".npdsvg");
+}
+
 bool Levels::addPath(const std::string &path)
 {
-    bool result = false;
+    bool result = scanPath(path);
+    finishScan();
+    return result;
+}
+
+bool Levels::scanPath(const std::string &path)
+{
     std::string ext = fileExtension(path);
 
-    if (ext == ".nph" || ext == ".npd" || ext == ".npsvg" || ext == ".npdsvg") {
+    if (ext == ".nph" || ext == ".npd" || ext == ".npsvg" || ext == ".npdsvg" || ext == BinaryLevel::EXTENSION) {
         addLevel(path);
-        result = true;
-    } else {
-        result = scanCollection(path);
+        return true;
     }
 
+    return scanCollection(path);
+}
+
+void Levels::finishScan()
+{
     sort();
-    return result;
+    updateDemos();
+    m_catalog.save();
+}
+
+void Levels::reindex()
+{
+    m_offsets.clear();
+    m_levelCollection.clear();
+    m_levelIds.clear();
+    m_demoIds.clear();
+
+    int id = 0;
+    for (int c=0; c<m_collections.size(); c++) {
+        m_offsets.push_back(id);
+        for (auto &level: m_collections[c].levels) {
+            m_levelCollection.push_back(c);
+            // The first of several levels with the same file wins
+            m_levelIds.emplace(level.file, id);
+            if (!demoDir(m_collections[c].name, level.file).empty()) {
+                m_demoIds.emplace(demoFile(m_collections[c].name, level.file), id);
+            }
+            id++;
+        }
+    }
+    m_offsets.push_back(id);
 }
 
 bool Levels::addLevel(const std::string& file)
 {
     auto ext = fileExtension(file);
     if (ext == ".npd" || ext == ".npdsvg") {
-        return addLevel(getCollection(DEMO_COLLECTION), file);
+        return addLevel(getCollection(DEMO_COLLECTION), file, true);
     } else {
-        return addLevel(getCollection(MISC_COLLECTION), file);
+        return addLevel(getCollection(MISC_COLLECTION), file, true);
     }
 }
 
-bool Levels::addLevel(Collection &collection, const std::string &file)
+bool Levels::addLevel(Collection &collection, const std::string &file, bool verify)
 {
-    collection.levels.push_back(LevelDesc(file));
+    collection.levels.push_back(LevelDesc(file, m_catalog.level(file, verify)));
     m_numLevels++;
     return true;
 }
@@ -248,30 +333,42 @@ Collection &Levels::getCollection(const std::string &file)
 bool Levels::scanCollection(const std::string &file)
 {
     std::string collectionName = file.substr(file.find_last_of(Os::pathSep)+1);
-    DIR *dir = opendir(file.c_str());
+    const LevelCatalog::Directory *dir = m_catalog.directory(file);
     if (dir) {
-        bool result = false;
-        while (struct dirent *entry = readdir(dir)) {
-            if (entry->d_name[0] == '.') {
-                continue;
-            }
+        // Levels in an unchanged directory aren't looked at individually
+        bool verify = dir->changed;
+
+        std::unordered_set<std::string> names;
+        for (auto &entry: dir->entries) {
+            names.insert(entry.name);
+        }
 
-            std::string filename = file + Os::pathSep + entry->d_name;
-            std::string ext = fileExtension(filename);
-            if (ext == ".nph" || ext == ".npsvg") {
-                if (addLevel(getCollection(collectionName), filename)) {
+        bool result = false;
+        for (auto &entry: dir->entries) {
+            std::string filename = file + Os::pathSep + entry.name;
+            std::string ext = fileExtension(entry.name);
+            if (ext == BinaryLevel::EXTENSION) {
+                if (addLevel(getCollection(collectionName), filename, verify)) {
+                    result = true;
+                }
+            } else if (ext == ".nph" || ext == ".npsvg") {
+                // A compiled copy of the level is picked up instead
+                std::string stem = entry.name.substr(0, entry.name.size() - ext.size());
+                if (names.count(stem + BinaryLevel::EXTENSION)) {
+                    continue;
+                }
+                if (addLevel(getCollection(collectionName), filename, verify)) {
                     result = true;
                 }
             } else if (ext == ".npd" || ext == ".npdsvg") {
-                if (addLevel(getCollection(DEMO_COLLECTION), filename)) {
+                if (addLevel(getCollection(DEMO_COLLECTION), filename, verify)) {
                     result = true;
                 }
-            } else if (addPath(filename)) {
+            } else if (entry.directory && scanPath(filename)) {
                 result = true;
             }
         }
 
-        closedir(dir);
         return result;
     }
 
@@ -314,20 +411,20 @@ Levels::sort()
     for (auto &collection: m_collections) {
         std::sort(collection.levels.begin(), collection.levels.end());
     }
+    reindex();
 }
 
 void
 Levels::dump()
 {
     for (int i=0; i<m_collections.size(); i++) {
-        LOG_INFO("Collection #%d: %s", (i+1),
-                    collectionName(i, true).c_str());
-        for (int j=0; j<m_collections[i].levels.size(); j++) {
-            LevelDesc &level = m_collections[i].levels[j];
-            LOG_INFO(" Level #%d: %s\n", (j+1),
-                        level.file.c_str());
-        }
+        LOG_INFO("Collection #%d: %s (%d levels)", (i+1),
+                    collectionName(i, true).c_str(), int(m_collections[i].levels.size()));
     }
+
+    auto &stats = m_catalog.stats();
+    LOG_INFO("Level catalog: rescanned %d of %d directories, read %d of %d levels",
+             stats.scanned, stats.directories, stats.parsed, stats.levels);
 }
 
 int Levels::numCollections()
@@ -337,15 +434,10 @@ int Levels::numCollections()
 
 int Levels::collectionFromLevel( int i, int *indexInCol )
 {
-  if (i < m_numLevels) {
-    for ( int c=0; c<m_collections.size(); c++ ) {
-      if ( i >= m_collections[c].levels.size() ) {
-	i -= m_collections[c].levels.size();
-      } else {
-	if (indexInCol) *indexInCol = i;
-	return c;
-      }
-    }
+  if (i >= 0 && i < m_numLevels) {
+    int c = m_levelCollection[i];
+    if (indexInCol) *indexInCol = i - m_offsets[c];
+    return c;
   }
 
   return 0;
@@ -376,11 +468,7 @@ int Levels::collectionLevel(int c, int i)
 {
   if (c>=0 && c<numCollections()) {
     if (i>=0 && i<m_collections[c].levels.size()) {
-      int l = i;
-      for (int j=0; j<c; j++) {
-	l += m_collections[j].levels.size();
-      }
-      return l;
+      return m_offsets[c] + i;
     }
   }
   return 0;
@@ -389,51 +477,78 @@ int Levels::collectionLevel(int c, int i)
 
 std::string Levels::demoPath(int l)
 {
-  std::string name = levelName(l,false);
-  std::string ext = fileExtension(name);
-  if (ext == ".npd" || ext == ".npdsvg") {
-    /* Kludge: If the level from which we want to save a demo is
-     * already a demo file, return an empty string to signal
-     * "don't have this demo" - see Game.cpp */
-    return "";
-  }
-
-  int c = collectionFromLevel(l);
-  return Config::userRecordingCollectionDir(collectionName(c, false));
+  return demoDir(collectionName(collectionFromLevel(l), false), levelName(l, false));
 }
 
 std::string Levels::demoName(int l)
 {
-  std::string name = levelName(l,false);
+  return demoFile(collectionName(collectionFromLevel(l), false), levelName(l, false));
+}
 
-  name = Config::baseName(name);
+void Levels::updateDemos()
+{
+  std::unordered_set<std::string> demos;
+  for (auto &collection: m_collections) {
+    if (collection.file == DEMO_COLLECTION) {
+      for (auto &level: collection.levels) {
+        demos.insert(level.file);
+      }
+    }
+  }
 
-  if (fileExtension(name) == ".nph") {
-      name.resize(name.length()-4);
+  for (auto &collection: m_collections) {
+    for (auto &level: collection.levels) {
+      level.demo = demos.count(demoFile(collection.name, level.file)) > 0;
+      m_catalog.setDemo(level.file, level.demo);
+    }
   }
-  if (fileExtension(name) == ".npsvg") {
-      name.resize(name.length()-6);
+}
+
+void Levels::setDemo(const std::string &file, bool demo)
+{
+  auto range = m_demoIds.equal_range(file);
+  for (auto it=range.first; it!=range.second; ++it) {
+    LevelDesc *lev = findLevel(it->second);
+    lev->demo = demo;
+    m_catalog.setDemo(lev->file, demo);
   }
+}
 
-  return Config::joinPath(demoPath(l), name + ".npdsvg");
+void Levels::pollDemos()
+{
+  m_recordings.poll([this] (const std::string &dir, const std::string &name, bool exists) {
+    if (name.empty()) {
+      // Missed some changes, check every demo again
+      for (auto &demo: m_demoIds) {
+        setDemo(demo.first, OS->exists(demo.first));
+      }
+    } else {
+      setDemo(Config::joinPath(dir, name), exists);
+    }
+  });
 }
 
 bool Levels::hasDemo(int l)
 {
-  return OS->exists(demoName(l));
+  LevelDesc *lev = findLevel(l);
+  if (!lev) {
+    return false;
+  }
+
+  if (!m_recordings.valid()) {
+    return OS->exists(demoName(l));
+  }
+
+  pollDemos();
+  return lev->demo;
 }
 
 
 LevelDesc* Levels::findLevel( int i )
 {
-  if (i < m_numLevels) {
-    for ( int c=0; c<m_collections.size(); c++ ) {
-      if ( i >= m_collections[c].levels.size() ) {
-	i -= m_collections[c].levels.size();
-      } else {
-	return &(m_collections[c].levels[i]);
-      }
-    }
+  if (i >= 0 && i < m_numLevels) {
+    int c = m_levelCollection[i];
+    return &(m_collections[c].levels[i - m_offsets[c]]);
   }
   return NULL;
 }
@@ -441,16 +556,8 @@ LevelDesc* Levels::findLevel( int i )
 
 int Levels::findLevel( const char *file )
 {
-  int index = 0;
-  for ( int c=0; c<m_collections.size(); c++ ) {
-    for ( int i=0; i<m_collections[c].levels.size(); i++ ) {
-      if ( m_collections[c].levels[i].file == file ) {
-	return index + i;
-      }
-    }
-    index += m_collections[c].levels.size();
-  }
-  return -1;
+  auto it = m_levelIds.find(file);
+  return (it != m_levelIds.end()) ? it->second : -1;
 }
 
 
@@ -17,24 +17,41 @@
 #ifndef LEVELS_H
 #define LEVELS_H
 
+#include "LevelCatalog.h"
+#include "DirectoryWatcher.h"
+
 #include <cstdio>
 #include <sstream>
+#include <string>
 #include <vector>
+#include <unordered_map>
 
 struct LevelDesc {
     LevelDesc()
         : file()
+        , title()
+        , author()
+        , strokes(0)
+        , demo(false)
     {
     }
 
-    LevelDesc(const std::string &file)
+    LevelDesc(const std::string &file, const LevelCatalog::Level &info)
         : file(file)
+        , title(info.title)
+        , author(info.author)
+        , strokes(info.strokes)
+        , demo(info.demo)
     {
     }
 
     void swap(LevelDesc &a, LevelDesc &b);
 
     std::string file;
+    std::string title;
+    std::string author;
+    int strokes;
+    bool demo; // a solution has been recorded
 };
 
 struct Collection {
@@ -62,7 +79,8 @@ struct Collection {
 class Levels
 {
  public:
-  Levels(std::vector<std::string> dirs);
+  // catalog: file name of the level catalog cache, empty for the default
+  Levels(std::vector<std::string> dirs, const std::string &catalog="");
 
   bool addPath(const std::string &path);
 
@@ -86,15 +104,31 @@ class Levels
   void sort();
 
  private:
+  bool scanPath(const std::string &path);
+  void finishScan();
+  void updateDemos();
+  void reindex();
+  void pollDemos();
+  void setDemo(const std::string &file, bool demo);
+
   bool addLevel(const std::string &file);
 
-  bool addLevel(Collection &collection, const std::string &file);
+  bool addLevel(Collection &collection, const std::string &file, bool verify);
   LevelDesc *findLevel(int i);
   Collection &getCollection(const std::string &file);
   bool scanCollection(const std::string& file);
 
   int m_numLevels;
   std::vector<Collection> m_collections;
+  LevelCatalog m_catalog;
+
+  // Rebuilt by reindex() whenever levels are added or reordered
+  std::vector<int> m_offsets; // first level of each collection, then m_numLevels
+  std::vector<int> m_levelCollection; // collection of each level
+  std::unordered_map<std::string, int> m_levelIds; // level file -> level
+  std::unordered_multimap<std::string, int> m_demoIds; // demo file -> level
+
+  DirectoryWatcher m_recordings;
 };
 
 #endif //LEVELS_H
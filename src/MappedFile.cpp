@@ -0,0 +1,102 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "MappedFile.h"
+
+#include "petals_log.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile(const std::string &filename)
+    : m_data(nullptr)
+    , m_size(0)
+    , m_mapped(false)
+{
+#if !defined(_WIN32)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        LOG_WARNING("Cannot open %s", filename.c_str());
+        return;
+    }
+
+    struct stat st;
+    bool known = (fstat(fd, &st) == 0);
+    if (known && !S_ISREG(st.st_mode)) {
+        // Directories open fine, but have no contents to read
+        LOG_WARNING("Not a file: %s", filename.c_str());
+        close(fd);
+        return;
+    }
+
+    if (known && st.st_size > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_data = static_cast<const char *>(addr);
+            m_size = st.st_size;
+            m_mapped = true;
+        }
+    }
+
+    close(fd);
+
+    if (m_mapped) {
+        return;
+    }
+#endif
+
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (!fp) {
+        LOG_WARNING("Cannot open %s", filename.c_str());
+        return;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (length > 0) {
+        char *buffer = static_cast<char *>(malloc(length));
+        if (buffer && fread(buffer, 1, length, fp) == size_t(length)) {
+            m_data = buffer;
+            m_size = length;
+        } else {
+            LOG_WARNING("Cannot read %s", filename.c_str());
+            free(buffer);
+        }
+    }
+
+    fclose(fp);
+}
+
+MappedFile::~MappedFile()
+{
+#if !defined(_WIN32)
+    if (m_mapped) {
+        munmap(const_cast<char *>(m_data), m_size);
+        return;
+    }
+#endif
+
+    free(const_cast<char *>(m_data));
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_MAPPEDFILE_H
+#define NUMPTYPHYSICS_MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * Read-only view of a whole file. Uses mmap() where available, so the
+ * contents are paged in on demand and never copied; elsewhere the file
+ * is read into a heap buffer once.
+ **/
+class MappedFile {
+public:
+    MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    bool valid() const { return m_data != nullptr; }
+    const char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+};
+
+#endif /* NUMPTYPHYSICS_MAPPEDFILE_H */
@@ -270,13 +270,21 @@ Os::appName()
 std::string
 Os::globalDataDir()
 {
+    // Looked up for every data file, but can't change while running
+    static std::string dataDir;
+    if (!dataDir.empty()) {
+        return dataDir;
+    }
+
     std::string sourceData = thp::format("%s/data", g_appDir.c_str());
 
     // Prefer './data' in the source checkout if available
     if (exists(sourceData)) {
-        return sourceData;
+        dataDir = sourceData;
+    } else {
+        // System-wide installation
+        dataDir = thp::format("%s/../share/%s/data", g_appDir.c_str(), appName().c_str());
     }
 
-    // System-wide installation
-    return thp::format("%s/../share/%s/data", g_appDir.c_str(), appName().c_str());
+    return dataDir;
 }
@@ -14,7 +14,11 @@
  * General Public License for more details.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
 #include <iostream>
 
 #include "Path.h"
@@ -75,10 +79,136 @@ Path::Path(int n, Vec2* p)
     }
 }
 
+// Bytes per point in typical path data, for reserving up front
+static const int AVERAGE_POINT_SIZE = 6;
+
+// Powers of ten that are exact in a double
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * Parses [-+]?[0-9]*(.[0-9]*)? at pos without going through the C
+ * library. With at most 15 significant digits both the mantissa and the
+ * power of ten are exact, so the single division rounds exactly like
+ * strtod() would. Returns false (leaving pos alone) if there are no
+ * digits or too many of them; callers fall back to the C library then.
+ **/
+static bool
+parseDecimal(const char *&pos, const char *end, double &value)
+{
+    const char *s = pos;
+
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int scale = 0;
+    bool digits = false;
+
+    while (s < end && *s >= '0' && *s <= '9') {
+        mantissa = mantissa * 10 + (*s - '0');
+        if (mantissa) {
+            significant++;
+        }
+        digits = true;
+        s++;
+    }
+
+    if (s < end && *s == '.') {
+        s++;
+        while (s < end && *s >= '0' && *s <= '9') {
+            mantissa = mantissa * 10 + (*s - '0');
+            if (mantissa) {
+                significant++;
+            }
+            scale++;
+            digits = true;
+            s++;
+        }
+    }
+
+    if (!digits || significant > 15 || scale >= int(sizeof(POW10) / sizeof(POW10[0]))) {
+        return false;
+    }
+
+    value = scale ? double(mantissa) / POW10[scale] : double(mantissa);
+    if (negative) {
+        value = -value;
+    }
+
+    pos = s;
+    return true;
+}
+
+static bool _isfloatspace(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r');
+}
+
+static bool _isfloatletter(char c)
+{
+    return (c == 'e' || c == 'E' || c == 'x' || c == 'X' || c == 'p' || c == 'P');
+}
+
+// Same result as sscanf(s, "%f") (s is NUL-terminated at end)
+static bool
+scanFloat(const char *&s, const char *end, float32 &result)
+{
+    while (s < end && _isfloatspace(*s)) {
+        s++;
+    }
+
+    double value;
+    const char *pos = s;
+    if (parseDecimal(pos, end, value) && (pos == end || !_isfloatletter(*pos))) {
+        result = value;
+        s = pos;
+        return true;
+    }
+
+    // Exponents, hex floats, inf/nan and long mantissas
+    char *endptr = nullptr;
+    result = strtof(s, &endptr);
+    if (endptr == s) {
+        return false;
+    }
+
+    // scanf() fails on "0x" without hex digits, and swallows an
+    // exponent without digits ("2e,3")
+    const char *digits = (*s == '-' || *s == '+') ? s + 1 : s;
+    if (endptr < end && (*endptr == 'x' || *endptr == 'X') &&
+            endptr == digits + 1 && *digits == '0') {
+        return false;
+    } else if (endptr < end && (*endptr == 'e' || *endptr == 'E') &&
+            std::find_if(s, static_cast<const char *>(endptr), [] (char c) {
+                return c == 'e' || c == 'E';
+            }) == endptr) {
+        endptr++;
+        if (endptr < end && (*endptr == '+' || *endptr == '-')) {
+            endptr++;
+        }
+    }
+
+    s = endptr;
+    return true;
+}
+
 Path::Path( const char *s )
 {
-  float32 x,y;      
-  while ( sscanf( s, "%f,%f", &x, &y )==2) {
+  const char *end = s + strlen(s);
+  reserve( (end - s) / AVERAGE_POINT_SIZE + 1 );
+  float32 x,y;
+  while ( true ) {
+    const char *pos = s;
+    if ( !scanFloat( pos, end, x ) || pos == end || *pos++ != ',' || !scanFloat( pos, end, y ) ) {
+      break;
+    }
     push_back( Vec2((int)x,(int)y) );
     while ( *s && *s!=' ' && *s!='\t' ) s++;
     while ( *s==' ' || *s=='\t' ) s++;
@@ -87,18 +217,23 @@ Path::Path( const char *s )
 
 class SVGPathTokenizer {
 public:
-    SVGPathTokenizer(const std::string &path);
+    struct Token {
+        const char *begin;
+        const char *end;
+    };
+
+    SVGPathTokenizer(const char *begin, const char *end);
 
-    bool next(std::string &output);
+    bool next(Token &output);
 
 private:
-    std::string m_path;
-    int m_ipos;
+    const char *m_pos;
+    const char *m_end;
 };
 
-SVGPathTokenizer::SVGPathTokenizer(const std::string &path)
-    : m_path(path)
-    , m_ipos(0)
+SVGPathTokenizer::SVGPathTokenizer(const char *begin, const char *end)
+    : m_pos(begin)
+    , m_end(end)
 {
 }
 
@@ -118,30 +253,32 @@ static bool _isctrl(char c)
 }
 
 bool
-SVGPathTokenizer::next(std::string &output)
+SVGPathTokenizer::next(Token &output)
 {
-    if (m_ipos < m_path.length()) {
-        // Scan forward to first non-space character
-        while (m_ipos < m_path.length() && _isspace(m_path.at(m_ipos))) {
-            m_ipos++;
-        }
+    // Scan forward to first non-space character
+    while (m_pos < m_end && _isspace(*m_pos)) {
+        m_pos++;
+    }
 
-        int start = m_ipos;
-        char c = m_path.at(start);
+    if (m_pos < m_end) {
+        const char *start = m_pos;
+        char c = *start;
         if (_isctrl(c)) {
-            output = m_path.substr(start, 1);
-            m_ipos++;
+            m_pos++;
+            output = Token{start, m_pos};
             return true;
         }
 
         if (_isnumber(c)) {
-            while (m_ipos < m_path.length() && _isnumber(m_path.at(m_ipos))) {
-                m_ipos++;
+            while (m_pos < m_end && _isnumber(*m_pos)) {
+                m_pos++;
             };
 
-            int end = m_ipos;
-            output = m_path.substr(start, end-start);
-            m_ipos++;
+            output = Token{start, m_pos};
+            if (m_pos < m_end) {
+                // Skips the separator (or command) after a number
+                m_pos++;
+            }
             return true;
         }
     }
@@ -149,9 +286,22 @@ SVGPathTokenizer::next(std::string &output)
     return false;
 }
 
+// Same result as atof() on the token
+static double
+tokenValue(const SVGPathTokenizer::Token &token)
+{
+    double value;
+    const char *pos = token.begin;
+    if (parseDecimal(pos, token.end, value)) {
+        return value;
+    }
+
+    return atof(std::string(token.begin, token.end).c_str());
+}
+
 class SVGPathParser {
 public:
-    SVGPathParser(const std::string &path);
+    SVGPathParser(const char *begin, const char *end);
 
     bool next(Vec2 &output);
 
@@ -166,9 +316,10 @@ private:
     enum Positioning m_positioning;
 };
 
-SVGPathParser::SVGPathParser(const std::string &path)
-    : m_tokenizer(path)
+SVGPathParser::SVGPathParser(const char *begin, const char *end)
+    : m_tokenizer(begin, end)
     , m_current()
+    , m_current_valid(false)
     , m_positioning(M_ABSOLUTE)
 {
 }
@@ -176,30 +327,27 @@ SVGPathParser::SVGPathParser(const std::string &path)
 bool
 SVGPathParser::next(Vec2 &output)
 {
-    std::string a, b;
+    SVGPathTokenizer::Token a, b;
     if (!m_tokenizer.next(a)) {
         return false;
     }
 
-    if (a == "m" || a == "l" || a == "M" || a == "L") {
-        if (a == "m" || a == "l") {
-            m_positioning = M_RELATIVE;
-        } else if (a == "M" || a == "L") {
-            m_positioning = M_ABSOLUTE;
-        }
+    char c = *a.begin;
+    if (_isctrl(c)) {
+        m_positioning = (c == 'm' || c == 'l') ? M_RELATIVE : M_ABSOLUTE;
 
         if (!m_tokenizer.next(a)) {
-            LOG_WARNING("Incomplete coordinate after %s", a.c_str());
+            LOG_WARNING("Incomplete coordinate after %c", c);
             return false;
         }
     }
 
     if (!m_tokenizer.next(b)) {
-        LOG_WARNING("Incomplete coordinate after %s", a.c_str());
+        LOG_WARNING("Incomplete coordinate after %.*s", int(a.end - a.begin), a.begin);
         return false;
     }
 
-    Vec2 pos(atof(a.c_str()), atof(b.c_str()));
+    Vec2 pos(tokenValue(a), tokenValue(b));
     if (m_current_valid && m_positioning == M_RELATIVE) {
         m_current += pos;
     } else {
@@ -213,10 +361,18 @@ SVGPathParser::next(Vec2 &output)
 
 Path
 Path::fromSVG(const std::string &svgpath)
+{
+    return fromSVG(svgpath.data(), svgpath.data() + svgpath.size());
+}
+
+Path
+Path::fromSVG(const char *begin, const char *end)
 {
     Path path;
+    // "L123 45" is the typical size of a point; saves most regrowing
+    path.reserve((end - begin) / AVERAGE_POINT_SIZE + 1);
 
-    SVGPathParser parser(svgpath);
+    SVGPathParser parser(begin, end);
 
     Vec2 pos;
     while (parser.next(pos)) {
@@ -43,6 +43,7 @@ public:
   Path( const char *ptlist );
 
   static Path fromSVG(const std::string &svgpath);
+  static Path fromSVG(const char *begin, const char *end);
 
   void makeRelative();
   Path& translate(const Vec2& xlate);
@@ -0,0 +1,887 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "RecordingRenderer.h"
+
+#include "thp_format.h"
+
+#include "petals_log.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+
+namespace {
+
+// "NPR1" when read back on a host with the same byte order
+const uint32_t NPR_MAGIC = 0x3152504e;
+
+// Larger than any texture or framebuffer the game creates, so that sizes
+// from a corrupt recording don't turn into huge allocations
+const int MAX_SIZE = 8192;
+
+const char *COMMAND_NAMES[] = {
+    "load_file",
+    "load_pixels",
+    "placeholder",
+    "framebuffer",
+    "begin",
+    "end",
+    "retrieve",
+    "read",
+    "clip",
+    "image",
+    "subimage",
+    "blur",
+    "rewind",
+    "saturation",
+    "rectangle",
+    "path",
+    "tessellate",
+    "mesh",
+    "load_font",
+    "metrics",
+    "text",
+    "clear",
+    "flush",
+    "swap",
+};
+
+static_assert(ARRAY_SIZE(COMMAND_NAMES) == RecordingRenderer::COMMANDS, "One name per command");
+
+void
+putVarint(std::string &out, int value)
+{
+    // zigzag, so that small negative deltas stay small
+    uint32_t v = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    while (v >= 0x80) {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+void
+putFloat(std::string &out, float value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void
+putString(std::string &out, const char *s)
+{
+    size_t len = strlen(s);
+    putVarint(out, len);
+    out.append(s, len);
+}
+
+void
+putRect(std::string &out, const Rect &r)
+{
+    putVarint(out, r.tl.x);
+    putVarint(out, r.tl.y);
+    putVarint(out, r.br.x);
+    putVarint(out, r.br.y);
+}
+
+void
+putPath(std::string &out, const Path &path)
+{
+    // Neighbouring points are close, their deltas mostly take a byte
+    Vec2 last(0, 0);
+    putVarint(out, path.numPoints());
+    for (auto &p: path) {
+        putVarint(out, p.x - last.x);
+        putVarint(out, p.y - last.y);
+        last = p;
+    }
+}
+
+bool
+validSize(int w, int h)
+{
+    return w >= 0 && h >= 0 && w <= MAX_SIZE && h <= MAX_SIZE;
+}
+
+// Reads the arguments of a command, false once the stream ended early
+class Reader {
+public:
+    Reader(const unsigned char *&pos, const unsigned char *end)
+        : m_pos(pos)
+        , m_end(end)
+    {
+    }
+
+    bool varint(int &value)
+    {
+        uint32_t v = 0;
+        for (int shift=0; shift<32; shift+=7) {
+            if (m_pos == m_end) {
+                return false;
+            }
+
+            unsigned char c = *m_pos++;
+            v |= uint32_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) {
+                value = int(v >> 1) ^ -int(v & 1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool real(float &value)
+    {
+        if (size_t(m_end - m_pos) < sizeof(value)) {
+            return false;
+        }
+
+        memcpy(&value, m_pos, sizeof(value));
+        m_pos += sizeof(value);
+        return true;
+    }
+
+    bool bytes(size_t len, const unsigned char *&data)
+    {
+        if (size_t(m_end - m_pos) < len) {
+            return false;
+        }
+
+        data = m_pos;
+        m_pos += len;
+        return true;
+    }
+
+    bool string(std::string &value)
+    {
+        int len;
+        const unsigned char *data;
+        if (!varint(len) || len < 0 || !bytes(len, data)) {
+            return false;
+        }
+
+        value.assign(reinterpret_cast<const char *>(data), len);
+        return true;
+    }
+
+    bool rect(Rect &r)
+    {
+        return varint(r.tl.x) && varint(r.tl.y) && varint(r.br.x) && varint(r.br.y);
+    }
+
+    bool path(Path &path)
+    {
+        int count;
+        // Each point takes at least two bytes
+        if (!varint(count) || count < 0 || count > (m_end - m_pos) / 2) {
+            return false;
+        }
+
+        Vec2 p(0, 0);
+        path.clear();
+        path.reserve(count);
+        for (int i=0; i<count; i++) {
+            int dx, dy;
+            if (!varint(dx) || !varint(dy)) {
+                return false;
+            }
+            p.x += dx;
+            p.y += dy;
+            path.push_back(p);
+        }
+
+        return true;
+    }
+
+private:
+    const unsigned char *&m_pos;
+    const unsigned char *m_end;
+};
+
+}; /* namespace */
+
+
+int
+RecordingRenderer::Histogram::total() const
+{
+    int result = 0;
+    for (int count: counts) {
+        result += count;
+    }
+    return result;
+}
+
+std::string
+RecordingRenderer::Histogram::str() const
+{
+    std::string result;
+    for (int i=0; i<COMMANDS; i++) {
+        if (counts[i]) {
+            result += thp::format("%s%s %d", result.empty() ? "" : ", ", name(i), counts[i]);
+        }
+    }
+    return result;
+}
+
+const char *
+RecordingRenderer::name(int command)
+{
+    return (command >= 0 && command < COMMANDS) ? COMMAND_NAMES[command] : "?";
+}
+
+
+RecordingRenderer::RecordingRenderer(NP::Renderer *target)
+    : NP::Renderer()
+    , m_target(target)
+    , m_commands()
+    , m_ids()
+    , m_objects(0)
+    , m_frames(0)
+    , m_frame()
+    , m_last_frame()
+{
+}
+
+bool
+RecordingRenderer::save(const std::string &filename) const
+{
+    std::string header(reinterpret_cast<const char *>(&NPR_MAGIC), sizeof(NPR_MAGIC));
+    Vec2 world = m_target->world_size();
+    Vec2 framebuffer = m_target->framebuffer_size();
+    putVarint(header, world.x);
+    putVarint(header, world.y);
+    putVarint(header, framebuffer.x);
+    putVarint(header, framebuffer.y);
+
+    FILE *fp = fopen(filename.c_str(), "wb");
+    if (!fp) {
+        LOG_WARNING("Cannot write %s", filename.c_str());
+        return false;
+    }
+
+    bool result = (fwrite(header.data(), 1, header.size(), fp) == header.size() &&
+                   fwrite(m_commands.data(), 1, m_commands.size(), fp) == m_commands.size());
+    if (fclose(fp) != 0) {
+        result = false;
+    }
+
+    return result;
+}
+
+void
+RecordingRenderer::command(Command command)
+{
+    m_commands += char(command);
+    m_frame.counts[command]++;
+}
+
+void
+RecordingRenderer::created(const void *object)
+{
+    // The address of a freed object may come back for a new one
+    m_ids[object] = ++m_objects;
+}
+
+int
+RecordingRenderer::id(const void *object) const
+{
+    auto it = m_ids.find(object);
+    return (it != m_ids.end()) ? it->second : 0;
+}
+
+int
+RecordingRenderer::id(const NP::Texture &texture)
+{
+    int result = id(texture.get());
+    if (!result && texture) {
+        command(PLACEHOLDER);
+        putVarint(m_commands, texture->w);
+        putVarint(m_commands, texture->h);
+        created(texture.get());
+        result = m_objects;
+    }
+    return result;
+}
+
+int
+RecordingRenderer::id(const NP::Framebuffer &framebuffer)
+{
+    int result = id(framebuffer.get());
+    if (!result && framebuffer) {
+        command(FRAMEBUFFER);
+        putVarint(m_commands, framebuffer->w);
+        putVarint(m_commands, framebuffer->h);
+        created(framebuffer.get());
+        result = m_objects;
+    }
+    return result;
+}
+
+Vec2
+RecordingRenderer::framebuffer_size()
+{
+    return m_target->framebuffer_size();
+}
+
+Vec2
+RecordingRenderer::world_size()
+{
+    return m_target->world_size();
+}
+
+NP::Texture
+RecordingRenderer::load(const char *filename, bool cache)
+{
+    command(LOAD_FILE);
+    putString(m_commands, filename);
+    putVarint(m_commands, cache);
+
+    NP::Texture result = m_target->load(filename, cache);
+    created(result.get());
+    return result;
+}
+
+NP::Texture
+RecordingRenderer::load(unsigned char *pixels, int w, int h)
+{
+    command(LOAD_PIXELS);
+    putVarint(m_commands, w);
+    putVarint(m_commands, h);
+    m_commands.append(reinterpret_cast<const char *>(pixels), w * h * 4);
+
+    NP::Texture result = m_target->load(pixels, w, h);
+    created(result.get());
+    return result;
+}
+
+NP::Framebuffer
+RecordingRenderer::framebuffer(Vec2 size)
+{
+    command(FRAMEBUFFER);
+    putVarint(m_commands, size.x);
+    putVarint(m_commands, size.y);
+
+    NP::Framebuffer result = m_target->framebuffer(size);
+    created(result.get());
+    return result;
+}
+
+void
+RecordingRenderer::begin(NP::Framebuffer &rendertarget, Rect world_rect)
+{
+    int fb = id(rendertarget);
+    command(BEGIN);
+    putVarint(m_commands, fb);
+    putRect(m_commands, world_rect);
+
+    m_target->begin(rendertarget, world_rect);
+}
+
+void
+RecordingRenderer::end(NP::Framebuffer &rendertarget)
+{
+    int fb = id(rendertarget);
+    command(END);
+    putVarint(m_commands, fb);
+
+    m_target->end(rendertarget);
+}
+
+NP::Texture
+RecordingRenderer::retrieve(NP::Framebuffer &rendertarget)
+{
+    int fb = id(rendertarget);
+    command(RETRIEVE);
+    putVarint(m_commands, fb);
+
+    NP::Texture result = m_target->retrieve(rendertarget);
+    created(result.get());
+    return result;
+}
+
+void
+RecordingRenderer::read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels)
+{
+    int fb = id(rendertarget);
+    command(READ);
+    putVarint(m_commands, fb);
+    putRect(m_commands, area);
+
+    m_target->read(rendertarget, area, pixels);
+}
+
+Rect
+RecordingRenderer::clip(Rect rect)
+{
+    command(CLIP);
+    putRect(m_commands, rect);
+
+    return m_target->clip(rect);
+}
+
+void
+RecordingRenderer::image(const NP::Texture &texture, int x, int y, int w, int h)
+{
+    int tex = id(texture);
+    command(IMAGE);
+    putVarint(m_commands, tex);
+    putVarint(m_commands, x);
+    putVarint(m_commands, y);
+    putVarint(m_commands, w);
+    putVarint(m_commands, h);
+
+    m_target->image(texture, x, y, w, h);
+}
+
+void
+RecordingRenderer::subimage(const NP::Texture &texture, const Rect &src, const Rect &dst)
+{
+    int tex = id(texture);
+    command(SUBIMAGE);
+    putVarint(m_commands, tex);
+    putRect(m_commands, src);
+    putRect(m_commands, dst);
+
+    m_target->subimage(texture, src, dst);
+}
+
+void
+RecordingRenderer::blur(const NP::Texture &texture, const Rect &src, const Rect &dst, float rx, float ry)
+{
+    int tex = id(texture);
+    command(BLUR);
+    putVarint(m_commands, tex);
+    putRect(m_commands, src);
+    putRect(m_commands, dst);
+    putFloat(m_commands, rx);
+    putFloat(m_commands, ry);
+
+    m_target->blur(texture, src, dst, rx, ry);
+}
+
+void
+RecordingRenderer::rewind(const NP::Texture &texture, const Rect &src, const Rect &dst, float t, float a)
+{
+    int tex = id(texture);
+    command(REWIND);
+    putVarint(m_commands, tex);
+    putRect(m_commands, src);
+    putRect(m_commands, dst);
+    putFloat(m_commands, t);
+    putFloat(m_commands, a);
+
+    m_target->rewind(texture, src, dst, t, a);
+}
+
+void
+RecordingRenderer::saturation(const NP::Texture &texture, const Rect &src, const Rect &dst, float a)
+{
+    int tex = id(texture);
+    command(SATURATION);
+    putVarint(m_commands, tex);
+    putRect(m_commands, src);
+    putRect(m_commands, dst);
+    putFloat(m_commands, a);
+
+    m_target->saturation(texture, src, dst, a);
+}
+
+void
+RecordingRenderer::rectangle(const Rect &r, int rgba, bool fill)
+{
+    command(RECTANGLE);
+    putRect(m_commands, r);
+    putVarint(m_commands, rgba);
+    putVarint(m_commands, fill);
+
+    m_target->rectangle(r, rgba, fill);
+}
+
+void
+RecordingRenderer::path(const Path &p, int rgba)
+{
+    command(PATH);
+    putPath(m_commands, p);
+    putVarint(m_commands, rgba);
+
+    m_target->path(p, rgba);
+}
+
+NP::Mesh
+RecordingRenderer::tessellate(const Path &p)
+{
+    command(TESSELLATE);
+    putPath(m_commands, p);
+
+    NP::Mesh result = m_target->tessellate(p);
+    created(result.get());
+    return result;
+}
+
+void
+RecordingRenderer::mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba)
+{
+    command(MESH);
+    putVarint(m_commands, id(mesh.get()));
+    putFloat(m_commands, x);
+    putFloat(m_commands, y);
+    putFloat(m_commands, angle);
+    putVarint(m_commands, rgba);
+
+    m_target->mesh(mesh, x, y, angle, rgba);
+}
+
+NP::Font
+RecordingRenderer::load(const char *filename, int size)
+{
+    command(LOAD_FONT);
+    putString(m_commands, filename);
+    putVarint(m_commands, size);
+
+    NP::Font result = m_target->load(filename, size);
+    created(result.get());
+    return result;
+}
+
+void
+RecordingRenderer::metrics(const NP::Font &font, const char *text, int *width, int *height)
+{
+    command(METRICS);
+    putVarint(m_commands, id(font.get()));
+    putString(m_commands, text);
+
+    m_target->metrics(font, text, width, height);
+}
+
+void
+RecordingRenderer::text(const NP::Font &font, const char *text, int x, int y, int rgb)
+{
+    command(TEXT);
+    putVarint(m_commands, id(font.get()));
+    putString(m_commands, text);
+    putVarint(m_commands, x);
+    putVarint(m_commands, y);
+    putVarint(m_commands, rgb);
+
+    m_target->text(font, text, x, y, rgb);
+}
+
+void
+RecordingRenderer::clear()
+{
+    command(CLEAR);
+    m_target->clear();
+}
+
+void
+RecordingRenderer::flush()
+{
+    command(FLUSH);
+    m_target->flush();
+}
+
+void
+RecordingRenderer::swap()
+{
+    command(SWAP);
+    m_target->swap();
+
+    m_frames++;
+    m_last_frame = m_frame;
+    m_frame = Histogram();
+}
+
+
+bool
+RenderReplay::load(const std::string &filename, std::string &commands,
+                   Vec2 &world_size, Vec2 &framebuffer_size)
+{
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (!fp) {
+        LOG_WARNING("Cannot open %s", filename.c_str());
+        return false;
+    }
+
+    std::string data;
+    char buffer[64 * 1024];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        data.append(buffer, len);
+    }
+    fclose(fp);
+
+    uint32_t magic = 0;
+    if (data.size() >= sizeof(magic)) {
+        memcpy(&magic, data.data(), sizeof(magic));
+    }
+
+    const unsigned char *pos = reinterpret_cast<const unsigned char *>(data.data()) + sizeof(magic);
+    const unsigned char *end = reinterpret_cast<const unsigned char *>(data.data()) + data.size();
+    Reader reader(pos, end);
+    if (magic != NPR_MAGIC ||
+            !reader.varint(world_size.x) || !reader.varint(world_size.y) ||
+            !reader.varint(framebuffer_size.x) || !reader.varint(framebuffer_size.y)) {
+        LOG_WARNING("Not a render recording: %s", filename.c_str());
+        return false;
+    }
+
+    commands.assign(reinterpret_cast<const char *>(pos), end - pos);
+    return true;
+}
+
+RenderReplay::RenderReplay(const std::string &commands, NP::Renderer *renderer)
+    : m_commands(commands)
+    , m_renderer(renderer)
+    , m_pos(reinterpret_cast<const unsigned char *>(commands.data()))
+    , m_end(m_pos + commands.size())
+    , m_objects(1) // Object 0 stands in for the unknown ones
+    , m_scratch()
+    , m_failed(false)
+{
+}
+
+RenderReplay::Object &
+RenderReplay::object(int id)
+{
+    if (id < 0 || size_t(id) >= m_objects.size()) {
+        m_failed = true;
+        return m_objects[0];
+    }
+
+    return m_objects[id];
+}
+
+bool
+RenderReplay::frame(RecordingRenderer::Histogram &histogram)
+{
+    if (m_failed || m_pos == m_end) {
+        return false;
+    }
+
+    RecordingRenderer::Command command;
+    do {
+        if (!step(command)) {
+            LOG_WARNING("Corrupt render recording at offset %d",
+                        int(m_pos - reinterpret_cast<const unsigned char *>(m_commands.data())));
+            m_failed = true;
+            return false;
+        }
+        histogram.counts[command]++;
+    } while (command != RecordingRenderer::SWAP && m_pos != m_end);
+
+    return true;
+}
+
+bool
+RenderReplay::step(RecordingRenderer::Command &command)
+{
+    typedef RecordingRenderer R;
+
+    command = R::Command(*m_pos++);
+    Reader r(m_pos, m_end);
+
+    int id, x, y, w, h, rgba;
+    float f1, f2, f3;
+    Rect src, dst;
+    std::string s;
+    Path path;
+    const unsigned char *data;
+
+    switch (command) {
+        case R::LOAD_FILE:
+            if (!r.string(s) || !r.varint(x)) {
+                return false;
+            }
+            m_objects.push_back(Object());
+            m_objects.back().texture = m_renderer->load(s.c_str(), x != 0);
+            break;
+        case R::LOAD_PIXELS:
+            if (!r.varint(w) || !r.varint(h) || !validSize(w, h) || !r.bytes(size_t(w) * h * 4, data)) {
+                return false;
+            }
+            m_scratch.assign(data, data + size_t(w) * h * 4);
+            m_objects.push_back(Object());
+            m_objects.back().texture = m_renderer->load(m_scratch.data(), w, h);
+            break;
+        case R::PLACEHOLDER:
+            if (!r.varint(w) || !r.varint(h) || !validSize(w, h)) {
+                return false;
+            }
+            m_scratch.assign(size_t(w) * h * 4, 0);
+            m_objects.push_back(Object());
+            m_objects.back().texture = m_renderer->load(m_scratch.data(), w, h);
+            break;
+        case R::FRAMEBUFFER:
+            if (!r.varint(w) || !r.varint(h) || !validSize(w, h)) {
+                return false;
+            }
+            m_objects.push_back(Object());
+            m_objects.back().framebuffer = m_renderer->framebuffer(Vec2(w, h));
+            break;
+        case R::BEGIN:
+            if (!r.varint(id) || !r.rect(dst)) {
+                return false;
+            }
+            if (NP::Framebuffer &fb = object(id).framebuffer) {
+                m_renderer->begin(fb, dst);
+            }
+            break;
+        case R::END:
+            if (!r.varint(id)) {
+                return false;
+            }
+            if (NP::Framebuffer &fb = object(id).framebuffer) {
+                m_renderer->end(fb);
+            }
+            break;
+        case R::RETRIEVE:
+            if (!r.varint(id)) {
+                return false;
+            }
+            {
+                NP::Texture texture;
+                if (NP::Framebuffer &fb = object(id).framebuffer) {
+                    texture = m_renderer->retrieve(fb);
+                }
+                m_objects.push_back(Object());
+                m_objects.back().texture = texture;
+            }
+            break;
+        case R::READ:
+            if (!r.varint(id) || !r.rect(src)) {
+                return false;
+            }
+            if (NP::Framebuffer &fb = object(id).framebuffer) {
+                if (src.tl.x < 0 || src.tl.y < 0 || src.br.x > fb->w || src.br.y > fb->h ||
+                        src.w() < 0 || src.h() < 0) {
+                    return false;
+                }
+                m_scratch.resize(size_t(src.w()) * src.h() * 4);
+                m_renderer->read(fb, src, m_scratch.data());
+            }
+            break;
+        case R::CLIP:
+            if (!r.rect(dst)) {
+                return false;
+            }
+            m_renderer->clip(dst);
+            break;
+        case R::IMAGE:
+            if (!r.varint(id) || !r.varint(x) || !r.varint(y) || !r.varint(w) || !r.varint(h)) {
+                return false;
+            }
+            if (const NP::Texture &texture = object(id).texture) {
+                m_renderer->image(texture, x, y, w, h);
+            }
+            break;
+        case R::SUBIMAGE:
+            if (!r.varint(id) || !r.rect(src) || !r.rect(dst)) {
+                return false;
+            }
+            if (const NP::Texture &texture = object(id).texture) {
+                m_renderer->subimage(texture, src, dst);
+            }
+            break;
+        case R::BLUR:
+            if (!r.varint(id) || !r.rect(src) || !r.rect(dst) || !r.real(f1) || !r.real(f2)) {
+                return false;
+            }
+            if (const NP::Texture &texture = object(id).texture) {
+                m_renderer->blur(texture, src, dst, f1, f2);
+            }
+            break;
+        case R::REWIND:
+            if (!r.varint(id) || !r.rect(src) || !r.rect(dst) || !r.real(f1) || !r.real(f2)) {
+                return false;
+            }
+            if (const NP::Texture &texture = object(id).texture) {
+                m_renderer->rewind(texture, src, dst, f1, f2);
+            }
+            break;
+        case R::SATURATION:
+            if (!r.varint(id) || !r.rect(src) || !r.rect(dst) || !r.real(f1)) {
+                return false;
+            }
+            if (const NP::Texture &texture = object(id).texture) {
+                m_renderer->saturation(texture, src, dst, f1);
+            }
+            break;
+        case R::RECTANGLE:
+            if (!r.rect(dst) || !r.varint(rgba) || !r.varint(x)) {
+                return false;
+            }
+            m_renderer->rectangle(dst, rgba, x != 0);
+            break;
+        case R::PATH:
+            if (!r.path(path) || !r.varint(rgba)) {
+                return false;
+            }
+            m_renderer->path(path, rgba);
+            break;
+        case R::TESSELLATE:
+            if (!r.path(path)) {
+                return false;
+            }
+            m_objects.push_back(Object());
+            m_objects.back().mesh = m_renderer->tessellate(path);
+            break;
+        case R::MESH:
+            if (!r.varint(id) || !r.real(f1) || !r.real(f2) || !r.real(f3) || !r.varint(rgba)) {
+                return false;
+            }
+            if (const NP::Mesh &mesh = object(id).mesh) {
+                m_renderer->mesh(mesh, f1, f2, f3, rgba);
+            }
+            break;
+        case R::LOAD_FONT:
+            if (!r.string(s) || !r.varint(x)) {
+                return false;
+            }
+            m_objects.push_back(Object());
+            m_objects.back().font = m_renderer->load(s.c_str(), x);
+            break;
+        case R::METRICS:
+            if (!r.varint(id) || !r.string(s)) {
+                return false;
+            }
+            if (const NP::Font &font = object(id).font) {
+                m_renderer->metrics(font, s.c_str(), &w, &h);
+            }
+            break;
+        case R::TEXT:
+            if (!r.varint(id) || !r.string(s) || !r.varint(x) || !r.varint(y) || !r.varint(rgba)) {
+                return false;
+            }
+            if (const NP::Font &font = object(id).font) {
+                m_renderer->text(font, s.c_str(), x, y, rgba);
+            }
+            break;
+        case R::CLEAR:
+            m_renderer->clear();
+            break;
+        case R::FLUSH:
+            m_renderer->flush();
+            break;
+        case R::SWAP:
+            m_renderer->swap();
+            break;
+        default:
+            return false;
+    }
+
+    return !m_failed;
+}
@@ -0,0 +1,187 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_RECORDINGRENDERER_H
+#define NUMPTYPHYSICS_RECORDINGRENDERER_H
+
+#include "Renderer.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+/**
+ * Renderer that passes every call on to another renderer and records it
+ *
+ * The calls and their arguments go into a command stream (an opcode
+ * byte followed by zigzag varints, floats and strings, paths as point
+ * deltas) that RenderReplay runs again against any renderer, so frames
+ * captured in a real session can be used to benchmark or compare
+ * renderer changes offline. Commands are counted per frame as well.
+ *
+ * Textures, framebuffers, meshes and fonts are numbered in the order
+ * they were created in; the recorder doesn't keep them alive. Objects
+ * that were created before recording started are recreated from their
+ * size on first use (textures as blank placeholders), calls on unknown
+ * meshes and fonts are recorded but do nothing in the replay.
+ **/
+class RecordingRenderer : public NP::Renderer {
+public:
+    enum Command {
+        LOAD_FILE,
+        LOAD_PIXELS,
+        PLACEHOLDER,
+        FRAMEBUFFER,
+        BEGIN,
+        END,
+        RETRIEVE,
+        READ,
+        CLIP,
+        IMAGE,
+        SUBIMAGE,
+        BLUR,
+        REWIND,
+        SATURATION,
+        RECTANGLE,
+        PATH,
+        TESSELLATE,
+        MESH,
+        LOAD_FONT,
+        METRICS,
+        TEXT,
+        CLEAR,
+        FLUSH,
+        SWAP,
+
+        COMMANDS
+    };
+
+    struct Histogram {
+        Histogram() : counts() {}
+
+        int total() const;
+        // "path 120, rectangle 3, ..." for the commands that were used
+        std::string str() const;
+
+        int counts[COMMANDS];
+    };
+
+    static const char *name(int command);
+
+    RecordingRenderer(NP::Renderer *target);
+
+    // Header with the sizes of the target, then commands()
+    bool save(const std::string &filename) const;
+
+    const std::string &commands() const { return m_commands; }
+    int frames() const { return m_frames; }
+    // Commands of the last frame that was presented with swap()
+    const Histogram &lastFrame() const { return m_last_frame; }
+
+    virtual Vec2 framebuffer_size();
+    virtual Vec2 world_size();
+
+    virtual NP::Texture load(const char *filename, bool cache);
+    virtual NP::Texture load(unsigned char *pixels, int w, int h);
+
+    virtual NP::Framebuffer framebuffer(Vec2 size);
+    virtual void begin(NP::Framebuffer &rendertarget, Rect world_rect);
+    virtual void end(NP::Framebuffer &rendertarget);
+    virtual NP::Texture retrieve(NP::Framebuffer &rendertarget);
+    virtual void read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels);
+
+    virtual Rect clip(Rect rect);
+
+    virtual void image(const NP::Texture &texture, int x, int y, int w, int h);
+    virtual void subimage(const NP::Texture &texture, const Rect &src, const Rect &dst);
+    virtual void blur(const NP::Texture &texture, const Rect &src, const Rect &dst, float rx, float ry);
+    virtual void rewind(const NP::Texture &texture, const Rect &src, const Rect &dst, float t, float a);
+    virtual void saturation(const NP::Texture &texture, const Rect &src, const Rect &dst, float a);
+    virtual void rectangle(const Rect &r, int rgba, bool fill);
+    virtual void path(const Path &p, int rgba);
+    virtual NP::Mesh tessellate(const Path &p);
+    virtual void mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba);
+
+    virtual NP::Font load(const char *filename, int size);
+
+    virtual void metrics(const NP::Font &font, const char *text, int *width, int *height);
+    virtual void text(const NP::Font &font, const char *text, int x, int y, int rgb);
+
+    virtual void clear();
+    virtual void flush();
+    virtual void swap();
+
+private:
+    void command(Command command);
+    // Numbers a newly created object
+    void created(const void *object);
+    // Number of an object, 0 if it is unknown
+    int id(const void *object) const;
+    int id(const NP::Texture &texture);
+    int id(const NP::Framebuffer &framebuffer);
+
+    NP::Renderer *m_target;
+    std::string m_commands;
+    std::unordered_map<const void *, int> m_ids;
+    int m_objects;
+    int m_frames;
+    Histogram m_frame;
+    Histogram m_last_frame;
+};
+
+/**
+ * Runs the commands of a RecordingRenderer against renderer, one frame
+ * at a time
+ *
+ * Everything the commands create stays alive until the replay is
+ * destroyed, the calls that return something (retrieve(), read() and
+ * metrics()) are made and their results dropped.
+ **/
+class RenderReplay {
+public:
+    // File written by RecordingRenderer::save()
+    static bool load(const std::string &filename, std::string &commands,
+                     Vec2 &world_size, Vec2 &framebuffer_size);
+
+    RenderReplay(const std::string &commands, NP::Renderer *renderer);
+
+    // Runs the commands up to and including the next swap(), counting
+    // them into histogram; false at the end of the stream or if it is
+    // corrupt (see failed())
+    bool frame(RecordingRenderer::Histogram &histogram);
+    bool failed() const { return m_failed; }
+
+private:
+    struct Object {
+        NP::Texture texture;
+        NP::Framebuffer framebuffer;
+        NP::Mesh mesh;
+        NP::Font font;
+    };
+
+    bool step(RecordingRenderer::Command &command);
+    Object &object(int id);
+
+    const std::string &m_commands;
+    NP::Renderer *m_renderer;
+    const unsigned char *m_pos;
+    const unsigned char *m_end;
+    std::vector<Object> m_objects;
+    std::vector<unsigned char> m_scratch;
+    bool m_failed;
+};
+
+#endif /* NUMPTYPHYSICS_RECORDINGRENDERER_H */
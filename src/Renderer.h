@@ -17,6 +17,8 @@
 #define NUMPTYPHYSICS_RENDERER_H
 
 #include <memory>
+#include <unordered_map>
+#include <cstdint>
 
 #include "Common.h"
 #include "Path.h"
@@ -55,6 +57,152 @@ public:
 
 typedef std::shared_ptr<FramebufferData> Framebuffer;
 
+class MeshData {
+public:
+    virtual ~MeshData() {}
+};
+
+typedef std::shared_ptr<MeshData> Mesh;
+
+// Outline of path() and mesh(), shared so that all renderers draw the
+// same edge profile. Each segment becomes ten vertices of one triangle
+// strip: a solid core with a feathered edge on either side, joined to the
+// next segment by zero area triangles. vertex(pos, coverage) gets them in
+// order.
+template <typename F>
+void
+outline(const Path &path, F vertex)
+{
+    const float w = 0.9;
+    const float e = 1.0;
+
+    int segments = path.numPoints() - 1;
+    for (int i=0; i<segments; i++) {
+        b2Vec2 aa = (i > 0) ? path[i-1] : path[i];
+        b2Vec2 a = path[i];
+        b2Vec2 b = path[i+1];
+        b2Vec2 bb = (i < segments - 1) ? path[i+2] : path[i+1];
+
+        b2Vec2 a_to_b = 0.5 * (b - a) + 0.5 * (a - aa);
+        a_to_b.Normalize();
+        b2Vec2 a_to_b_90(-a_to_b.y, a_to_b.x);
+
+        b2Vec2 b_to_a = 0.5 * (bb - b) + 0.5 * (b - a);
+        b_to_a.Normalize();
+        b2Vec2 b_to_a_90(-b_to_a.y, b_to_a.x);
+
+        vertex(a + a_to_b_90 * (w + e), 0.f);
+
+        vertex(a + a_to_b_90 * (w + e), 0.f);
+        vertex(b + b_to_a_90 * (w + e), 0.f);
+        vertex(a + a_to_b_90 * w, 1.f);
+        vertex(b + b_to_a_90 * w, 1.f);
+
+        vertex(a - a_to_b_90 * w, 1.f);
+        vertex(b - b_to_a_90 * w, 1.f);
+        vertex(a - a_to_b_90 * (w + e), 0.f);
+        vertex(b - b_to_a_90 * (w + e), 0.f);
+
+        vertex(b - b_to_a_90 * (w + e), 0.f);
+    }
+}
+
+// Next code point of UTF-8 text, 0 at the end; malformed bytes are skipped
+inline unsigned int
+nextCodepoint(const char *&text)
+{
+    while (*text) {
+        unsigned char c = *text++;
+        int length = (c < 0x80) ? 0 : (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : -1;
+        if (length < 0) {
+            continue;
+        }
+
+        unsigned int codepoint = length ? (c & (0x3f >> length)) : c;
+        while (length > 0 && (*text & 0xc0) == 0x80) {
+            codepoint = (codepoint << 6) | (*text++ & 0x3f);
+            length--;
+        }
+
+        if (length == 0) {
+            return codepoint;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Glyphs and kerning pairs of a font, for renderers that draw text one
+ * glyph texture at a time
+ *
+ * Each glyph is created once, when it is first used, and advances and
+ * kerning pairs are remembered, so laying out text is a table lookup
+ * once the glyphs have been seen.
+ **/
+class GlyphCache {
+public:
+    struct Glyph {
+        Glyph() : texture(), x(0), y(0), advance(0) {}
+
+        // Empty for glyphs without pixels (e.g. spaces)
+        Texture texture;
+        // Offset from the pen position at the top of the line
+        int x, y;
+        int advance;
+    };
+
+    GlyphCache() : m_glyphs(), m_kernings() {}
+    virtual ~GlyphCache() {}
+
+    virtual int lineHeight() = 0;
+    virtual int kerning(unsigned int left, unsigned int right) = 0;
+
+    // Calls draw(glyph, x) for each code point of UTF-8 text, x being the
+    // pen position relative to the start of the line, and returns the
+    // width of the text; create(codepoint, glyph) fills in new glyphs
+    template <typename C, typename D>
+    int layout(const char *text, C create, D draw)
+    {
+        int x = 0;
+        unsigned int previous = 0;
+        while (unsigned int codepoint = nextCodepoint(text)) {
+            if (previous) {
+                x += cachedKerning(previous, codepoint);
+            }
+
+            auto it = m_glyphs.find(codepoint);
+            if (it == m_glyphs.end()) {
+                it = m_glyphs.emplace(codepoint, Glyph()).first;
+                create(codepoint, it->second);
+            }
+
+            draw(it->second, x);
+            x += it->second.advance;
+            previous = codepoint;
+        }
+
+        return x;
+    }
+
+private:
+    int cachedKerning(unsigned int left, unsigned int right)
+    {
+        uint64_t pair = (uint64_t(left) << 32) | right;
+        auto it = m_kernings.find(pair);
+        if (it != m_kernings.end()) {
+            return it->second;
+        }
+
+        int result = kerning(left, right);
+        m_kernings[pair] = result;
+        return result;
+    }
+
+    std::unordered_map<unsigned int, Glyph> m_glyphs;
+    std::unordered_map<uint64_t, int> m_kernings;
+};
+
 class Renderer {
 public:
     virtual ~Renderer() {}
@@ -66,11 +214,16 @@ public:
     Rect world_rect() { return Rect(Vec2(0, 0), world_size()); }
 
     virtual Texture load(const char *filename, bool cache) = 0;
+    // RGBA, w * h * 4 bytes
+    virtual Texture load(unsigned char *pixels, int w, int h) = 0;
 
     virtual Framebuffer framebuffer(Vec2 size) = 0;
     virtual void begin(Framebuffer &rendertarget, Rect world_rect) = 0;
     virtual void end(Framebuffer &rendertarget) = 0;
     virtual Texture retrieve(Framebuffer &rendertarget) = 0;
+    // RGBA pixels of area (framebuffer coordinates), rows in the same
+    // order as load() expects them
+    virtual void read(Framebuffer &rendertarget, const Rect &area, unsigned char *pixels) = 0;
 
     virtual Rect clip(Rect rect) = 0;
 
@@ -81,11 +234,16 @@ public:
     virtual void saturation(const Texture &texture, const Rect &src, const Rect &dst, float a) = 0;
     virtual void rectangle(const Rect &rect, int rgba, bool fill) = 0;
     virtual void path(const Path &path, int rgba) = 0;
+    // Same outline as path(), kept on the GPU; mesh() draws it rotated by
+    // angle (radians) around the origin of path and moved to x, y
+    virtual Mesh tessellate(const Path &path) = 0;
+    virtual void mesh(const Mesh &mesh, float x, float y, float angle, int rgba) = 0;
 
     virtual Font load(const char *filename, int size) = 0;
 
     virtual void metrics(const Font &font, const char *text, int *width, int *height) = 0;
-    virtual Texture text(const Font &font, const char *text, int rgb) = 0;
+    // UTF-8 text with the top left corner of the line at x, y
+    virtual void text(const Font &font, const char *text, int x, int y, int rgb) = 0;
 
     virtual void clear() = 0;
     virtual void flush() = 0;
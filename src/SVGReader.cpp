@@ -0,0 +1,315 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "SVGReader.h"
+
+#include "petals_log.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+
+namespace {
+
+const struct {
+    const char *name;
+    char value;
+} ENTITIES[] = {
+    { "amp", '&' },
+    { "lt", '<' },
+    { "gt", '>' },
+    { "quot", '"' },
+    { "apos", '\'' },
+};
+
+bool
+isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool
+isNameEnd(char c)
+{
+    return isSpace(c) || c == '=' || c == '/' || c == '>';
+}
+
+const char *
+skipSpace(const char *pos, const char *end)
+{
+    while (pos < end && isSpace(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+
+// Position right after the next occurrence of token, or nullptr
+const char *
+skipPast(const char *pos, const char *end, const char *token)
+{
+    size_t len = strlen(token);
+    const char *found = std::search(pos, end, token, token + len);
+    return (found == end) ? nullptr : found + len;
+}
+
+void
+appendUtf8(std::string &out, unsigned long cp)
+{
+    if (cp < 0x80) {
+        out += char(cp);
+    } else if (cp < 0x800) {
+        out += char(0xc0 | (cp >> 6));
+        out += char(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += char(0xe0 | (cp >> 12));
+        out += char(0x80 | ((cp >> 6) & 0x3f));
+        out += char(0x80 | (cp & 0x3f));
+    } else {
+        out += char(0xf0 | (cp >> 18));
+        out += char(0x80 | ((cp >> 12) & 0x3f));
+        out += char(0x80 | ((cp >> 6) & 0x3f));
+        out += char(0x80 | (cp & 0x3f));
+    }
+}
+
+// Copies a short range into a NUL-terminated stack buffer for the C parsers
+class NumberBuffer {
+public:
+    NumberBuffer(const SVGReader::Range &range)
+    {
+        size_t len = std::min(range.size(), sizeof(m_buffer) - 1);
+        memcpy(m_buffer, range.begin, len);
+        m_buffer[len] = '\0';
+    }
+
+    const char *c_str() const { return m_buffer; }
+
+private:
+    char m_buffer[32];
+};
+
+}; /* namespace */
+
+
+bool
+SVGReader::Range::operator==(const char *s) const
+{
+    size_t len = strlen(s);
+    return size() == len && memcmp(begin, s, len) == 0;
+}
+
+std::string
+SVGReader::Range::str() const
+{
+    const char *amp = std::find(begin, end, '&');
+    if (amp == end) {
+        return std::string(begin, end);
+    }
+
+    std::string result(begin, amp);
+    const char *pos = amp;
+    while (pos < end) {
+        if (*pos != '&') {
+            result += *pos++;
+            continue;
+        }
+
+        const char *semicolon = std::find(pos, end, ';');
+        if (semicolon == end) {
+            result.append(pos, end);
+            break;
+        }
+
+        Range entity(pos + 1, semicolon);
+        bool known = false;
+        if (entity.size() > 1 && *entity.begin == '#') {
+            NumberBuffer digits(Range(entity.begin + 1, entity.end));
+            const char *num = digits.c_str();
+            bool hex = (*num == 'x' || *num == 'X');
+            char *numEnd = nullptr;
+            unsigned long cp = strtoul(hex ? num + 1 : num, &numEnd, hex ? 16 : 10);
+            if (numEnd && *numEnd == '\0' && cp > 0 && cp < 0x110000) {
+                appendUtf8(result, cp);
+                known = true;
+            }
+        } else {
+            for (auto &e: ENTITIES) {
+                if (entity == e.name) {
+                    result += e.value;
+                    known = true;
+                    break;
+                }
+            }
+        }
+
+        if (known) {
+            pos = semicolon + 1;
+        } else {
+            result += *pos++;
+        }
+    }
+
+    return result;
+}
+
+int
+SVGReader::Range::toInt() const
+{
+    return atoi(NumberBuffer(*this).c_str());
+}
+
+float
+SVGReader::Range::toFloat() const
+{
+    return strtof(NumberBuffer(*this).c_str(), nullptr);
+}
+
+
+SVGReader::SVGReader(const char *data, size_t size)
+    : m_data(data)
+    , m_end(data + size)
+    , m_attributes()
+    , m_count(0)
+{
+}
+
+const SVGReader::Range *
+SVGReader::attribute(const char *name) const
+{
+    for (int i=0; i<m_count; i++) {
+        if (m_attributes[i].name == name) {
+            return &m_attributes[i].value;
+        }
+    }
+
+    return nullptr;
+}
+
+bool
+SVGReader::parseTag(const char *&pos, Range &name)
+{
+    const char *start = pos;
+    while (pos < m_end && !isNameEnd(*pos)) {
+        pos++;
+    }
+    name = Range(start, pos);
+
+    m_count = 0;
+    while (true) {
+        pos = skipSpace(pos, m_end);
+        if (pos == m_end) {
+            return false;
+        }
+
+        if (*pos == '>') {
+            pos++;
+            return name.size() > 0;
+        } else if (*pos == '/') {
+            pos++;
+            if (pos == m_end || *pos != '>') {
+                return false;
+            }
+            pos++;
+            return name.size() > 0;
+        }
+
+        start = pos;
+        while (pos < m_end && !isNameEnd(*pos)) {
+            pos++;
+        }
+        Range attrName(start, pos);
+
+        pos = skipSpace(pos, m_end);
+        if (attrName.size() == 0 || pos == m_end || *pos != '=') {
+            return false;
+        }
+        pos = skipSpace(pos + 1, m_end);
+        if (pos == m_end || (*pos != '"' && *pos != '\'')) {
+            return false;
+        }
+
+        char quote = *pos++;
+        const char *valueEnd = std::find(pos, m_end, quote);
+        if (valueEnd == m_end) {
+            return false;
+        }
+
+        if (m_count < MAX_ATTRIBUTES) {
+            m_attributes[m_count].name = attrName;
+            m_attributes[m_count].value = Range(pos, valueEnd);
+            m_count++;
+        } else {
+            LOG_WARNING("Too many attributes in <%.*s>", int(name.size()), name.begin);
+        }
+
+        pos = valueEnd + 1;
+    }
+}
+
+bool
+SVGReader::parse(Handler &handler)
+{
+    const char *pos = m_data;
+
+    while (pos < m_end) {
+        pos = std::find(pos, m_end, '<');
+        if (pos == m_end) {
+            break;
+        }
+        pos++;
+        if (pos == m_end) {
+            LOG_WARNING("Unexpected end of document");
+            return false;
+        }
+
+        const char *next = nullptr;
+        switch (*pos) {
+            case '!':
+                if (m_end - pos >= 3 && memcmp(pos, "!--", 3) == 0) {
+                    next = skipPast(pos + 3, m_end, "-->");
+                } else if (m_end - pos >= 8 && memcmp(pos, "![CDATA[", 8) == 0) {
+                    next = skipPast(pos + 8, m_end, "]]>");
+                } else {
+                    next = skipPast(pos, m_end, ">");
+                }
+                break;
+            case '?':
+                next = skipPast(pos, m_end, "?>");
+                break;
+            case '/':
+                next = skipPast(pos, m_end, ">");
+                break;
+            default:
+                {
+                    Range name;
+                    if (parseTag(pos, name)) {
+                        handler.element(name, *this);
+                        next = pos;
+                    }
+                    m_count = 0;
+                }
+                break;
+        }
+
+        if (!next) {
+            LOG_WARNING("Malformed markup at offset %d", int(pos - m_data));
+            return false;
+        }
+        pos = next;
+    }
+
+    return true;
+}
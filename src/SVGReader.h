@@ -0,0 +1,78 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_SVGREADER_H
+#define NUMPTYPHYSICS_SVGREADER_H
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * Single pass reader for the XML subset used by .npsvg levels
+ *
+ * Start tags are reported to a Handler as they are found, with their
+ * name and attributes given as ranges into the input buffer. There is no
+ * document tree and nothing is copied unless the handler asks for it
+ * (Range::str() also resolves entities). End tags, text, comments,
+ * CDATA sections, processing instructions and doctypes are skipped.
+ **/
+class SVGReader {
+public:
+    struct Range {
+        Range() : begin(nullptr), end(nullptr) {}
+        Range(const char *begin, const char *end) : begin(begin), end(end) {}
+
+        size_t size() const { return end - begin; }
+        bool operator==(const char *s) const;
+
+        std::string str() const;
+        int toInt() const;
+        float toFloat() const;
+
+        const char *begin;
+        const char *end;
+    };
+
+    class Handler {
+    public:
+        virtual ~Handler() {}
+        virtual void element(const Range &name, const SVGReader &reader) = 0;
+    };
+
+    SVGReader(const char *data, size_t size);
+
+    bool parse(Handler &handler);
+
+    // Attribute of the element currently being reported, or nullptr
+    const Range *attribute(const char *name) const;
+
+private:
+    enum { MAX_ATTRIBUTES = 16 };
+
+    struct Attribute {
+        Range name;
+        Range value;
+    };
+
+    bool parseTag(const char *&pos, Range &name);
+
+    const char *m_data;
+    const char *m_end;
+    Attribute m_attributes[MAX_ATTRIBUTES];
+    int m_count;
+};
+
+#endif /* NUMPTYPHYSICS_SVGREADER_H */
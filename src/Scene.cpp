@@ -19,16 +19,18 @@
 #include "Accelerometer.h"
 #include "Colour.h"
 #include "Stroke.h"
+#include "BinaryLevel.h"
+#include "Assets.h"
+#include "SVGReader.h"
+#include "FileWriter.h"
 
-#include "tinyxml2.h"
-#include "thp_format.h"
-#include "thp_iterutils.h"
 #include "petals_log.h"
 
 #include <vector>
 #include <list>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 
 static constexpr const char *JOINT_IND_PATH =
@@ -54,22 +56,43 @@ struct JointInd {
 
 static JointInd jointInd;
 
+// Steps for a stroke to fade in during the level intro
+static const int STROKE_FADE_STEPS = 50;
+
 
 Scene::Scene( bool noWorld )
-  : m_world( NULL ),
+  : m_arena(),
+    m_world( NULL ),
     m_protect( 0 ),
     m_gravity(0.0f, 0.0f),
     m_dynamicGravity(false),
+    m_customGravity(false),
     m_accelerometer(Os::get()->getAccelerometer()),
     m_step(0)
   , m_ticks(0)
+  , m_changes(0)
   , m_color_rects()
   , m_interactions()
+  , m_loadStart(0)
+  , m_loadMallocs(0)
+  , m_lastGroup(0)
+  , m_contactSteps(0)
+  , m_contactTotal(0)
+  , m_contactReports(0)
+  , m_toiEvents(0)
+  , m_toiComputations(0)
+  , m_toiCappedSteps(0)
+  , m_toiMicroseconds(0)
   , m_createStroke(nullptr)
   , m_createJetStream(nullptr)
   , m_moveStroke(nullptr)
   , m_moveOffset()
   , m_paused(false)
+  , m_staticLayer(nullptr)
+  , m_staticImage(nullptr)
+  , m_staticStrokes()
+  , m_staticScratch()
+  , m_staticDirty(true)
 {
   if ( !noWorld ) {
     resetWorld();
@@ -80,15 +103,15 @@ Scene::~Scene()
 {
   clear();
   m_interactions.clear();
-  if ( m_world ) {
-    delete m_world;
-  }
+  delete m_staticImage;
+  delete m_staticLayer;
 }
 
 bool
 Scene::onSceneEvent(const SceneEvent &ev)
 {
     m_recorder.onSceneEvent(ev);
+    m_changes++;
 
     //LOG_INFO("Got scene event: %s", ev.repr().c_str());
 
@@ -220,19 +243,34 @@ Scene::onSceneEvent(const SceneEvent &ev)
 void Scene::resetWorld()
 {
   const b2Vec2 gravity(0.0f, GRAVITY_ACCELf*PIXELS_PER_METREf/GRAVITY_FUDGEf);
-  delete m_world;
+  destroyWorld();
 
   b2AABB worldAABB;
   worldAABB.lowerBound.Set(-100.0f, -100.0f);
   worldAABB.upperBound.Set(100.0f, 100.0f);
     
   bool doSleep = true;
-  m_world = new b2World(worldAABB, gravity, doSleep);
+  void *mem = m_arena.allocate(sizeof(b2World));
+  m_world = new (mem) b2World(worldAABB, gravity, doSleep, &m_arena);
   m_world->SetContactListener( this );
+  m_world->SetContactFilter( this );
+  m_world->SetMaxTOIEvents( MAX_TOI_EVENTS );
+}
+
+void Scene::destroyWorld()
+{
+  // Bodies, shapes, joints and contacts all live in the arena, so they
+  // are not destroyed one by one - the arena is simply rewound. Strokes
+  // are in there too, so they must have been destructed by now.
+  if ( m_world ) {
+    m_world->~b2World();
+    m_world = NULL;
+  }
+  m_arena.reset();
 }
 
 Stroke* Scene::newStroke( const Path& p, int colour, int attribs ) {
-  Stroke *s = new Stroke(p);
+  Stroke *s = new (m_arena) Stroke(p);
   s->setAttribute( (Attribute)attribs );
 
   switch ( colour ) {
@@ -333,12 +371,37 @@ void Scene::createJoints( Stroke *s )
       m_strokes[j]->determineJoints( s, joints );
       for ( int i=0; i<joints.size(); i++ ) {
 	joints[i].joiner->join( m_world, joints[i].joinee, joints[i].end );
+	joinRopes( joints[i].joiner, joints[i].joinee );
       }
       joints.clear();
     }
   }    
 }
 
+void Scene::joinRopes( Stroke *a, Stroke *b )
+{
+  // Segments of one rope share a negative collision group, so that they
+  // do not keep fighting the revolute joints where the rope folds over
+  if ( !a->hasAttribute(ATTRIB_ROPE) || !b->hasAttribute(ATTRIB_ROPE) ) {
+    return;
+  }
+
+  int16 group = b->collisionGroup() ? b->collisionGroup() : a->collisionGroup();
+  if ( group == 0 ) {
+    group = --m_lastGroup;
+  }
+
+  // a may already be part of another rope - merge both into one group
+  int16 merged = a->collisionGroup();
+  for ( auto &s: m_strokes ) {
+    if ( s == a || s == b || (merged != 0 && s->collisionGroup() == merged) ) {
+      if ( s->collisionGroup() != group ) {
+        s->setCollisionGroup( m_world, group );
+      }
+    }
+  }
+}
+
 bool
 Scene::introCompleted()
 {
@@ -349,6 +412,10 @@ void Scene::step()
 {
     m_step++;
 
+    if (isAnimating()) {
+        m_changes++;
+    }
+
     if (!introCompleted()) {
         return;
     }
@@ -376,13 +443,23 @@ void Scene::step()
             }
         }
 
+        updateContinuous();
         m_world->Step(ITERATION_TIMESTEPf, SOLVER_ITERATIONS);
+        m_contactSteps++;
+        m_contactTotal += m_world->GetContactCount();
+
+        const b2TOIStats &toi = m_world->GetTOIStats();
+        m_toiEvents += toi.events;
+        m_toiComputations += toi.computations;
+        m_toiCappedSteps += toi.capped ? 1 : 0;
+        m_toiMicroseconds += toi.microseconds;
 
         // clean up delete strokes
         for (auto &stroke: m_strokes) {
             if (stroke->hasAttribute(ATTRIB_DELETED)) {
                 stroke->clearAttribute(ATTRIB_DELETED);
                 stroke->hide();
+                m_changes++;
             }
         }
 
@@ -400,11 +477,61 @@ void Scene::step()
     m_color_rects = calcColorRects();
 }
 
+bool Scene::isAnimating()
+{
+    if (m_step <= int(m_strokes.size()) + STROKE_FADE_STEPS || m_createStroke) {
+        return true;
+    }
+
+    // Deleted strokes shrink away as they are drawn, even when paused
+    for (auto &stroke: m_strokes) {
+        if (stroke->hiding()) {
+            return true;
+        }
+    }
+
+    if (m_paused) {
+        return false;
+    }
+
+    if (!m_jetStreams.empty()) {
+        return true;
+    }
+
+    // Resting bodies fall asleep after a while, then nothing moves
+    for (auto &stroke: m_strokes) {
+        b2Body *body = stroke->body();
+        if (body && !body->IsStatic() && !body->IsSleeping()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Scene::updateContinuous()
+{
+  // Strokes are thin boxes, but only those that can cross their own
+  // thickness within one step can tunnel - the rest skip TOI entirely
+  const float32 maxTravel = CCD_THRESHOLDf * 2.0f * STROKE_HALF_THICKNESSf;
+  for ( auto &stroke: m_strokes ) {
+    b2Body *body = stroke->body();
+    if ( !body || body->IsStatic() || body->IsSleeping() ) {
+      continue;
+    }
+
+    float32 speed = body->GetLinearVelocity().Length()
+                  + b2Abs(body->GetAngularVelocity()) * stroke->radius();
+    body->SetContinuous( speed * ITERATION_TIMESTEPf > maxTravel );
+  }
+}
+
 // b2ContactListener callback when a new contact is detected
 void Scene::Add(const b2ContactPoint* point) 
 {     
   // check for completion
   //if (c->GetManifoldCount() > 0) {
+  m_contactReports++;
   Stroke* s1 = (Stroke*)point->shape1->GetBody()->GetUserData();
   Stroke* s2 = (Stroke*)point->shape2->GetBody()->GetUserData();
   if ( s1 && s2 ) {
@@ -418,6 +545,37 @@ void Scene::Add(const b2ContactPoint* point)
   }
 }
 
+bool Scene::ShouldCollide(b2Shape* shape1, b2Shape* shape2)
+{
+  if ( !b2_defaultFilter.ShouldCollide(shape1, shape2) ) {
+    return false;
+  }
+
+  // Strokes jointed to the same stroke at (nearly) the same point overlap
+  // at their ends forever; directly jointed ones are already skipped by
+  // Box2D (collideConnected is false for our joints)
+  const float32 maxDist = 2.0f * JOINT_TOLERANCE / PIXELS_PER_METREf;
+  b2Body* b1 = shape1->GetBody();
+  b2Body* b2 = shape2->GetBody();
+  for ( b2JointEdge* j1 = b1->GetJointList(); j1; j1 = j1->next ) {
+    for ( b2JointEdge* j2 = b2->GetJointList(); j2; j2 = j2->next ) {
+      if ( j1->other == j2->other
+           && (j1->joint->GetAnchor1() - j2->joint->GetAnchor1()).LengthSquared() < maxDist * maxDist ) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool Scene::ShouldReport(b2Shape* shape1, b2Shape* shape2)
+{
+  // Add() only cares about tokens touching goals
+  uint16 categories = shape1->GetFilterData().categoryBits
+                    | shape2->GetFilterData().categoryBits;
+  return categories == (CATEGORY_TOKEN | CATEGORY_GOAL);
+}
+
 bool Scene::isCompleted()
 {
   for ( int i=0; i < m_strokes.size(); i++ ) {
@@ -429,23 +587,100 @@ bool Scene::isCompleted()
   return true;
 }
 
-void Scene::draw(Canvas &canvas, bool everything)
+void Scene::simplify(float32 threshold)
 {
-    Image paper("paper.png", true);
-    canvas.drawImage(paper);
+    for (auto &stroke: m_strokes) {
+        stroke->simplify(threshold);
+    }
+}
+
+bool Scene::isStatic(Stroke *s)
+{
+    if (s == m_createStroke || s == m_moveStroke || s->hiding() || s->hidden()) {
+        return false;
+    }
+
+    b2Body *body = s->body();
+    if (!body) {
+        return s->hasAttribute(ATTRIB_DECOR);
+    }
 
-    int i = 0;
-    const int fade_duration = 50;
+    // While paused nothing moves, so the layer is the whole paused frame
+    return m_paused || body->IsStatic();
+}
+
+void Scene::collectStatic(std::vector<Stroke*> &result)
+{
+    result.clear();
     for (auto &stroke: m_strokes) {
-        int a = 0;
-        if (everything || m_step > i + fade_duration) {
-            a = 255;
-        } else if (m_step > i) {
-            a = 255 * float(m_step - i) / fade_duration;
+        if (isStatic(stroke)) {
+            result.push_back(stroke);
+        }
+    }
+}
+
+bool Scene::staticLayerValid()
+{
+    if (!m_staticLayer || m_staticDirty) {
+        return false;
+    }
+
+    // Strokes that became static, were deleted or started shrinking
+    collectStatic(m_staticScratch);
+    return m_staticScratch == m_staticStrokes;
+}
+
+void Scene::updateStaticLayer()
+{
+    // While fading in, every stroke changes from frame to frame
+    if (m_step <= int(m_strokes.size()) + STROKE_FADE_STEPS || staticLayerValid()) {
+        return;
+    }
+
+    auto renderer = OS->renderer();
+    if (!m_staticLayer) {
+        m_staticLayer = new RenderTarget(renderer->world_size(), renderer->world_rect());
+        m_staticImage = new Image(m_staticLayer->contents());
+    }
+
+    collectStatic(m_staticStrokes);
+    m_staticDirty = false;
+
+    m_staticLayer->begin();
+    Image paper("paper.png", true);
+    m_staticLayer->drawImage(paper);
+    for (auto &stroke: m_staticStrokes) {
+        stroke->draw(*m_staticLayer, 255);
+    }
+    m_staticLayer->end();
+}
+
+void Scene::draw(Canvas &canvas, bool everything)
+{
+    if (!everything && m_step > int(m_strokes.size()) + STROKE_FADE_STEPS && staticLayerValid()) {
+        // Static strokes end up below all others, which hardly shows
+        canvas.drawImage(*m_staticImage);
+        for (auto &stroke: m_strokes) {
+            if (!isStatic(stroke)) {
+                stroke->draw(canvas, 255);
+            }
+        }
+    } else {
+        Image paper("paper.png", true);
+        canvas.drawImage(paper);
+
+        int i = 0;
+        for (auto &stroke: m_strokes) {
+            int a = 0;
+            if (everything || m_step > i + STROKE_FADE_STEPS) {
+                a = 255;
+            } else if (m_step > i) {
+                a = 255 * float(m_step - i) / STROKE_FADE_STEPS;
+            }
+            stroke->draw(canvas, a);
+            i++;
+            //canvas.drawRect(stroke->screenBbox(), 0xff0000, true, 100);
         }
-        stroke->draw(canvas, a);
-        i++;
-        //canvas.drawRect(stroke->screenBbox(), 0xff0000, true, 100);
     }
 
     clearWithDelete(m_deletedStrokes);
@@ -539,18 +774,30 @@ Stroke* Scene::strokeAtPoint( const Vec2 pt, float32 max )
 
 void Scene::clear()
 {
-  for (auto &s: m_strokes) {
-      s->reset(m_world);
+  if ( m_contactSteps ) {
+    LOG_DEBUG("%ld contacts per step over %d steps, %d contact points reported",
+              m_contactTotal / m_contactSteps, m_contactSteps, m_contactReports);
+    LOG_DEBUG("%d TOI events from %d TOI queries in %ld us, capped in %d steps",
+              m_toiEvents, m_toiComputations, m_toiMicroseconds, m_toiCappedSteps);
   }
+  m_contactSteps = m_contactReports = 0;
+  m_contactTotal = 0;
+  m_toiEvents = m_toiComputations = m_toiCappedSteps = 0;
+  m_toiMicroseconds = 0;
+  m_lastGroup = 0;
 
+  // No need to detach bodies from the world first, it goes away as a whole
   clearWithDelete(m_strokes);
   clearWithDelete(m_deletedStrokes);
-  if ( m_world ) {
-    //step is required to actually destroy bodies and joints
-    m_world->Step( ITERATION_TIMESTEPf, SOLVER_ITERATIONS );
-  }
+  m_createStroke = m_moveStroke = nullptr;
+  destroyWorld();
   m_log.clear();
   clearWithDelete(m_jetStreams);
+  m_createJetStream = nullptr;
+  // The strokes of the next level may reuse the same arena addresses
+  m_staticStrokes.clear();
+  m_staticDirty = true;
+  m_changes++;
 }
 
 bool Scene::replay()
@@ -595,6 +842,7 @@ void Scene::setGravity( const std::string& s )
 	b2Vec2 g(x,y);
 	g *= PIXELS_PER_METREf/GRAVITY_FUDGEf;
 	setGravity( g );
+	m_customGravity = true;
     }
   } else {
     LOG_WARNING("Invalid gravity vector [%s]", vector.c_str());
@@ -618,127 +866,216 @@ splitLines(const std::string &str)
     return result;
 }
 
-class SceneSVGVisitor : public tinyxml2::XMLVisitor {
+// Value of a property in an SVG style attribute ("fill:none;stroke:#000")
+static bool
+styleProperty(const SVGReader::Range &style, const char *key, SVGReader::Range &value)
+{
+    auto trim = [] (SVGReader::Range r) {
+        while (r.begin < r.end && r.begin[0] == ' ') r.begin++;
+        while (r.end > r.begin && r.end[-1] == ' ') r.end--;
+        return r;
+    };
+
+    const char *pos = style.begin;
+    while (pos < style.end) {
+        const char *semicolon = std::find(pos, style.end, ';');
+        const char *colon = std::find(pos, semicolon, ':');
+        if (colon != semicolon && trim(SVGReader::Range(pos, colon)) == key) {
+            value = trim(SVGReader::Range(colon + 1, semicolon));
+            return true;
+        }
+        pos = (semicolon == style.end) ? style.end : semicolon + 1;
+    }
+
+    return false;
+}
+
+class SceneSVGHandler : public SVGReader::Handler {
 public:
-    SceneSVGVisitor(Scene *scene)
-        : tinyxml2::XMLVisitor()
+    SceneSVGHandler(Scene *scene)
+        : SVGReader::Handler()
         , scene(scene)
     {
     }
 
-    virtual bool VisitEnter(const tinyxml2::XMLElement &element, const tinyxml2::XMLAttribute *firstAttribute) {
-        if (strcmp(element.Name(), "np:meta") == 0) {
-            const tinyxml2::XMLAttribute *attr;
+    virtual void element(const SVGReader::Range &name, const SVGReader &reader) {
+        if (name == "np:meta") {
+            const SVGReader::Range *attr;
 
-            attr = element.FindAttribute("title");
+            attr = reader.attribute("title");
             if (attr) {
-                scene->m_title = attr->Value();
+                scene->m_title = attr->str();
             }
 
-            attr = element.FindAttribute("background");
+            attr = reader.attribute("background");
             if (attr) {
-                scene->m_bg = attr->Value();
+                scene->m_bg = attr->str();
             }
 
-            attr = element.FindAttribute("author");
+            attr = reader.attribute("author");
             if (attr) {
-                scene->m_author = attr->Value();
+                scene->m_author = attr->str();
             }
 
-            attr = element.FindAttribute("gravity");
+            attr = reader.attribute("gravity");
             if (attr) {
-                scene->setGravity(attr->Value());
+                scene->setGravity(attr->str());
             }
-        } else if (strcmp(element.Name(), "np:interaction") == 0) {
-            const tinyxml2::XMLAttribute *color = element.FindAttribute("np:color");
-            const tinyxml2::XMLAttribute *action = element.FindAttribute("np:action");
+        } else if (name == "np:interaction") {
+            const SVGReader::Range *color = reader.attribute("np:color");
+            const SVGReader::Range *action = reader.attribute("np:action");
 
             if (color && action) {
-                scene->m_interactions.add(color->Value(), action->Value());
+                scene->m_interactions.add(color->toInt(), action->str());
             } else {
                 LOG_WARNING("Invalid np:interaction");
             }
-        } else if (strcmp(element.Name(), "rect") == 0) {
-            const tinyxml2::XMLAttribute *flags = element.FindAttribute("class");
-            if (flags && strcmp(flags->Value(), "jetstream") == 0) {
-                const tinyxml2::XMLAttribute *x = element.FindAttribute("x");
-                const tinyxml2::XMLAttribute *y = element.FindAttribute("y");
-                const tinyxml2::XMLAttribute *width = element.FindAttribute("width");
-                const tinyxml2::XMLAttribute *height = element.FindAttribute("height");
-                const tinyxml2::XMLAttribute *force = element.FindAttribute("np:force");
-                if (!x || !y || !width || !height || !force ||
-                        !scene->addJetStream(x->Value(), y->Value(),
-                                         width->Value(), height->Value(),
-                                         force->Value())) {
+        } else if (name == "rect") {
+            const SVGReader::Range *flags = reader.attribute("class");
+            if (flags && *flags == "jetstream") {
+                const SVGReader::Range *x = reader.attribute("x");
+                const SVGReader::Range *y = reader.attribute("y");
+                const SVGReader::Range *width = reader.attribute("width");
+                const SVGReader::Range *height = reader.attribute("height");
+                const SVGReader::Range *force = reader.attribute("np:force");
+
+                const char *comma = force ? std::find(force->begin, force->end, ',') : nullptr;
+                if (!x || !y || !width || !height || !force || comma == force->end ||
+                        std::find(comma + 1, force->end, ',') != force->end) {
                     LOG_WARNING("Invalid jetstream");
+                    return;
                 }
+
+                int ix = x->toInt();
+                int iy = y->toInt();
+                b2Vec2 vforce(SVGReader::Range(force->begin, comma).toFloat(),
+                              SVGReader::Range(comma + 1, force->end).toFloat());
+                scene->addJetStream(Rect(ix, iy, ix + width->toInt(), iy + height->toInt()), vforce);
             }
-        } else if (strcmp(element.Name(), "path") == 0) {
-            const tinyxml2::XMLAttribute *flags = element.FindAttribute("class");
-            const tinyxml2::XMLAttribute *stroke = element.FindAttribute("stroke");
-            const tinyxml2::XMLAttribute *data = element.FindAttribute("d");
+        } else if (name == "path") {
+            const SVGReader::Range *flags = reader.attribute("class");
+            const SVGReader::Range *stroke = reader.attribute("stroke");
+            const SVGReader::Range *data = reader.attribute("d");
 
-            std::string rgb;
+            SVGReader::Range rgb;
             if (stroke) {
-                rgb = stroke->Value();
+                rgb = *stroke;
             } else {
-                stroke = element.FindAttribute("style");
+                stroke = reader.attribute("style");
                 if (stroke) {
-                    std::map<std::string, std::string> m;
-
-                    try {
-                        for (auto &entry: thp::map(thp::trim, thp::split(stroke->Value(), ";"))) {
-                            std::string k, v;
-                            thp::unpack({&k, &v}) = thp::map(thp::trim, thp::split(entry, ":"));
-                            m[k] = v;
-                        }
-                    } catch (thp::UnpackException e) {
-                        LOG_WARNING("Cannot unpack: %s", stroke->Value());
-                    }
-
-                    rgb = m["stroke"];
+                    styleProperty(*stroke, "stroke", rgb);
                 }
             }
 
             if (flags && rgb.size() > 0 && data) {
-                scene->m_strokes.push_back(new Stroke(flags->Value(),
-                                                      rgb,
-                                                      data->Value()));
-            } else {
-                LOG_WARNING("Invalid path");
+                int colour = NP::Colour::DEFAULT;
+                Stroke::parseColour(rgb.begin, rgb.end, colour);
+
+                Path path = Path::fromSVG(data->begin, data->end);
+                if (path.size() > 0) {
+                    scene->m_strokes.push_back(new (scene->m_arena) Stroke(
+                                Stroke::parseClass(flags->begin, flags->end),
+                                colour, std::move(path)));
+                    return;
+                }
             }
-        } else if (strcmp(element.Name(), "np:event") == 0) {
-            const tinyxml2::XMLAttribute *attr = element.FindAttribute("value");
+
+            LOG_WARNING("Invalid path");
+        } else if (name == "np:event") {
+            const SVGReader::Range *attr = reader.attribute("value");
 
             if (attr) {
-                scene->m_log.push_back(ScriptLogEntry::deserialize(attr->Value()));
+                scene->m_log.push_back(ScriptLogEntry::deserialize(attr->begin, attr->end));
             } else {
                 LOG_WARNING("Invalid np:event");
             }
-        }
+        } else if (name == "np:eventlog") {
+            const SVGReader::Range *attr = reader.attribute("value");
 
-        return true;
+            if (!attr || !scene->m_log.decodeText(attr->begin, attr->end)) {
+                LOG_WARNING("Invalid np:eventlog");
+            }
+        }
     }
 
 private:
     Scene *scene;
 };
 
-bool Scene::load(const std::string &level)
+void Scene::beginLoad()
 {
+    m_loadStart = OS->ticks();
+    m_loadMallocs = m_arena.stats().mallocs;
+
     clear();
     resetWorld();
     m_dynamicGravity = false;
+    m_customGravity = false;
     m_step = 0;
     m_ticks = 0;
+}
+
+bool Scene::finishLoad()
+{
+    protect();
+
+    int events = m_log.size();
+    if (events) {
+        LOG_DEBUG("Loaded log with %d events", events);
+    }
+
+    const Arena::Stats &stats = m_arena.stats();
+    LOG_DEBUG("Level switch took %ld ms: %d arena allocations (%d bytes), "
+              "%d new chunks, %d chunks total, b2Alloc holds %d bytes",
+              OS->ticks() - m_loadStart, stats.allocations, int(stats.bytes),
+              stats.mallocs - m_loadMallocs, stats.chunks, b2_byteCount);
+
+    return true;
+}
+
+bool Scene::loadFile(const std::string &filename)
+{
+    Asset file = Assets::open(filename);
+    if (!file.valid()) {
+        return false;
+    }
+
+    if (BinaryLevel::isBinary(filename)) {
+        return loadBinary(file.data(), file.size());
+    }
+
+    return load(file.data(), file.size());
+}
+
+bool Scene::loadBinary(const char *data, size_t size)
+{
+    beginLoad();
+
+    if (!BinaryLevel::read(*this, data, size)) {
+        // Don't leave a half loaded level behind
+        beginLoad();
+        return false;
+    }
+
+    return finishLoad();
+}
 
-    if (level.find("<svg") != std::string::npos) {
-        tinyxml2::XMLDocument doc;
-        doc.Parse(level.c_str());
-        SceneSVGVisitor visitor(this);
-        doc.Accept(&visitor);
+bool Scene::load(const std::string &level)
+{
+    return load(level.data(), level.size());
+}
+
+bool Scene::load(const char *data, size_t size)
+{
+    beginLoad();
+
+    static const char *SVG_TAG = "<svg";
+    if (std::search(data, data + size, SVG_TAG, SVG_TAG + strlen(SVG_TAG)) != data + size) {
+        SceneSVGHandler handler(this);
+        SVGReader(data, size).parse(handler);
     } else {
         // NPH format
+        std::string level(data, size);
         for (std::string &line: splitLines(level)) {
             std::string value = line.substr(line.find(':') + 1);
             switch (line[0]) {
@@ -752,7 +1089,7 @@ bool Scene::load(const std::string &level)
                     m_author = value;
                     break;
                 case 'S':
-                    m_strokes.push_back(new Stroke(line));
+                    m_strokes.push_back(new (m_arena) Stroke(line));
                     break;
                 case 'I':
                     m_interactions.parse(value);
@@ -770,20 +1107,14 @@ bool Scene::load(const std::string &level)
         }
     }
 
-    protect();
-
-    int events = m_log.size();
-    if (events) {
-        LOG_DEBUG("Loaded log with %d events", events);
-    }
-
-    return true;
+    return finishLoad();
 }
 
 
 bool Scene::start()
 {
     activateAll();
+    m_changes++;
 
     if (m_log.size() > 0) {
         m_recorder.stop();
@@ -804,55 +1135,49 @@ void Scene::protect( int n )
 bool Scene::save( const std::string& file, bool saveLog )
 {
   LOG_INFO("Saving level to %s", file.c_str());
-  std::ofstream o( file.c_str(), std::ios::out );
-  if ( o.is_open() ) {
-    o << thp::format("<svg width=\"%d\" height=\"%d\" xmlns:np=\"%s\">", WORLD_WIDTH, WORLD_HEIGHT, NPSVG_NAMESPACE) << std::endl;
-    o << thp::format("<rect x=\"0\" y=\"0\" width=\"%d\" height=\"%d\" fill=\"white\" stroke=\"none\" />", WORLD_WIDTH, WORLD_HEIGHT) << std::endl;
-    o << thp::format("<np:meta author=\"%s\" background=\"%s\" title=\"%s\" />", m_author.c_str(), m_bg.c_str(), m_title.c_str()) << std::endl;
 
-    for (auto &stream: m_jetStreams) {
-        o << stream->asString() << std::endl;
-    }
+  TextBuffer out;
+  serializeHeader(out, saveLog);
+  if (saveLog) {
+    serializeEvents(out, 0);
+  }
+  serializeFooter(out);
 
-    o << m_interactions.serialize();
-    for ( int i=0; i<m_strokes.size() && (!saveLog || i<m_protect); i++ ) {
-	o << m_strokes[i]->asString() << std::endl;
-    }
+  return FileWriter::write(file, out.release());
+}
 
-    if (saveLog) {
-        for (auto &entry: m_log) {
-            o << thp::format("<np:event value=\"%s\" />", ScriptLogEntry::serialize(entry).c_str()) << std::endl;
-        }
-    }
+void Scene::serializeHeader(TextBuffer &out, bool saveLog)
+{
+  out.printf("<svg width=\"%d\" height=\"%d\" xmlns:np=\"%s\">\n", WORLD_WIDTH, WORLD_HEIGHT, NPSVG_NAMESPACE);
+  out.printf("<rect x=\"0\" y=\"0\" width=\"%d\" height=\"%d\" fill=\"white\" stroke=\"none\" />\n", WORLD_WIDTH, WORLD_HEIGHT);
+  out.printf("<np:meta author=\"%s\" background=\"%s\" title=\"%s\" />\n", m_author.c_str(), m_bg.c_str(), m_title.c_str());
 
-    o << "</svg>" << std::endl;
+  for (auto &stream: m_jetStreams) {
+    stream->serialize(out);
+  }
 
-    o.close();
-    return true;
-  } else {
-    return false;
+  m_interactions.serialize(out);
+  for ( int i=0; i<m_strokes.size() && (!saveLog || i<m_protect); i++ ) {
+    m_strokes[i]->serialize(out);
   }
 }
 
-bool
-Scene::addJetStream(const char *x, const char *y, const char *width, const char *height, const char *force)
+void Scene::serializeEvents(TextBuffer &out, int first)
 {
-    int ix = atoi(x);
-    int iy = atoi(y);
-    int iw = atoi(width);
-    int ih = atoi(height);
-
-    auto v = thp::split(force, ",");
-    if (v.size() != 2) {
-        return false;
-    }
+  m_log.encodeText(out, first);
+}
 
-    b2Vec2 vforce(strtof(v[0].c_str(), nullptr), strtof(v[1].c_str(), nullptr));
+void Scene::serializeFooter(TextBuffer &out)
+{
+  out.append("</svg>\n");
+}
 
-    auto js = new JetStream(Rect(ix, iy, ix+iw, iy+ih), vforce);
+void
+Scene::addJetStream(const Rect &rect, const b2Vec2 &force)
+{
+    auto js = new JetStream(rect, force);
     m_jetStreams.push_back(js);
     js->activate();
-    return true;
 }
 
 JetStream *
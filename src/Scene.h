@@ -24,6 +24,7 @@
 #include "Interactions.h"
 #include "JetStream.h"
 #include "SceneEvent.h"
+#include "Arena.h"
 
 #include <string>
 #include <fstream>
@@ -35,9 +36,10 @@
 class Stroke;
 class b2World;
 class Accelerometer;
+class TextBuffer;
 
 
-class Scene : private b2ContactListener
+class Scene : private b2ContactListener, private b2ContactFilter
 {
 public:
 
@@ -70,6 +72,12 @@ public:
   bool introCompleted();
   bool isCompleted();
   void draw(Canvas &canvas, bool everything=false);
+  // Render the paper and the static strokes into a cached layer if they
+  // changed, so that draw() only has to add the moving strokes on top.
+  // Must not be called while another render target is active.
+  void updateStaticLayer();
+  // Coarser strokes for drawing at a fraction of the size (no world only)
+  void simplify(float32 threshold);
   Stroke* strokeAtPoint( const Vec2 pt, float32 max );
   void clear();
   bool replay();
@@ -78,26 +86,50 @@ public:
   void setGravity( const std::string& s );
 
   bool load(const std::string &level);
+  bool load(const char *data, size_t size);
+  bool loadBinary(const char *data, size_t size);
+  bool loadFile(const std::string &filename);
   bool start();
   void protect( int n=-1 );
   bool save( const std::string& file, bool saveLog=false );
+  // The parts of save(), for writing demos incrementally
+  void serializeHeader(TextBuffer &out, bool saveLog);
+  void serializeEvents(TextBuffer &out, int first);
+  static void serializeFooter(TextBuffer &out);
 
   ScriptLog* getLog() { return &m_log; }
+  void recordTo(ScriptSink *sink) { m_recorder.sink(sink); }
   int getTicks() { return m_ticks; }
+  // Bumped whenever the next draw() would differ from the previous one
+  unsigned changes() const { return m_changes; }
 
   void playbackUntil(ScriptLog &log, int ticks);
 private:
-  bool addJetStream(const char *x, const char *y, const char *width, const char *height, const char *force);
+  void addJetStream(const Rect &rect, const b2Vec2 &force);
   void resetWorld();
+  void beginLoad();
+  bool finishLoad();
+  void destroyWorld();
   bool activate( Stroke *s );
   void activateAll();
   void createJoints( Stroke *s );
+  void joinRopes( Stroke *a, Stroke *b );
+  void updateContinuous();
   std::map<int,Rect> calcColorRects();
+  bool isAnimating();
+  bool isStatic(Stroke *s);
+  void collectStatic(std::vector<Stroke*> &result);
+  bool staticLayerValid();
 
   // b2ContactListener callback when a new contact is detected
   virtual void Add(const b2ContactPoint* point) ;
 
+  // b2ContactFilter callbacks when two shapes start to overlap
+  virtual bool ShouldCollide(b2Shape* shape1, b2Shape* shape2);
+  virtual bool ShouldReport(b2Shape* shape1, b2Shape* shape2);
 
+
+  Arena           m_arena;
   b2World        *m_world;
   std::vector<Stroke*>  m_strokes;
   std::vector<Stroke*>  m_deletedStrokes;
@@ -109,12 +141,26 @@ private:
   b2Vec2          m_gravity;
   b2Vec2          m_currentGravity;
   bool            m_dynamicGravity;
+  bool            m_customGravity;
   Accelerometer  *m_accelerometer;
   int             m_step;
   int             m_ticks;
+  unsigned        m_changes;
   std::map<int,Rect> m_color_rects;
   NP::Interactions    m_interactions;
   std::vector<JetStream *> m_jetStreams;
+  long            m_loadStart;
+  int             m_loadMallocs;
+  int16           m_lastGroup;
+
+  // Contact statistics of the current level
+  int             m_contactSteps;
+  long            m_contactTotal;
+  int             m_contactReports;
+  int             m_toiEvents;
+  int             m_toiComputations;
+  int             m_toiCappedSteps;
+  long            m_toiMicroseconds;
 
   // Create and move stuff
   Stroke  	   *m_createStroke;
@@ -123,7 +169,15 @@ private:
   Vec2              m_moveOffset;
   bool              m_paused;
 
-  friend class SceneSVGVisitor;
+  // Paper and static strokes (in m_staticStrokes) drawn once
+  RenderTarget     *m_staticLayer;
+  Image            *m_staticImage;
+  std::vector<Stroke*> m_staticStrokes;
+  std::vector<Stroke*> m_staticScratch;
+  bool              m_staticDirty;
+
+  friend class SceneSVGHandler;
+  friend class BinaryLevel;
 };
 
 #endif /* NUMPTYPHYSICS_SCENE_H */
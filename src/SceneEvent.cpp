@@ -3,6 +3,8 @@
 #include "petals_log.h"
 #include "thp_format.h"
 
+#include <cstring>
+
 
 static const OperatorMetadata
 META[] = {
@@ -12,22 +14,22 @@ META[] = {
 };
 
 
-static enum SceneEvent::Op
-findOp(const std::string &op)
+enum SceneEvent::Op
+SceneEvent::findOp(const char *name, size_t length)
 {
     for (int i=0; i<ARRAY_SIZE(META); i++) {
-        if (op == META[i].name) {
+        if (strlen(META[i].name) == length && memcmp(META[i].name, name, length) == 0) {
             return SceneEvent::Op(i);
         }
     }
 
-    LOG_FATAL("Invalid operator: '%s'", op.c_str());
+    LOG_FATAL("Invalid operator: '%.*s'", int(length), name);
     return SceneEvent::Op(0);
 }
 
 
 SceneEvent::SceneEvent(const std::string &op, const Vec2 &pos, int userdata1, int userdata2)
-    : op(findOp(op))
+    : op(findOp(op.data(), op.size()))
     , pos(pos)
     , userdata1(userdata1)
     , userdata2(userdata2)
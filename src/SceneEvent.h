@@ -47,6 +47,7 @@ struct SceneEvent {
     }
 
     static const OperatorMetadata *meta(enum Op op);
+    static enum Op findOp(const char *name, size_t length);
 
     enum Op op;
     Vec2 pos;
@@ -16,71 +16,316 @@
 
 #include "Script.h"
 #include "Scene.h"
+#include "FileWriter.h"
 
 #include <string.h>
+#include <cstdint>
+#include <algorithm>
 
 #include "petals_log.h"
-#include "thp_format.h"
 
 
-std::string
-ScriptLogEntry::serialize(const ScriptLogEntry &e)
-{
-    return thp::format("@%d:%s:%d,%d:%d:%d", e.tick, e.ev.meta()->name, e.ev.pos.x, e.ev.pos.y, e.ev.userdata1, e.ev.userdata2);
-}
+struct Field {
+    const char *begin;
+    const char *end;
+};
 
 static int
-number(const std::string &s)
+number(const Field &f)
 {
+    // Same as atoi(), but stops at the end of the field
     // TODO: Error checking
-    return atoi(s.c_str());
+    const char *s = f.begin;
+    while (s < f.end && (*s == ' ' || *s == '\t')) {
+        s++;
+    }
+
+    bool negative = false;
+    if (s < f.end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+
+    int result = 0;
+    while (s < f.end && *s >= '0' && *s <= '9') {
+        result = result * 10 + (*s - '0');
+        s++;
+    }
+
+    return negative ? -result : result;
 }
 
-static std::vector<std::string>
-split_by(const char *splits, const std::string &s)
+static int
+split_by(const char *splits, const char *begin, const char *end, Field *result)
 {
-    std::vector<std::string> result;
+    int count = 0;
 
     int len = strlen(splits);
-    size_t pos = 0;
+    const char *pos = begin;
     for (int i=0; i<len; i++) {
-        size_t start = s.find(splits[i], pos);
-        if (start == std::string::npos) {
+        const char *start = std::find(pos, end, splits[i]);
+        if (start == end) {
             break;
         }
         start++;
-        size_t end = len;
+        const char *stop = end;
         if (i < len-1) {
-            end = s.find(splits[i+1], start);
-            if (end == std::string::npos) {
+            stop = std::find(start, end, splits[i+1]);
+            if (stop == end) {
                 break;
             }
         }
-        result.push_back(s.substr(start, end-start));
-        pos = end;
+        result[count++] = Field{start, stop};
+        pos = stop;
+    }
+
+    return count;
+}
+
+namespace {
+
+const int EVENT_OPS = 0
+#define SCENE_EVENT_DEFINE_OPERATION(name, has_pos, data_fields) + 1
+#include "SceneEventDef.h"
+#undef SCENE_EVENT_DEFINE_OPERATION
+;
+
+enum {
+    LOG_OP_MASK = 0x1f,
+    LOG_POS = 1 << 5,
+    LOG_USERDATA1 = 1 << 6,
+    LOG_USERDATA2 = 1 << 7,
+};
+
+static_assert(EVENT_OPS <= LOG_OP_MASK + 1, "Scene event ops don't fit into the op byte");
+
+const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void
+putVarint(std::string &out, int value)
+{
+    // zigzag, so that small negative deltas stay small
+    uint32_t v = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    while (v >= 0x80) {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+bool
+getVarint(const unsigned char *&pos, const unsigned char *end, int &value)
+{
+    uint32_t v = 0;
+    for (int shift=0; shift<32; shift+=7) {
+        if (pos == end) {
+            return false;
+        }
+
+        unsigned char c = *pos++;
+        v |= uint32_t(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            value = int(v >> 1) ^ -int(v & 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+hasPosition(const SceneEvent &ev)
+{
+    return ev.meta()->has_pos;
+}
+
+// Position the next delta refers to: that of the last event which has a
+// position, or stored a non-zero one anyway
+Vec2
+basePosition(const ScriptLog &log, size_t end)
+{
+    for (size_t i=end; i>0; i--) {
+        const SceneEvent &ev = log[i-1].ev;
+        if (hasPosition(ev) || ev.pos != Vec2(0, 0)) {
+            return ev.pos;
+        }
+    }
+
+    return Vec2(0, 0);
+}
+
+int
+base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+}; /* namespace */
+
+void
+ScriptLog::encode(std::string &out, size_t first) const
+{
+    int tick = (first > 0) ? at(first - 1).tick : 0;
+    Vec2 base = basePosition(*this, first);
+
+    for (size_t i=first; i<size(); i++) {
+        const ScriptLogEntry &e = at(i);
+        bool hasPos = hasPosition(e.ev);
+        Vec2 pos = e.ev.pos;
+
+        unsigned char flags = e.ev.op;
+        if (hasPos ? (pos != base) : (pos != Vec2(0, 0))) {
+            flags |= LOG_POS;
+        }
+        if (e.ev.userdata1) {
+            flags |= LOG_USERDATA1;
+        }
+        if (e.ev.userdata2) {
+            flags |= LOG_USERDATA2;
+        }
+
+        out += char(flags);
+        putVarint(out, e.tick - tick);
+        if (flags & LOG_POS) {
+            putVarint(out, pos.x - base.x);
+            putVarint(out, pos.y - base.y);
+        }
+        if (flags & LOG_USERDATA1) {
+            putVarint(out, e.ev.userdata1);
+        }
+        if (flags & LOG_USERDATA2) {
+            putVarint(out, e.ev.userdata2);
+        }
+
+        tick = e.tick;
+        if (hasPos || (flags & LOG_POS)) {
+            base = pos;
+        }
+    }
+}
+
+bool
+ScriptLog::decode(const char *data, size_t size)
+{
+    const unsigned char *pos = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = pos + size;
+
+    size_t count = this->size();
+    int tick = empty() ? 0 : back().tick;
+    Vec2 base = basePosition(*this, count);
+
+    while (pos < end) {
+        unsigned char flags = *pos++;
+        int op = flags & LOG_OP_MASK;
+        int delta = 0, dx = 0, dy = 0, userdata1 = 0, userdata2 = 0;
+        if (op >= EVENT_OPS || !getVarint(pos, end, delta) ||
+                ((flags & LOG_POS) && (!getVarint(pos, end, dx) || !getVarint(pos, end, dy))) ||
+                ((flags & LOG_USERDATA1) && !getVarint(pos, end, userdata1)) ||
+                ((flags & LOG_USERDATA2) && !getVarint(pos, end, userdata2))) {
+            erase(begin() + count, this->end());
+            return false;
+        }
+
+        SceneEvent ev(SceneEvent::Op(op), 0, 0, userdata1, userdata2);
+        bool hasPos = hasPosition(ev);
+        if (flags & LOG_POS) {
+            ev.pos = base + Vec2(dx, dy);
+        } else if (hasPos) {
+            ev.pos = base;
+        }
+
+        tick += delta;
+        if (hasPos || (flags & LOG_POS)) {
+            base = ev.pos;
+        }
+        push_back(ScriptLogEntry(tick, ev));
+    }
+
+    return true;
+}
+
+void
+ScriptLog::encodeText(TextBuffer &out, size_t first) const
+{
+    if (first >= size()) {
+        return;
+    }
+
+    std::string data;
+    encode(data, first);
+
+    std::string text;
+    text.reserve((data.size() + 2) / 3 * 4);
+    for (size_t i=0; i<data.size(); i+=3) {
+        uint32_t v = uint8_t(data[i]) << 16;
+        if (i + 1 < data.size()) v |= uint8_t(data[i+1]) << 8;
+        if (i + 2 < data.size()) v |= uint8_t(data[i+2]);
+
+        text += BASE64[(v >> 18) & 0x3f];
+        text += BASE64[(v >> 12) & 0x3f];
+        text += (i + 1 < data.size()) ? BASE64[(v >> 6) & 0x3f] : '=';
+        text += (i + 2 < data.size()) ? BASE64[v & 0x3f] : '=';
+    }
+
+    out.append("<np:eventlog value=\"");
+    out.append(text.data(), text.size());
+    out.append("\" />\n");
+}
+
+bool
+ScriptLog::decodeText(const char *begin, const char *end)
+{
+    std::string data;
+    data.reserve((end - begin) / 4 * 3);
+
+    uint32_t v = 0;
+    int bits = 0;
+    for (const char *s=begin; s<end && *s != '='; s++) {
+        int value = base64Value(*s);
+        if (value < 0) {
+            return false;
+        }
+
+        v = (v << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data += char((v >> bits) & 0xff);
+        }
     }
 
-    return result;
+    return decode(data.data(), data.size());
 }
 
 ScriptLogEntry
 ScriptLogEntry::deserialize(const std::string &s)
+{
+    return deserialize(s.data(), s.data() + s.size());
+}
+
+ScriptLogEntry
+ScriptLogEntry::deserialize(const char *begin, const char *end)
 {
     // @0:BEGIN_CREATE_STROKE_AT:605,243:2:0
     // ^ ^                      ^   ^   ^ ^
-    auto matchobj = split_by("@::,::", s);
+    Field matchobj[6];
 
-    if (matchobj.size() != 6) {
-        LOG_FATAL("Cannot deserialize ScriptLogEntry: '%s'", s.c_str());
+    if (split_by("@::,::", begin, end, matchobj) != 6) {
+        LOG_FATAL("Cannot deserialize ScriptLogEntry: '%.*s'", int(end - begin), begin);
     }
 
     int tick = number(matchobj[0]);
-    std::string operation = matchobj[1];
+    auto op = SceneEvent::findOp(matchobj[1].begin, matchobj[1].end - matchobj[1].begin);
     Vec2 pos(number(matchobj[2]), number(matchobj[3]));
     int userdata1 = number(matchobj[4]);
     int userdata2 = number(matchobj[5]);
 
-    return ScriptLogEntry(tick, SceneEvent(operation, pos, userdata1, userdata2));
+    return ScriptLogEntry(tick, SceneEvent(op, pos, userdata1, userdata2));
 }
 
 void
@@ -116,6 +361,9 @@ ScriptRecorder::onSceneEvent(const SceneEvent &ev)
         if (m_log) {
             m_log->push_back(ScriptLogEntry(m_ticks, ev));
             m_index++;
+            if (m_sink) {
+                m_sink->onRecord(*m_log);
+            }
         } else {
             LOG_WARNING("No log in ScriptRecorder onSceneEvent");
         }
@@ -19,22 +19,51 @@
 #include "SceneEvent.h"
 
 #include <iostream>
+#include <string>
 #include <vector>
 #include <utility>
 
 class Scene;
+class TextBuffer;
 
 struct ScriptLogEntry {
     ScriptLogEntry(int tick, const SceneEvent &ev) : tick(tick), ev(ev) {}
 
-    static std::string serialize(const ScriptLogEntry &e);
     static ScriptLogEntry deserialize(const std::string &s);
+    static ScriptLogEntry deserialize(const char *begin, const char *end);
 
     int tick;
     SceneEvent ev;
 };
 
+/**
+ * Recorded scene events
+ *
+ * The compact form stores one byte with the op code and flags for the
+ * fields that follow, the tick as a delta to the previous event, the
+ * position as a delta to the last one recorded and non-zero userdata,
+ * all as zigzag varints. A typical mouse move takes 3-4 bytes. Encoding
+ * can start in the middle of the log and decoding appends to it, so a
+ * log can be stored as a sequence of chunks.
+ **/
 class ScriptLog : public std::vector<ScriptLogEntry> {
+public:
+    void encode(std::string &out, size_t first=0) const;
+    // false (and nothing appended) if the data is corrupt
+    bool decode(const char *data, size_t size);
+
+    // np:eventlog element (base64), for text levels
+    void encodeText(TextBuffer &out, size_t first=0) const;
+    bool decodeText(const char *begin, const char *end);
+};
+
+/**
+ * Gets every event right after the recorder has added it to the log
+ **/
+class ScriptSink {
+public:
+    virtual ~ScriptSink() {}
+    virtual void onRecord(const ScriptLog &log) = 0;
 };
 
 class ScriptHandler {
@@ -62,7 +91,13 @@ protected:
 
 class ScriptRecorder : public ScriptHandler {
 public:
+    ScriptRecorder() : ScriptHandler(), m_sink(nullptr) {}
+
     void onSceneEvent(const SceneEvent &ev);
+    void sink(ScriptSink *sink) { m_sink = sink; }
+
+private:
+    ScriptSink *m_sink;
 };
 
 class ScriptPlayer : public ScriptHandler {
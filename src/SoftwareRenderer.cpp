@@ -0,0 +1,754 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "SoftwareRenderer.h"
+#include "Assets.h"
+
+#include "stb_loader.h"
+
+#include "petals_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+// Taps of the blur shader, from -3 to +3 pixelgrid steps
+static const float BLUR_WEIGHTS[] = { 0.006f, 0.061f, 0.242f, 0.383f, 0.242f, 0.061f, 0.006f };
+
+namespace {
+
+class SoftwareMeshData : public NP::MeshData {
+public:
+    SoftwareMeshData() : NP::MeshData(), vertices() {}
+
+    // Body space
+    std::vector<SoftwareRenderer::Vertex> vertices;
+};
+
+class SoftwareFontData : public NP::FontData, public NP::GlyphCache {
+public:
+    SoftwareFontData(const char *filename, int size)
+        : NP::FontData(size)
+        , NP::GlyphCache()
+        , file(Assets::open(filename))
+        , font()
+    {
+        if (file.valid()) {
+            font.reset(new StbLoader_Font(file.data(), file.size(), size));
+        } else {
+            LOG_WARNING("Cannot load font %s", filename);
+        }
+    }
+
+    virtual int lineHeight() { return font ? font->height() : 0; }
+    virtual int kerning(unsigned int left, unsigned int right) { return font ? font->kerning(left, right) : 0; }
+
+    // Mapped once, glyphs are rendered straight from it; without it
+    // all glyphs are empty
+    Asset file;
+    std::unique_ptr<StbLoader_Font> font;
+};
+
+void
+rgba_split(int rgba, unsigned char color[4])
+{
+    color[0] = (rgba >> 16) & 0xff;
+    color[1] = (rgba >> 8) & 0xff;
+    color[2] = rgba & 0xff;
+    color[3] = (rgba >> 24) & 0xff;
+}
+
+// n bilinear lookups on a row, from u, v (in texels, centers at .5) in
+// steps of du, clamped to the edge
+void
+sample(const SoftwareFramebufferData *texture, float u, float du, float v, unsigned char *out, int n)
+{
+    v -= 0.5f;
+    float fy = std::floor(v);
+    int wy = int((v - fy) * 256.f);
+    int y0 = std::max(0, std::min(texture->h - 1, int(fy)));
+    int y1 = std::max(0, std::min(texture->h - 1, int(fy) + 1));
+    const unsigned char *row0 = texture->pixels.data() + y0 * texture->w * 4;
+    const unsigned char *row1 = texture->pixels.data() + y1 * texture->w * 4;
+
+    // 16.16 fixed point
+    int fu = int(std::floor((u - 0.5f) * 65536.f));
+    int fdu = int(du * 65536.f);
+    int last = texture->w - 1;
+    for (int i=0; i<n; i++, fu += fdu, out += 4) {
+        int x = fu >> 16;
+        int wx = (fu >> 8) & 0xff;
+        const unsigned char *a0 = row0 + std::max(0, std::min(last, x)) * 4;
+        const unsigned char *a1 = row0 + std::max(0, std::min(last, x + 1)) * 4;
+        const unsigned char *b0 = row1 + std::max(0, std::min(last, x)) * 4;
+        const unsigned char *b1 = row1 + std::max(0, std::min(last, x + 1)) * 4;
+        for (int c=0; c<4; c++) {
+            int top = a0[c] * (256 - wx) + a1[c] * wx;
+            int bottom = b0[c] * (256 - wx) + b1[c] * wx;
+            out[c] = (top * (256 - wy) + bottom * wy + (1 << 15)) >> 16;
+        }
+    }
+}
+
+// dst = src * a + dst * (255 - a), divided by 255 with rounding
+inline unsigned char
+blend(int src, int dst, int a)
+{
+    int x = src * a + dst * (255 - a) + 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#if defined(__SSE2__)
+// Same as blend() for the eight 16 bit lanes
+inline __m128i
+blend_epi16(__m128i src, __m128i dst, __m128i a)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(src, a),
+                              _mm_mullo_epi16(dst, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Alpha of both pixels in a, copied to all their lanes
+inline __m128i
+alpha_epi16(__m128i a)
+{
+    a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+}
+#endif
+
+// n RGBA pixels of src over dst, each with its own alpha
+void
+blend_span(unsigned char *dst, const unsigned char *src, int n)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i * 4));
+
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i lo = blend_epi16(s_lo, _mm_unpacklo_epi8(d, zero), alpha_epi16(s_lo));
+        __m128i hi = blend_epi16(s_hi, _mm_unpackhi_epi8(d, zero), alpha_epi16(s_hi));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < n; i++) {
+        const unsigned char *s = src + i * 4;
+        unsigned char *d = dst + i * 4;
+        int a = s[3];
+        for (int c=0; c<4; c++) {
+            d[c] = blend(s[c], d[c], a);
+        }
+    }
+}
+
+// n pixels of one colour over dst
+void
+fill_span(unsigned char *dst, const unsigned char color[4], int n)
+{
+    uint32_t pixel;
+    memcpy(&pixel, color, 4);
+
+    int i = 0;
+    if (color[3] == 255) {
+#if defined(__SSE2__)
+        __m128i s = _mm_set1_epi32(pixel);
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), s);
+        }
+#endif
+        for (; i < n; i++) {
+            memcpy(dst + i * 4, &pixel, 4);
+        }
+        return;
+    }
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32(pixel), zero);
+    __m128i a = alpha_epi16(s);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i * 4));
+        __m128i lo = blend_epi16(s, _mm_unpacklo_epi8(d, zero), a);
+        __m128i hi = blend_epi16(s, _mm_unpackhi_epi8(d, zero), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < n; i++) {
+        unsigned char *d = dst + i * 4;
+        for (int c=0; c<4; c++) {
+            d[c] = blend(color[c], d[c], color[3]);
+        }
+    }
+}
+
+}; /* namespace */
+
+
+SoftwareFramebufferData::SoftwareFramebufferData(int w, int h)
+    : NP::FramebufferData(w, h)
+    , pixels(w * h * 4, 0)
+{
+}
+
+SoftwareFramebufferData::~SoftwareFramebufferData()
+{
+}
+
+SoftwareTextureData::SoftwareTextureData(unsigned char *pixels, int w, int h)
+    : NP::TextureData(w, h)
+    , framebuffer(new SoftwareFramebufferData(w, h))
+{
+    SoftwareFramebufferData *data = static_cast<SoftwareFramebufferData *>(framebuffer.get());
+    memcpy(data->pixels.data(), pixels, w * h * 4);
+}
+
+SoftwareTextureData::SoftwareTextureData(NP::Framebuffer framebuffer)
+    : NP::TextureData(framebuffer->w, framebuffer->h)
+    , framebuffer(framebuffer)
+{
+}
+
+SoftwareTextureData::~SoftwareTextureData()
+{
+}
+
+
+SoftwareRenderer::SoftwareRenderer(Vec2 world_size, Vec2 framebuffer_size)
+    : m_world_size(world_size)
+    , m_framebuffer_size(framebuffer_size)
+    , m_screen(new SoftwareFramebufferData(framebuffer_size.x, framebuffer_size.y))
+    , m_target(static_cast<SoftwareFramebufferData *>(m_screen.get()))
+    , m_scale_x(1.f)
+    , m_scale_y(1.f)
+    , m_offset_x(0.f)
+    , m_offset_y(0.f)
+    , m_clip{0, 0, framebuffer_size.x, framebuffer_size.y}
+    , m_last_clip(Vec2(0, 0), world_size)
+    , m_texture_cache()
+    , m_span()
+    , m_vertices()
+{
+    setupProjection(Rect(Vec2(0, 0), world_size), framebuffer_size, false);
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+}
+
+void
+SoftwareRenderer::setupProjection(Rect world_rect, Vec2 size, bool offscreen)
+{
+    if (offscreen) {
+        // world_rect covers the whole render target
+        m_scale_x = float(size.x) / world_rect.w();
+        m_scale_y = float(size.y) / world_rect.h();
+        m_offset_x = -world_rect.tl.x * m_scale_x;
+        m_offset_y = -world_rect.tl.y * m_scale_y;
+    } else {
+        // Centered and scaled to fit, like GLRenderer does on screen
+        float scale = std::min(float(size.x) / world_rect.w(), float(size.y) / world_rect.h());
+        m_scale_x = m_scale_y = scale;
+        m_offset_x = (size.x - world_rect.w() * scale) / 2.f;
+        m_offset_y = (size.y - world_rect.h() * scale) / 2.f;
+    }
+}
+
+SoftwareRenderer::Bounds
+SoftwareRenderer::bounds() const
+{
+    return Bounds{std::max(0, m_clip.x1), std::max(0, m_clip.y1),
+                  std::min(m_target->w, m_clip.x2), std::min(m_target->h, m_clip.y2)};
+}
+
+Vec2
+SoftwareRenderer::framebuffer_size()
+{
+    return m_framebuffer_size;
+}
+
+Vec2
+SoftwareRenderer::world_size()
+{
+    return m_world_size;
+}
+
+NP::Texture
+SoftwareRenderer::load(const char *filename, bool cache)
+{
+    std::string fn(filename);
+
+    if (cache) {
+        auto it = m_texture_cache.find(fn);
+        if (it != m_texture_cache.end()) {
+            return it->second;
+        }
+    }
+
+    Asset file = Assets::open(filename);
+    StbLoader_RGBA *rgba = file.valid() ? StbLoader::decode_image(file.data(), file.size()) : nullptr;
+    NP::Texture result;
+    if (rgba) {
+        result = load((unsigned char *)rgba->data, rgba->w, rgba->h);
+        delete rgba;
+    } else {
+        LOG_WARNING("Cannot load image %s", filename);
+        unsigned char transparent[4] = { 0, 0, 0, 0 };
+        result = load(transparent, 1, 1);
+    }
+
+    if (cache) {
+        m_texture_cache[fn] = result;
+    }
+
+    return result;
+}
+
+NP::Texture
+SoftwareRenderer::load(unsigned char *pixels, int w, int h)
+{
+    return NP::Texture(new SoftwareTextureData(pixels, w, h));
+}
+
+NP::Framebuffer
+SoftwareRenderer::framebuffer(Vec2 size)
+{
+    return NP::Framebuffer(new SoftwareFramebufferData(size.x, size.y));
+}
+
+void
+SoftwareRenderer::begin(NP::Framebuffer &rendertarget, Rect world_rect)
+{
+    m_target = static_cast<SoftwareFramebufferData *>(rendertarget.get());
+    setupProjection(world_rect, Vec2(m_target->w, m_target->h), true);
+}
+
+void
+SoftwareRenderer::end(NP::Framebuffer &rendertarget)
+{
+    m_target = static_cast<SoftwareFramebufferData *>(m_screen.get());
+    setupProjection(Rect(Vec2(0, 0), m_world_size), m_framebuffer_size, false);
+}
+
+NP::Texture
+SoftwareRenderer::retrieve(NP::Framebuffer &rendertarget)
+{
+    return NP::Texture(new SoftwareTextureData(rendertarget));
+}
+
+void
+SoftwareRenderer::read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels)
+{
+    SoftwareFramebufferData *data = static_cast<SoftwareFramebufferData *>(rendertarget.get());
+
+    int w = area.w() * 4;
+    for (int y=area.tl.y; y<area.br.y; y++) {
+        memcpy(pixels, data->pixels.data() + (y * data->w + area.tl.x) * 4, w);
+        pixels += w;
+    }
+}
+
+Rect
+SoftwareRenderer::clip(Rect rect)
+{
+    float x1 = projectX(rect.tl.x), x2 = projectX(rect.br.x);
+    float y1 = projectY(rect.tl.y), y2 = projectY(rect.br.y);
+
+    m_clip = Bounds{int(std::min(x1, x2)), int(std::min(y1, y2)),
+                    int(std::max(x1, x2)), int(std::max(y1, y2))};
+
+    std::swap(rect, m_last_clip);
+    return rect;
+}
+
+template <typename F>
+void
+SoftwareRenderer::quad(const Rect &dst, F shade)
+{
+    float x1 = projectX(dst.tl.x), x2 = projectX(dst.br.x);
+    float y1 = projectY(dst.tl.y), y2 = projectY(dst.br.y);
+    if (x1 == x2 || y1 == y2) {
+        return;
+    }
+
+    // Pixels with their center inside the quad
+    Bounds area = bounds();
+    int px1 = std::max(area.x1, int(std::ceil(std::min(x1, x2) - 0.5f)));
+    int px2 = std::min(area.x2, int(std::ceil(std::max(x1, x2) - 0.5f)));
+    int py1 = std::max(area.y1, int(std::ceil(std::min(y1, y2) - 0.5f)));
+    int py2 = std::min(area.y2, int(std::ceil(std::max(y1, y2) - 0.5f)));
+    if (px1 >= px2 || py1 >= py2) {
+        return;
+    }
+
+    int n = px2 - px1;
+    m_span.resize(n * 4);
+    float u = (px1 + 0.5f - x1) / (x2 - x1);
+    float du = 1.f / (x2 - x1);
+    for (int py=py1; py<py2; py++) {
+        float v = (py + 0.5f - y1) / (y2 - y1);
+        float y = (py + 0.5f - m_offset_y) / m_scale_y;
+        shade(u, du, v, y, m_span.data(), n);
+        blend_span(m_target->pixels.data() + (py * m_target->w + px1) * 4, m_span.data(), n);
+    }
+}
+
+void
+SoftwareRenderer::textured(const NP::Texture &texture, const Rect &src, const Rect &dst,
+                           const unsigned char tint[4])
+{
+    SoftwareTextureData *data = static_cast<SoftwareTextureData *>(texture.get());
+    const SoftwareFramebufferData *pixels = static_cast<SoftwareFramebufferData *>(data->framebuffer.get());
+
+    float sx = src.tl.x, sw = src.br.x - src.tl.x;
+    float sy = src.tl.y, sh = src.br.y - src.tl.y;
+    bool white = (tint[0] & tint[1] & tint[2] & tint[3]) == 255;
+
+    quad(dst, [=] (float u, float du, float v, float, unsigned char *out, int n) {
+        sample(pixels, sx + u * sw, du * sw, sy + v * sh, out, n);
+        if (!white) {
+            for (int i=0; i<n * 4; i++) {
+                out[i] = (out[i] * tint[i % 4] + 127) / 255;
+            }
+        }
+    });
+}
+
+void
+SoftwareRenderer::image(const NP::Texture &texture, int x, int y, int w, int h)
+{
+    subimage(texture, Rect(0, 0, texture->w, texture->h), Rect(x, y, x+w, y+h));
+}
+
+void
+SoftwareRenderer::subimage(const NP::Texture &texture, const Rect &src, const Rect &dst)
+{
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    textured(texture, src, dst, white);
+}
+
+void
+SoftwareRenderer::blur(const NP::Texture &texture, const Rect &src, const Rect &dst, float rx, float ry)
+{
+    SoftwareTextureData *data = static_cast<SoftwareTextureData *>(texture.get());
+    const SoftwareFramebufferData *pixels = static_cast<SoftwareFramebufferData *>(data->framebuffer.get());
+
+    float sx = src.tl.x, sw = src.br.x - src.tl.x;
+    float sy = src.tl.y, sh = src.br.y - src.tl.y;
+
+    std::vector<float> sum;
+    std::vector<unsigned char> tap;
+    quad(dst, [=, &sum, &tap] (float u, float du, float v, float, unsigned char *out, int n) {
+        sum.assign(n * 4, 0.f);
+        tap.resize(n * 4);
+        for (int i=0; i<7; i++) {
+            sample(pixels, sx + u * sw + (i - 3) * rx, du * sw, sy + v * sh + (i - 3) * ry, tap.data(), n);
+            for (int j=0; j<n * 4; j++) {
+                sum[j] += tap[j] * BLUR_WEIGHTS[i];
+            }
+        }
+        for (int j=0; j<n * 4; j++) {
+            out[j] = (j % 4 == 3) ? 255 : std::min(255, int(sum[j] + 0.5f));
+        }
+    });
+}
+
+void
+SoftwareRenderer::rewind(const NP::Texture &texture, const Rect &src, const Rect &dst, float t, float a)
+{
+    SoftwareTextureData *data = static_cast<SoftwareTextureData *>(texture.get());
+    const SoftwareFramebufferData *pixels = static_cast<SoftwareFramebufferData *>(data->framebuffer.get());
+
+    float sx = src.tl.x, sw = src.br.x - src.tl.x;
+    float sy = src.tl.y, sh = src.br.y - src.tl.y;
+    float w = pixels->w;
+
+    quad(dst, [=] (float u, float du, float v, float y, unsigned char *out, int n) {
+        // Only depends on the row; in texture coordinates, as in the shader.
+        // Wobbly
+        float offset = a * 0.09f * std::pow(std::sin(y * 0.04f + t * 0.004f), 30.f);
+        // Noise
+        offset += a * 0.003f * std::sin(y * 10000.f + t * 100.f);
+        for (int i=0; i<n; i++) {
+            float x = (sx + (u + i * du) * sw) / w + offset;
+            // Don't go offscreen left and right
+            x = std::max(0.f, std::min(1.f - 0.01f, x));
+            sample(pixels, x * w, 0.f, sy + v * sh, out + i * 4, 1);
+        }
+    });
+}
+
+void
+SoftwareRenderer::saturation(const NP::Texture &texture, const Rect &src, const Rect &dst, float a)
+{
+    SoftwareTextureData *data = static_cast<SoftwareTextureData *>(texture.get());
+    const SoftwareFramebufferData *pixels = static_cast<SoftwareFramebufferData *>(data->framebuffer.get());
+
+    float sx = src.tl.x, sw = src.br.x - src.tl.x;
+    float sy = src.tl.y, sh = src.br.y - src.tl.y;
+
+    quad(dst, [=] (float u, float du, float v, float, unsigned char *out, int n) {
+        sample(pixels, sx + u * sw, du * sw, sy + v * sh, out, n);
+        for (int i=0; i<n; i++, out += 4) {
+            float g = (out[0] + out[1] + out[2]) / 3.f;
+            for (int c=0; c<3; c++) {
+                out[c] = int(a * out[c] + (1.f - a) * g + 0.5f);
+            }
+        }
+    });
+}
+
+void
+SoftwareRenderer::rectangle(const Rect &rect, int rgba, bool fill)
+{
+    if (!fill) {
+        Vec2 corners[] = { rect.tl, rect.tr(), rect.br, rect.bl(), rect.tl };
+        Path p(5, corners);
+        path(p, rgba);
+        return;
+    }
+
+    unsigned char color[4];
+    rgba_split(rgba, color);
+
+    float x1 = projectX(rect.tl.x), x2 = projectX(rect.br.x);
+    float y1 = projectY(rect.tl.y), y2 = projectY(rect.br.y);
+
+    Bounds area = bounds();
+    int px1 = std::max(area.x1, int(std::ceil(std::min(x1, x2) - 0.5f)));
+    int px2 = std::min(area.x2, int(std::ceil(std::max(x1, x2) - 0.5f)));
+    int py1 = std::max(area.y1, int(std::ceil(std::min(y1, y2) - 0.5f)));
+    int py2 = std::min(area.y2, int(std::ceil(std::max(y1, y2) - 0.5f)));
+
+    for (int py=py1; py<py2 && px1<px2; py++) {
+        fill_span(m_target->pixels.data() + (py * m_target->w + px1) * 4, color, px2 - px1);
+    }
+}
+
+void
+SoftwareRenderer::path(const Path &path, int rgba)
+{
+    if (path.numPoints() < 2) {
+        return;
+    }
+
+    std::vector<Vertex> &vertices = m_vertices;
+    vertices.clear();
+    NP::outline(path, [&vertices] (const b2Vec2 &v, float coverage) {
+        vertices.push_back(Vertex{v.x, v.y, coverage});
+    });
+    strip(vertices, rgba);
+}
+
+NP::Mesh
+SoftwareRenderer::tessellate(const Path &path)
+{
+    SoftwareMeshData *result = new SoftwareMeshData();
+    std::vector<Vertex> &vertices = result->vertices;
+    NP::outline(path, [&vertices] (const b2Vec2 &v, float coverage) {
+        vertices.push_back(Vertex{v.x, v.y, coverage});
+    });
+    return NP::Mesh(result);
+}
+
+void
+SoftwareRenderer::mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba)
+{
+    SoftwareMeshData *data = static_cast<SoftwareMeshData *>(mesh.get());
+
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+
+    m_vertices.clear();
+    for (auto &v: data->vertices) {
+        m_vertices.push_back(Vertex{c * v.x - s * v.y + x, s * v.x + c * v.y + y, v.coverage});
+    }
+    strip(m_vertices, rgba);
+}
+
+void
+SoftwareRenderer::strip(const std::vector<Vertex> &vertices, int rgba)
+{
+    unsigned char color[4];
+    rgba_split(rgba, color);
+
+    for (size_t i=2; i<vertices.size(); i++) {
+        const Vertex &a = vertices[i-2], &b = vertices[i-1], &c = vertices[i];
+        triangle(Vertex{projectX(a.x), projectY(a.y), a.coverage},
+                 Vertex{projectX(b.x), projectY(b.y), b.coverage},
+                 Vertex{projectX(c.x), projectY(c.y), c.coverage}, color);
+    }
+}
+
+void
+SoftwareRenderer::triangle(Vertex a, Vertex b, Vertex c, const unsigned char rgba[4])
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::fabs(area) < 1e-6f) {
+        // Joins between segments of a strip
+        return;
+    }
+    if (area < 0.f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    // Edge functions e(x, y) = ex * x + ey * y + e0, positive inside;
+    // edge i is opposite of vertex i, so e_i / area is its weight
+    const Vertex *v[3] = { &a, &b, &c };
+    float ex[3], ey[3], e0[3];
+    for (int i=0; i<3; i++) {
+        const Vertex &p = *v[(i + 1) % 3];
+        const Vertex &q = *v[(i + 2) % 3];
+        ex[i] = p.y - q.y;
+        ey[i] = q.x - p.x;
+        e0[i] = p.x * q.y - p.y * q.x;
+    }
+
+    // Coverage is linear in x and y across the triangle
+    float cx = 0.f, cy = 0.f, c0 = 0.f;
+    for (int i=0; i<3; i++) {
+        cx += ex[i] * v[i]->coverage / area;
+        cy += ey[i] * v[i]->coverage / area;
+        c0 += e0[i] * v[i]->coverage / area;
+    }
+
+    Bounds box = bounds();
+    float top = std::min(a.y, std::min(b.y, c.y));
+    float bottom = std::max(a.y, std::max(b.y, c.y));
+    int py1 = std::max(box.y1, int(std::ceil(top - 0.5f)));
+    int py2 = std::min(box.y2, int(std::ceil(bottom - 0.5f)));
+
+    for (int py=py1; py<py2; py++) {
+        float y = py + 0.5f;
+
+        // Span of pixel centers on this row inside all three edges
+        float left = box.x1 + 0.5f, right = box.x2 - 0.5f;
+        for (int i=0; i<3; i++) {
+            float rest = ey[i] * y + e0[i];
+            if (ex[i] > 0.f) {
+                left = std::max(left, -rest / ex[i]);
+            } else if (ex[i] < 0.f) {
+                right = std::min(right, -rest / ex[i]);
+            } else if (rest < 0.f) {
+                right = left - 1.f;
+            }
+        }
+
+        int px1 = std::max(box.x1, int(std::ceil(left - 0.5f)));
+        int px2 = std::min(box.x2, int(std::floor(right - 0.5f)) + 1);
+        if (px1 >= px2) {
+            continue;
+        }
+
+        int n = px2 - px1;
+        m_span.resize(n * 4);
+        unsigned char *out = m_span.data();
+        float coverage = cx * (px1 + 0.5f) + cy * y + c0;
+        for (int i=0; i<n; i++) {
+            float alpha = rgba[3] * std::max(0.f, std::min(1.f, coverage));
+            out[0] = rgba[0];
+            out[1] = rgba[1];
+            out[2] = rgba[2];
+            out[3] = int(alpha + 0.5f);
+            out += 4;
+            coverage += cx;
+        }
+        blend_span(m_target->pixels.data() + (py * m_target->w + px1) * 4, m_span.data(), n);
+    }
+}
+
+NP::Font
+SoftwareRenderer::load(const char *filename, int size)
+{
+    return NP::Font(new SoftwareFontData(filename, size));
+}
+
+void
+SoftwareRenderer::createGlyph(NP::FontData *font, unsigned int codepoint, NP::GlyphCache::Glyph &glyph)
+{
+    SoftwareFontData *data = static_cast<SoftwareFontData *>(font);
+    if (!data->font) {
+        return;
+    }
+
+    StbLoader_RGBA *rgba = data->font->render_glyph(codepoint, &glyph.x, &glyph.y, &glyph.advance);
+    if (rgba) {
+        glyph.texture = load((unsigned char *)rgba->data, rgba->w, rgba->h);
+        delete rgba;
+    }
+}
+
+void
+SoftwareRenderer::metrics(const NP::Font &font, const char *text, int *width, int *height)
+{
+    SoftwareFontData *data = static_cast<SoftwareFontData *>(font.get());
+
+    *width = data->layout(text, [this, data] (unsigned int codepoint, NP::GlyphCache::Glyph &glyph) {
+        createGlyph(data, codepoint, glyph);
+    }, [] (const NP::GlyphCache::Glyph &, int) {});
+    *height = data->lineHeight();
+}
+
+void
+SoftwareRenderer::text(const NP::Font &font, const char *text, int x, int y, int rgb)
+{
+    SoftwareFontData *data = static_cast<SoftwareFontData *>(font.get());
+
+    unsigned char tint[4];
+    rgba_split(rgb | 0xff000000, tint);
+
+    data->layout(text, [this, data] (unsigned int codepoint, NP::GlyphCache::Glyph &glyph) {
+        createGlyph(data, codepoint, glyph);
+    }, [&] (const NP::GlyphCache::Glyph &entry, int pen) {
+        if (entry.texture) {
+            int w = entry.texture->w, h = entry.texture->h;
+            textured(entry.texture, Rect(0, 0, w, h),
+                     Rect(x + pen + entry.x, y + entry.y, x + pen + entry.x + w, y + entry.y + h), tint);
+        }
+    });
+}
+
+void
+SoftwareRenderer::clear()
+{
+    // Like glClear() with the scissor test off: the whole target
+    const unsigned char black[4] = { 0, 0, 0, 255 };
+    for (int y=0; y<m_target->h; y++) {
+        fill_span(m_target->pixels.data() + y * m_target->w * 4, black, m_target->w);
+    }
+}
+
+void
+SoftwareRenderer::flush()
+{
+}
+
+void
+SoftwareRenderer::swap()
+{
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_SOFTWARERENDERER_H
+#define NUMPTYPHYSICS_SOFTWARERENDERER_H
+
+#include "Renderer.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class SoftwareFramebufferData : public NP::FramebufferData {
+public:
+    SoftwareFramebufferData(int width, int height);
+    ~SoftwareFramebufferData();
+
+    // RGBA, top row first
+    std::vector<unsigned char> pixels;
+};
+
+class SoftwareTextureData : public NP::TextureData {
+public:
+    SoftwareTextureData(unsigned char *pixels, int width, int height);
+    SoftwareTextureData(NP::Framebuffer framebuffer);
+    ~SoftwareTextureData();
+
+    // Pixels of the texture, or the render target it shows
+    NP::Framebuffer framebuffer;
+};
+
+/**
+ * Renderer that draws into memory, without a GL context
+ *
+ * Everything the GL renderer draws is rasterized on the CPU with the
+ * same geometry: paths and meshes are the triangle strips of
+ * NP::outline() with the coverage interpolated across each triangle,
+ * textures are sampled bilinearly with clamped edges, and the blur,
+ * rewind and saturation effects follow their shaders. Pixels are blended
+ * like glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), four at a time
+ * with SSE2 where available; the scalar code gives the same results.
+ *
+ * Used for rendering level thumbnails on batch worker threads (with
+ * ScopedRenderer), one renderer per thread. The window contents end up
+ * in screen(), which swap() leaves alone.
+ **/
+class SoftwareRenderer : public NP::Renderer {
+public:
+    SoftwareRenderer(Vec2 world_size, Vec2 framebuffer_size);
+    ~SoftwareRenderer();
+
+    NP::Framebuffer &screen() { return m_screen; }
+
+    virtual Vec2 framebuffer_size();
+    virtual Vec2 world_size();
+
+    virtual NP::Texture load(const char *filename, bool cache);
+    virtual NP::Texture load(unsigned char *pixels, int w, int h);
+
+    virtual NP::Framebuffer framebuffer(Vec2 size);
+    virtual void begin(NP::Framebuffer &rendertarget, Rect world_rect);
+    virtual void end(NP::Framebuffer &rendertarget);
+    virtual NP::Texture retrieve(NP::Framebuffer &rendertarget);
+    virtual void read(NP::Framebuffer &rendertarget, const Rect &area, unsigned char *pixels);
+
+    virtual Rect clip(Rect rect);
+
+    virtual void image(const NP::Texture &texture, int x, int y, int w, int h);
+    virtual void subimage(const NP::Texture &texture, const Rect &src, const Rect &dst);
+    virtual void blur(const NP::Texture &texture, const Rect &src, const Rect &dst, float rx, float ry);
+    virtual void rewind(const NP::Texture &texture, const Rect &src, const Rect &dst, float t, float a);
+    virtual void saturation(const NP::Texture &texture, const Rect &src, const Rect &dst, float a);
+    virtual void rectangle(const Rect &r, int rgba, bool fill);
+    virtual void path(const Path &p, int rgba);
+    virtual NP::Mesh tessellate(const Path &p);
+    virtual void mesh(const NP::Mesh &mesh, float x, float y, float angle, int rgba);
+
+    virtual NP::Font load(const char *filename, int size);
+
+    virtual void metrics(const NP::Font &font, const char *text, int *width, int *height);
+    virtual void text(const NP::Font &font, const char *text, int x, int y, int rgb);
+
+    virtual void clear();
+    virtual void flush();
+    virtual void swap();
+
+    struct Vertex {
+        float x, y;
+        float coverage;
+    };
+
+private:
+    // Pixels of the target that may be drawn, x2 and y2 exclusive
+    struct Bounds {
+        int x1, y1, x2, y2;
+    };
+
+    void setupProjection(Rect world_rect, Vec2 size, bool offscreen);
+    float projectX(float x) const { return x * m_scale_x + m_offset_x; }
+    float projectY(float y) const { return y * m_scale_y + m_offset_y; }
+    Bounds bounds() const;
+    // SoftwareFontData is local to the implementation
+    void createGlyph(NP::FontData *font, unsigned int codepoint, NP::GlyphCache::Glyph &glyph);
+
+    // Calls shade(u, du, v, y, rgba, n) for each row of pixels covered by
+    // dst, then blends the n pixels in rgba over the row; u/v go from 0 at
+    // dst.tl to 1 at dst.br (u at the first pixel center, du per pixel), y
+    // is the row center in world coordinates
+    template <typename F>
+    void quad(const Rect &dst, F shade);
+    void textured(const NP::Texture &texture, const Rect &src, const Rect &dst, const unsigned char tint[4]);
+    // Vertices in world coordinates, drawn as one triangle strip
+    void strip(const std::vector<Vertex> &vertices, int rgba);
+    // Vertices in target pixels
+    void triangle(Vertex a, Vertex b, Vertex c, const unsigned char rgba[4]);
+
+    Vec2 m_world_size;
+    Vec2 m_framebuffer_size;
+    NP::Framebuffer m_screen;
+    SoftwareFramebufferData *m_target;
+    // World to target pixels
+    float m_scale_x, m_scale_y;
+    float m_offset_x, m_offset_y;
+    // In pixels, like the GL scissor box it stays set across targets
+    Bounds m_clip;
+    Rect m_last_clip;
+    std::unordered_map<std::string, NP::Texture> m_texture_cache;
+    // Scratch space
+    std::vector<unsigned char> m_span;
+    std::vector<Vertex> m_vertices;
+};
+
+#endif /* NUMPTYPHYSICS_SOFTWARERENDERER_H */
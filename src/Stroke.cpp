@@ -14,12 +14,16 @@
  */
 
 #include "Stroke.h"
+#include "Arena.h"
 #include "Scene.h"
+#include "FileWriter.h"
 
-#include "thp_format.h"
 
-#include <sstream>
 #include <string>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 static constexpr const int SVG_STROKE_WIDTH = 3;
 
@@ -39,6 +43,10 @@ static struct {
 Stroke::Stroke(const Path &path)
     : m_rawPath(path)
     , m_body(nullptr)
+    , m_group(0)
+    , m_radius(0.0f)
+    , m_processed(false)
+    , m_mesh()
 {
     m_colour = NP::Colour::DEFAULT;
     m_attributes = 0;
@@ -49,6 +57,10 @@ Stroke::Stroke(const Path &path)
 
 Stroke::Stroke(const std::string &str)
     : m_body(nullptr)
+    , m_group(0)
+    , m_radius(0.0f)
+    , m_processed(false)
+    , m_mesh()
 {
     int col = 0;
     m_colour = NP::Colour::DEFAULT;
@@ -87,35 +99,78 @@ Stroke::Stroke(const std::string &str)
     setAttribute( ATTRIB_DUMMY );
 }
 
-Stroke::Stroke(const std::string &flags, const std::string &rgb, const std::string &svgpath)
-    : m_body(nullptr)
+Stroke::Stroke(int attributes, int colour, Path &&raw)
+    : m_rawPath(std::move(raw))
+    , m_colour(colour)
+    , m_attributes(0)
+    , m_body(nullptr)
+    , m_group(0)
+    , m_radius(0.0f)
+    , m_processed(false)
+    , m_mesh()
 {
-    m_colour = NP::Colour::DEFAULT;
-    m_attributes = 0;
-    m_origin = Vec2(400,240);
+    m_origin = m_rawPath.point(0);
+    m_rawPath.translate(-m_origin);
     reset();
+    setAttribute(Attribute(attributes));
+}
 
-    int r = 0, g = 0, b = 0;
-    if (sscanf(rgb.c_str(), "#%02x%02x%02x", &r, &g, &b) == 3) {
-        m_colour = (r & 0xff) << 16 | (g & 0xff) << 8 | (b & 0xff);
-    }
+Stroke::Stroke(int attributes, int colour, const Vec2 &origin, Path &&raw, Path &&shape)
+    : m_rawPath(std::move(raw))
+    , m_colour(colour)
+    , m_attributes(attributes)
+    , m_origin(origin)
+    , m_shapePath(std::move(shape))
+    , m_body(nullptr)
+    , m_group(0)
+    , m_radius(0.0f)
+    , m_processed(true)
+    , m_mesh()
+{
+    reset();
+}
 
-    std::map<std::string,Attribute> m;
-    for (auto &e: ATTRIBUTE_NAMES) {
-        m[e.name] = e.attribute;
-    }
+void *
+Stroke::operator new(size_t size, Arena &arena)
+{
+    return arena.allocate(size);
+}
 
-    std::istringstream iss(flags);
-    std::string flag;
-    while (getline(iss, flag, ' ')) {
-        setAttribute(m[flag]);
+int
+Stroke::parseClass(const char *begin, const char *end)
+{
+    int result = 0;
+
+    while (begin < end) {
+        const char *space = std::find(begin, end, ' ');
+        size_t len = space - begin;
+        for (auto &e: ATTRIBUTE_NAMES) {
+            if (strlen(e.name) == len && memcmp(e.name, begin, len) == 0) {
+                result |= e.attribute;
+                break;
+            }
+        }
+        begin = (space == end) ? end : space + 1;
     }
 
-    m_rawPath = Path::fromSVG(svgpath);
+    return result;
+}
 
-    m_origin = m_rawPath.point(0);
-    m_rawPath.translate(-m_origin);
-    setAttribute(ATTRIB_DUMMY);
+bool
+Stroke::parseColour(const char *begin, const char *end, int &colour)
+{
+    char rgb[16];
+    size_t len = std::min(size_t(end - begin), sizeof(rgb) - 1);
+    memcpy(rgb, begin, len);
+    rgb[len] = '\0';
+
+    int r = 0, g = 0, b = 0;
+    if (sscanf(rgb, "#%02x%02x%02x", &r, &g, &b) != 3) {
+        return false;
+    }
+
+    colour = (r & 0xff) << 16 | (g & 0xff) << 8 | (b & 0xff);
+    return true;
 }
 
 void
@@ -128,33 +183,29 @@ Stroke::reset(b2World *world)
     m_body = NULL;
     m_xformAngle = 7.0f;
     m_jointed[0] = m_jointed[1] = false;
-    m_shapePath = m_rawPath;
+    if ( !m_processed ) {
+        m_shapePath = m_rawPath;
+    }
     m_hide = 0;
+    m_radius = 0.0f;
 }
 
-std::string
-Stroke::asString()
+void
+Stroke::serialize(TextBuffer &out)
 {
-    std::stringstream classes;
+    out.append("<path class=\"");
     for (auto &e: ATTRIBUTE_NAMES) {
         if (hasAttribute(e.attribute)) {
-            classes << thp::format("%s ", e.name);
+            out.printf("%s ", e.name);
         }
     }
 
-    std::stringstream points;
-    Path opath = m_rawPath;
-    opath.translate(m_origin);
-    for (int i=0; i<opath.size(); i++) {
-        const Vec2& p = opath.point(i);
-        points << thp::format("%d %d", p.x, p.y);
-        if (i < opath.size() - 1) {
-            points << 'L';
-        }
+    out.printf("\" fill=\"none\" stroke=\"#%06x\" stroke-width=\"%d\" d=\"M", m_colour, SVG_STROKE_WIDTH);
+    for (int i=0; i<m_rawPath.size(); i++) {
+        Vec2 p = m_rawPath.point(i) + m_origin;
+        out.printf((i < m_rawPath.size() - 1) ? "%d %dL" : "%d %d", p.x, p.y);
     }
-
-    return thp::format("<path class=\"%s\" fill=\"none\" stroke=\"#%06x\" stroke-width=\"%d\" d=\"M%s\" />",
-                       classes.str().c_str(), m_colour, SVG_STROKE_WIDTH, points.str().c_str());
+    out.append("\" />\n");
 }
 
 void
@@ -200,11 +251,17 @@ Stroke::createBodies(b2World &world)
             bodyDef.isSleeping = true;
         }
         m_body = world.CreateBody( &bodyDef );
+        m_radius = 0.0f;
+        for ( int i=0; i<n; i++ ) {
+            b2Vec2 p = m_shapePath.point(i);
+            m_radius = b2Max( m_radius, p.Length() / PIXELS_PER_METREf );
+        }
         for ( int i=1; i<n; i++ ) {
             BoxDef boxDef;
             boxDef.init( m_shapePath.point(i-1),
                     m_shapePath.point(i),
-                    m_attributes );
+                    m_attributes,
+                    m_group );
             m_body->CreateShape( &boxDef );
         }
         m_body->SetMassFromShapes();
@@ -249,6 +306,20 @@ Stroke::join(b2World *world, Stroke *other, unsigned char end)
     }
 }
 
+void
+Stroke::setCollisionGroup(b2World *world, int16 group)
+{
+    m_group = group;
+    if ( m_body ) {
+        for ( b2Shape *s = m_body->GetShapeList(); s; s = s->GetNext() ) {
+            b2FilterData filter = s->GetFilterData();
+            filter.groupIndex = group;
+            s->SetFilterData( filter );
+            world->Refilter( s );
+        }
+    }
+}
+
 bool
 Stroke::maybeCreateJoint(b2World &world, Stroke *other)
 {
@@ -279,6 +350,15 @@ Stroke::maybeCreateJoint(b2World &world, Stroke *other)
     return true; ///nothing to do
 }
 
+void
+Stroke::simplify(float32 threshold)
+{
+    if (m_rawPath.size() > 2) {
+        m_rawPath.simplify(threshold);
+        m_mesh.reset();
+    }
+}
+
 void
 Stroke::draw(Canvas &canvas, int a)
 {
@@ -286,8 +366,23 @@ Stroke::draw(Canvas &canvas, int a)
         return;
     }
 
-    transform();
-    canvas.drawPath(m_screenPath, m_colour, a);
+    if (!m_hide && (m_body || hasAttribute(ATTRIB_DECOR))) {
+        // Tessellated once in body space, after that only the body
+        // transform changes from frame to frame
+        if (!m_mesh) {
+            m_mesh = canvas.tessellate(m_rawPath);
+        }
+
+        if (m_body) {
+            b2Vec2 pos = PIXELS_PER_METREf * m_body->GetPosition();
+            canvas.drawMesh(m_mesh, pos.x, pos.y, m_body->GetAngle(), m_colour, a);
+        } else {
+            canvas.drawMesh(m_mesh, m_origin.x, m_origin.y, 0.f, m_colour, a);
+        }
+    } else {
+        transform();
+        canvas.drawPath(m_screenPath, m_colour, a);
+    }
 
     if ( false /* drawJoints */ ) {
         int jointcolour = canvas.makeColour(0xff0000);
@@ -329,6 +424,8 @@ Stroke::addPoint(const Vec2 &pp)
     if ( p == m_rawPath.point( m_rawPath.numPoints()-1 ) ) {
     } else {
         m_rawPath.push_back( p );
+        m_processed = false;
+        m_mesh.reset();
     }
 }
 
@@ -375,6 +472,10 @@ Stroke::screenBbox()
 Rect
 Stroke::worldBbox()
 {
+    if (!m_hide) {
+        // Drawing doesn't keep the transformed path up to date
+        transform();
+    }
     return m_xformedPath.bbox();
 }
 
@@ -382,6 +483,9 @@ void
 Stroke::hide()
 {
     if ( m_hide==0 ) {
+        // draw() only keeps the screen path up to date while shrinking,
+        // so it starts from wherever the body is now
+        transform();
         m_hide = 1;
 
         if (m_body) {
@@ -399,6 +503,12 @@ Stroke::hidden()
     return m_hide >= HIDE_STEPS;
 }
 
+bool
+Stroke::hiding()
+{
+    return m_hide > 0 && m_hide < HIDE_STEPS;
+}
+
 int
 Stroke::numPoints()
 {
@@ -414,14 +524,20 @@ Stroke::endpt(unsigned char end)
 void
 Stroke::process()
 {
+    if ( m_processed ) {
+        return;
+    }
+
     float32 thresh = SIMPLIFY_THRESHOLDf;
     m_rawPath.simplify( thresh );
+    m_mesh.reset();
     m_shapePath = m_rawPath;
 
     while ( m_shapePath.numPoints() > MULTI_VERTEX_LIMIT ) {
         thresh += SIMPLIFY_THRESHOLDf;
         m_shapePath.simplify( thresh );
     }
+    m_processed = true;
 }
 
 bool
@@ -27,6 +27,8 @@
 
 class Stroke;
 class Scene;
+class Arena;
+class TextBuffer;
 
 enum Attribute {
   ATTRIB_DUMMY = 0,
@@ -44,6 +46,13 @@ enum Attribute {
   ATTRIB_UNJOINABLE = ATTRIB_DECOR | ATTRIB_HIDDEN | ATTRIB_DELETED,
 };
 
+// b2FilterData::categoryBits of stroke shapes
+enum CollisionCategory {
+  CATEGORY_STROKE = 0x0001,
+  CATEGORY_TOKEN = 0x0002,
+  CATEGORY_GOAL = 0x0004,
+};
+
 struct Joint {
     Joint(Stroke *joiner, Stroke *joinee, unsigned char end)
         : joiner(joiner)
@@ -70,13 +79,13 @@ struct JointDef : public b2RevoluteJointDef {
 struct BoxDef : public b2PolygonDef {
     float32 vec2Angle(b2Vec2 v) { return b2Atan2(v.y, v.x); }
 
-    void init(const Vec2 &p1, const Vec2 &p2, int attr)
+    void init(const Vec2 &p1, const Vec2 &p2, int attr, int16 group=0)
     {
         b2Vec2 barOrigin = p1;
         b2Vec2 bar = p2 - p1;
         bar *= 1.0f/PIXELS_PER_METREf;
         barOrigin *= 1.0f/PIXELS_PER_METREf;;
-        SetAsBox( bar.Length()/2.0f, 0.1f,
+        SetAsBox( bar.Length()/2.0f, STROKE_HALF_THICKNESSf,
                 0.5f*bar + barOrigin, vec2Angle( bar ));
         //      SetAsBox( bar.Length()/2.0f+b2_toiSlop, b2_toiSlop*2.0f,
         //	0.5f*bar + barOrigin, vec2Angle( bar ));
@@ -92,6 +101,16 @@ struct BoxDef : public b2PolygonDef {
             density = 5.0f;
         }
         restitution = 0.2f;
+
+        if (attr & ATTRIB_TOKEN) {
+            filter.categoryBits = CATEGORY_TOKEN;
+        } else if (attr & ATTRIB_GOAL) {
+            filter.categoryBits = CATEGORY_GOAL;
+        } else {
+            filter.categoryBits = CATEGORY_STROKE;
+        }
+        // negative: shapes in the same group never collide (rope chains)
+        filter.groupIndex = group;
     }
 };
 
@@ -99,10 +118,24 @@ class Stroke {
 public:
     Stroke(const Path &path);
     Stroke(const std::string &str);
-    Stroke(const std::string &flags, const std::string &rgb, const std::string &svgpath);
+    Stroke(int attributes, int colour, Path &&raw);
+    // Raw and shape path already simplified, as stored in compiled levels
+    Stroke(int attributes, int colour, const Vec2 &origin, Path &&raw, Path &&shape);
+
+    // Strokes live in the arena of their scene and are released together
+    // with it on level switch; delete only runs the destructor.
+    static void *operator new(size_t size, Arena &arena);
+    static void operator delete(void *p, Arena &arena) {}
+    static void operator delete(void *p) {}
 
     void reset(b2World *world=nullptr);
-    std::string asString();
+    // SVG path element, one line
+    void serialize(TextBuffer &out);
+
+    // Attributes from a space separated SVG class list ("token sleeping")
+    static int parseClass(const char *begin, const char *end);
+    // Colour from an SVG "#rrggbb" value
+    static bool parseColour(const char *begin, const char *end, int &colour);
 
     void setAttribute(Attribute a);
     void clearAttribute(Attribute a);
@@ -115,12 +148,17 @@ public:
     void determineJoints(Stroke *other, std::vector<Joint> &joints);
     void join(b2World *world, Stroke *other, unsigned char end);
     bool maybeCreateJoint(b2World &world, Stroke *other);
+    void setCollisionGroup(b2World *world, int16 group);
+    int16 collisionGroup() { return m_group; }
     void draw(Canvas &canvas, int a);
+    // Only for strokes without a body, the shape is not updated
+    void simplify(float32 threshold);
     std::list<Stroke *> ropeify(Scene &scene);
 
     void addPoint(const Vec2 &pp);
     void origin(const Vec2 &p);
     b2Body *body();
+    float32 radius() { return m_radius; }
 
     float32 distanceTo(const Vec2 &pt);
 
@@ -129,6 +167,8 @@ public:
 
     void hide();
     bool hidden();
+    // Shrinking away after hide(), until hidden()
+    bool hiding();
     int numPoints();
 
     const Vec2 &endpt(unsigned char end);
@@ -153,6 +193,12 @@ private:
     b2Body*   m_body;
     bool      m_jointed[2];
     int       m_hide;
+    int16     m_group;
+    float32   m_radius;
+    bool      m_processed;
+    NP::Mesh  m_mesh;
+
+    friend class BinaryLevel;
 };
 
 
@@ -0,0 +1,424 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "Thumbnails.h"
+#include "Assets.h"
+#include "BinaryLevel.h"
+#include "Config.h"
+#include "Scene.h"
+#include "Canvas.h"
+#include "Os.h"
+
+#include "thp_format.h"
+#include "petals_log.h"
+
+#include <cstdio>
+#include <algorithm>
+
+
+static const char *THUMBNAIL_DIR = "thumbnails";
+
+// "NPT1" when read back on a host with the same byte order
+static const uint32_t THUMB_MAGIC = 0x3154504e;
+// Has to be bumped whenever thumbnails are drawn differently
+static const uint32_t THUMB_VERSION = 2;
+
+// Stroke detail below this (in thumbnail pixels) is dropped
+static const float THUMB_SIMPLIFY_THRESHOLD = 0.5f;
+
+static const int ATLAS_SIZE = 1024;
+
+struct ThumbHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t w;
+    uint32_t h;
+};
+
+static std::string
+cacheFile(const std::string &dir, uint64_t key)
+{
+    return Config::joinPath(dir, thp::format("%016llx.thumb", (unsigned long long)key));
+}
+
+// FNV-1a
+static uint64_t
+hashContents(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i=0; i<size; i++) {
+        hash = (hash ^ uint8_t(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+
+Thumbnails::Thumbnails(Vec2 size)
+    : m_size(size)
+    , m_dir(cacheDir())
+    , m_generation(0)
+    , m_jobs()
+    , m_results()
+#if !defined(__EMSCRIPTEN__)
+    , m_mutex()
+    , m_wakeup()
+    , m_quit(false)
+    , m_thread(&Thumbnails::run, this)
+#endif
+{
+}
+
+Thumbnails::~Thumbnails()
+{
+#if !defined(__EMSCRIPTEN__)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+#else
+    for (auto &job: m_jobs) {
+        if (!job.pixels.empty()) {
+            save(m_dir, m_size, job.key, job.pixels);
+        }
+    }
+#endif
+}
+
+void
+Thumbnails::request(int id, const std::string &file)
+{
+#if !defined(__EMSCRIPTEN__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+    m_jobs.push_back(Job{m_generation, id, file, 0, {}});
+#if !defined(__EMSCRIPTEN__)
+    m_wakeup.notify_one();
+#endif
+}
+
+void
+Thumbnails::clear()
+{
+#if !defined(__EMSCRIPTEN__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+    m_generation++;
+    m_results.clear();
+
+    // Drawn thumbnails are still worth saving
+    m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [] (const Job &job) {
+        return job.pixels.empty();
+    }), m_jobs.end());
+}
+
+bool
+Thumbnails::next(Ready &ready)
+{
+#if !defined(__EMSCRIPTEN__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+#else
+    while (m_results.empty() && !m_jobs.empty()) {
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        process(job);
+    }
+#endif
+
+    if (m_results.empty()) {
+        return false;
+    }
+
+    ready = std::move(m_results.front());
+    m_results.pop_front();
+    return true;
+}
+
+void
+Thumbnails::store(uint64_t key, std::vector<unsigned char> &&pixels)
+{
+    Job job{m_generation, -1, "", key, std::move(pixels)};
+#if !defined(__EMSCRIPTEN__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+    m_wakeup.notify_one();
+#else
+    save(m_dir, m_size, job.key, job.pixels);
+#endif
+}
+
+#if !defined(__EMSCRIPTEN__)
+void
+Thumbnails::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wakeup.wait(lock, [this] () { return m_quit || !m_jobs.empty(); });
+        if (m_jobs.empty()) {
+            break;
+        }
+
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        if (m_quit && job.pixels.empty()) {
+            // Nobody is waiting for it anymore
+            continue;
+        }
+
+        lock.unlock();
+        process(job);
+        lock.lock();
+    }
+}
+#endif
+
+void
+Thumbnails::process(Job &job)
+{
+    if (!job.pixels.empty()) {
+        save(m_dir, m_size, job.key, job.pixels);
+        return;
+    }
+
+    Ready ready;
+    if (!load(job.file, m_dir, m_size, ready)) {
+        return;
+    }
+    ready.id = job.id;
+
+#if !defined(__EMSCRIPTEN__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+    if (job.generation == m_generation) {
+        m_results.push_back(std::move(ready));
+    }
+}
+
+std::string
+Thumbnails::cacheDir()
+{
+    return Config::userCacheFileName(THUMBNAIL_DIR);
+}
+
+bool
+Thumbnails::render(const std::string &file, const std::string &dir, Vec2 size,
+                   RenderTarget &target, bool &cached)
+{
+    Ready ready;
+    if (!load(file, dir, size, ready)) {
+        return false;
+    }
+
+    cached = !ready.scene;
+    if (cached) {
+        return true;
+    }
+
+    std::vector<unsigned char> pixels;
+    draw(*ready.scene, size, target, pixels);
+    return save(dir, size, ready.key, pixels);
+}
+
+bool
+Thumbnails::draw(const std::string &file, Vec2 size, RenderTarget &target,
+                 std::vector<unsigned char> &pixels)
+{
+    Asset data = Assets::open(file);
+    if (!data.valid()) {
+        return false;
+    }
+
+    std::unique_ptr<Scene> scene = parse(file, data, size);
+    if (!scene) {
+        return false;
+    }
+
+    draw(*scene, size, target, pixels);
+    return true;
+}
+
+void
+Thumbnails::draw(Scene &scene, Vec2 size, RenderTarget &target, std::vector<unsigned char> &pixels)
+{
+    target.begin();
+    scene.draw(target, true);
+    target.end();
+
+    pixels.resize(size.x * size.y * 4);
+    target.read(Rect(Vec2(0, 0), size), pixels.data());
+}
+
+bool
+Thumbnails::load(const std::string &file, const std::string &dir, Vec2 size, Ready &ready)
+{
+    Asset data = Assets::open(file);
+    if (!data.valid()) {
+        return false;
+    }
+
+    ready.key = hashContents(data.data(), data.size());
+
+    std::string filename = cacheFile(dir, ready.key);
+    if (FILE *fp = fopen(filename.c_str(), "rb")) {
+        ThumbHeader header;
+        size_t bytes = size.x * size.y * 4;
+        if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == THUMB_MAGIC &&
+                header.version == THUMB_VERSION && header.w == size.x && header.h == size.y) {
+            ready.pixels.resize(bytes);
+            if (fread(ready.pixels.data(), 1, bytes, fp) != bytes) {
+                ready.pixels.clear();
+            }
+        }
+        fclose(fp);
+
+        if (!ready.pixels.empty()) {
+            return true;
+        }
+    }
+
+    ready.scene = parse(file, data, size);
+    return bool(ready.scene);
+}
+
+std::unique_ptr<Scene>
+Thumbnails::parse(const std::string &file, const Asset &data, Vec2 size)
+{
+    std::unique_ptr<Scene> scene(new Scene(true));
+    bool ok;
+    if (BinaryLevel::isBinary(file)) {
+        ok = scene->loadBinary(data.data(), data.size());
+    } else {
+        ok = scene->load(data.data(), data.size());
+    }
+
+    if (!ok) {
+        LOG_WARNING("Cannot load thumbnail of %s", file.c_str());
+        return nullptr;
+    }
+
+    scene->simplify(THUMB_SIMPLIFY_THRESHOLD * WORLD_WIDTH / size.x);
+    return scene;
+}
+
+bool
+Thumbnails::save(const std::string &dir, Vec2 size, uint64_t key, const std::vector<unsigned char> &pixels)
+{
+    if (!OS->ensurePath(dir)) {
+        return false;
+    }
+
+    std::string filename = cacheFile(dir, key);
+    std::string tmpname = filename + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "wb");
+    if (!fp) {
+        LOG_WARNING("Cannot write thumbnail %s", tmpname.c_str());
+        return false;
+    }
+
+    ThumbHeader header{THUMB_MAGIC, THUMB_VERSION, uint32_t(size.x), uint32_t(size.y)};
+    bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1 &&
+               fwrite(pixels.data(), 1, pixels.size(), fp) == pixels.size());
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+#if defined(_WIN32)
+    remove(filename.c_str());
+#endif
+    if (!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LOG_WARNING("Cannot write thumbnail %s", filename.c_str());
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+ThumbnailAtlas::ThumbnailAtlas(Vec2 cell)
+    : m_cell(cell)
+    , m_columns(ATLAS_SIZE / cell.x)
+    , m_target(new RenderTarget(Vec2(ATLAS_SIZE, ATLAS_SIZE),
+                                Rect(Vec2(0, 0), Vec2(WORLD_WIDTH, WORLD_HEIGHT))))
+    , m_used(m_columns * (ATLAS_SIZE / cell.y), false)
+{
+}
+
+ThumbnailAtlas::~ThumbnailAtlas()
+{
+}
+
+int
+ThumbnailAtlas::allocate()
+{
+    auto it = std::find(m_used.begin(), m_used.end(), false);
+    if (it == m_used.end()) {
+        return -1;
+    }
+
+    *it = true;
+    return it - m_used.begin();
+}
+
+void
+ThumbnailAtlas::release(int cell)
+{
+    m_used[cell] = false;
+}
+
+void
+ThumbnailAtlas::clear()
+{
+    std::fill(m_used.begin(), m_used.end(), false);
+}
+
+void
+ThumbnailAtlas::draw(int cell, Scene &scene)
+{
+    m_target->begin(area(cell));
+    scene.draw(*m_target, true);
+    m_target->end();
+}
+
+void
+ThumbnailAtlas::draw(int cell, unsigned char *pixels)
+{
+    Image image(pixels, m_cell.x, m_cell.y);
+    Rect source(Vec2(0, 0), m_cell);
+
+    m_target->begin(area(cell));
+    m_target->drawAtlas(image, source, Rect(Vec2(0, 0), Vec2(WORLD_WIDTH, WORLD_HEIGHT)));
+    m_target->end();
+}
+
+void
+ThumbnailAtlas::read(int cell, unsigned char *pixels)
+{
+    m_target->read(area(cell), pixels);
+}
+
+Image *
+ThumbnailAtlas::image(int cell)
+{
+    return new Image(m_target->contents(), area(cell));
+}
+
+Rect
+ThumbnailAtlas::area(int cell) const
+{
+    Vec2 tl(m_cell.x * (cell % m_columns), m_cell.y * (cell / m_columns));
+    return Rect(tl, tl + m_cell);
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is part of NumptyPhysics <http://thp.io/2015/numptyphysics/>
+ * Coyright (c) 2014 Thomas Perl <m@thp.io>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NUMPTYPHYSICS_THUMBNAILS_H
+#define NUMPTYPHYSICS_THUMBNAILS_H
+
+#include "Common.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+class Scene;
+class Asset;
+class Image;
+class RenderTarget;
+
+
+/**
+ * Level thumbnails for the level selector
+ *
+ * Levels are read, hashed and parsed on a worker thread; the UI thread
+ * picks up the results with next() and only has to upload pixels or
+ * draw an already loaded scene. Drawn thumbnails are handed back with
+ * store() and written to the user cache, keyed by a hash of the level
+ * file contents, so the next request for an unchanged level is a plain
+ * file read. Without threads (emscripten) the work is done in next().
+ **/
+class Thumbnails {
+public:
+    struct Ready {
+        Ready() : id(0), key(0), pixels(), scene() {}
+
+        int id;
+        uint64_t key;
+        // Cached RGBA pixels, or empty if scene still has to be drawn
+        std::vector<unsigned char> pixels;
+        std::unique_ptr<Scene> scene;
+    };
+
+    Thumbnails(Vec2 size);
+    ~Thumbnails();
+
+    Vec2 size() const { return m_size; }
+
+    void request(int id, const std::string &file);
+    // Drops all pending requests and results
+    void clear();
+
+    // false if nothing is ready (yet)
+    bool next(Ready &ready);
+    void store(uint64_t key, std::vector<unsigned char> &&pixels);
+
+    // Where the level selector looks for cached thumbnails
+    static std::string cacheDir();
+    // Draws the thumbnail of file into target (of the given size, covering
+    // the world) and stores it in the cache in dir, unless it is cached
+    // already; for filling the cache without a window
+    static bool render(const std::string &file, const std::string &dir, Vec2 size,
+                       RenderTarget &target, bool &cached);
+    // Draws the thumbnail of file like render(), but reads it back into
+    // pixels instead of going through the cache; for checking renderers
+    static bool draw(const std::string &file, Vec2 size, RenderTarget &target,
+                     std::vector<unsigned char> &pixels);
+
+private:
+    struct Job {
+        int generation;
+        int id;
+        std::string file;
+        uint64_t key;
+        std::vector<unsigned char> pixels;
+    };
+
+    void run();
+    void process(Job &job);
+    static bool load(const std::string &file, const std::string &dir, Vec2 size, Ready &ready);
+    static std::unique_ptr<Scene> parse(const std::string &file, const Asset &data, Vec2 size);
+    static void draw(Scene &scene, Vec2 size, RenderTarget &target, std::vector<unsigned char> &pixels);
+    static bool save(const std::string &dir, Vec2 size, uint64_t key, const std::vector<unsigned char> &pixels);
+
+    Vec2 m_size;
+    std::string m_dir;
+    int m_generation;
+    std::deque<Job> m_jobs;
+    std::deque<Ready> m_results;
+
+#if !defined(__EMSCRIPTEN__)
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_quit;
+    std::thread m_thread;
+#endif
+};
+
+
+/**
+ * Single texture holding the thumbnails currently on display
+ *
+ * The render target is split into cells of thumbnail size. Scenes are
+ * drawn straight into a free cell, cached pixels are copied there, and
+ * images handed out are views of their cell. Cells are reused once
+ * released, so the atlas never grows.
+ **/
+class ThumbnailAtlas {
+public:
+    ThumbnailAtlas(Vec2 cell);
+    ~ThumbnailAtlas();
+
+    // -1 if all cells are in use
+    int allocate();
+    void release(int cell);
+    void clear();
+
+    void draw(int cell, Scene &scene);
+    void draw(int cell, unsigned char *pixels);
+    // RGBA, as accepted by draw()
+    void read(int cell, unsigned char *pixels);
+
+    Image *image(int cell);
+
+private:
+    Rect area(int cell) const;
+
+    Vec2 m_cell;
+    int m_columns;
+    std::unique_ptr<RenderTarget> m_target;
+    std::vector<bool> m_used;
+};
+
+#endif /* NUMPTYPHYSICS_THUMBNAILS_H */
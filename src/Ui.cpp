@@ -64,7 +64,8 @@ Widget::Widget(WidgetParent *p)
     m_targetPos(0, 0),
     m_animating(false),
     m_animation_done([](){}),
-    m_visible(true)
+    m_visible(true),
+    m_dirty(true)
 {}
 
 std::string Widget::toString()
@@ -84,12 +85,14 @@ void Widget::move( const Vec2& by )
 {
   m_pos.tl+=by;
   m_pos.br+=by;
+  dirty();
 }
 
 void Widget::sizeTo( const Vec2& size )
 {
   m_pos.br=m_pos.tl+size;  
   onResize();
+  dirty();
 }
 
 bool Widget::processEvent(ToolkitEvent &ev)
@@ -156,6 +159,16 @@ void Widget::onTick(int tick)
 }
 
 
+void Widget::dirty()
+{
+  Widget* w = this;
+  while (w->m_parent) {
+    w = w->m_parent;
+  }
+  w->m_dirty = true;
+}
+
+
 WidgetParent* Widget::topLevel()
 {
   WidgetParent* p = parent();
@@ -188,6 +201,7 @@ Label::Label(const Tr& s, const Font* f, int color)
 void Label::text( const Tr& s )
 {
     m_tr = s;
+    dirty();
 }
 
 void Label::draw( Canvas& screen, const Rect& area )
@@ -319,6 +333,7 @@ void Icon::image(Image *image)
 {
     delete m_image;
     m_image = image;
+    dirty();
 }
 
 void Icon::draw(Canvas &screen, const Rect &area)
@@ -411,6 +426,7 @@ void IconButton::image(Image *image, bool takeOwnership)
     } else {
         m_icon = new Image(*image);
     }
+    dirty();
 }
 
 Image* IconButton::image()
@@ -422,6 +438,7 @@ void IconButton::icon(const std::string& icon)
 {
     delete m_icon;
     m_icon = new Image(icon);
+    dirty();
 }
 
 void IconButton::draw( Canvas& screen, const Rect& area )
@@ -933,6 +950,7 @@ void Container::add( Widget* w, int x, int y )
   w->setParent(this);
   m_children.push_back(w);
   onResize();
+  dirty();
 }
 
 void Container::remove( Widget* w )
@@ -946,6 +964,7 @@ void Container::remove( Widget* w )
         w->setParent(nullptr);
         m_children.erase(it);
         delete w;
+        dirty();
     }
 }
 
@@ -1102,6 +1121,7 @@ void TabBook::selectTab( int t )
     m_tabs[m_selected]->setBg(NP::Colour::DEFAULT_BG);
     m_children.erase(std::find(m_children.begin(), m_children.end(), m_contents));
     m_contents = NULL;
+    dirty();
   }
   if ( t>=0 && t<m_count ) {
     m_selected = t;
@@ -1117,6 +1137,10 @@ void TabBook::selectTab( int t )
 
 
 Dialog::Dialog( const Tr &title, Event left, Event right )
+  : m_backdrop(nullptr)
+  , m_backdropImage(nullptr)
+  , m_backdropVersion(0)
+  , m_backdropPos()
 {
   setEventMap(UI_DIALOG_MAP);
   setFg(0x000000);
@@ -1178,22 +1202,52 @@ bool Dialog::onEvent( Event& ev )
 }
 
 
-void Dialog::draw(Canvas &screen, const Rect &area)
+Dialog::~Dialog()
 {
-    Window *window = dynamic_cast<Window *>(&screen);
-    if (window) {
-        auto fb_size = m_pos.size() / 2;
-        auto world_rect = Rect(Vec2(0, 0), fb_size);
-        RenderTarget tmp(fb_size, world_rect);
-        tmp.begin();
+    delete m_backdropImage;
+    delete m_backdrop;
+}
 
-        Image *offscreen = window->offscreen();
-        tmp.drawBlur(*offscreen, m_pos, world_rect, 0.0, 0.7);
+void Dialog::updateBackdrop(Image &offscreen, unsigned version)
+{
+    if (m_backdrop && version == m_backdropVersion &&
+            m_pos.tl == m_backdropPos.tl && m_pos.br == m_backdropPos.br) {
+        return;
+    }
+
+    // Each halving averages 2x2 texels (bilinear filtering), which after
+    // stretching back up looks about as soft as the separable blur did
+    Vec2 half = m_pos.size() / 2;
+    Vec2 quarter = half / 2;
+    if (!m_backdrop || m_pos.size() != m_backdropPos.size()) {
+        delete m_backdropImage;
+        delete m_backdrop;
+        m_backdrop = new RenderTarget(quarter, Rect(Vec2(0, 0), quarter));
+        m_backdropImage = new Image(m_backdrop->contents());
+    }
+
+    RenderTarget tmp(half, Rect(Vec2(0, 0), half));
+    tmp.begin();
+    tmp.drawAtlas(offscreen, m_pos, Rect(Vec2(0, 0), half));
+    tmp.end();
+
+    Image image(tmp.contents());
+    m_backdrop->begin();
+    m_backdrop->drawAtlas(image, Rect(Vec2(0, 0), half), Rect(Vec2(0, 0), quarter));
+    m_backdrop->end();
 
-        tmp.end();
+    m_backdropVersion = version;
+    m_backdropPos = m_pos;
+}
 
-        Image image(tmp.contents());
-        screen.drawBlur(image, world_rect, m_pos, 0.7, 0.0);
+void Dialog::draw(Canvas &screen, const Rect &area)
+{
+    Window *window = dynamic_cast<Window *>(&screen);
+    if (window) {
+        // Only redone when the scene behind or the dialog moved
+        updateBackdrop(*window->offscreen(), window->offscreenVersion());
+        Rect src(0, 0, m_backdrop->width(), m_backdrop->height());
+        screen.drawAtlas(*m_backdropImage, src, m_pos);
     } else {
         screen.drawRect(area, 0xff0000);
     }
@@ -27,6 +27,7 @@
 
 class Canvas;
 class Image;
+class RenderTarget;
 class Widget;
 class Font;
 
@@ -84,16 +85,21 @@ class Widget
   void setEventMap(EventMapType map);
 
   Rect& position() { return m_pos; }
-  void setBg(int bg) {m_bg=bg;}
-  void setFg(int fg) {m_fg=fg;}
+  void setBg(int bg) {m_bg=bg; dirty();}
+  void setFg(int fg) {m_fg=fg; dirty();}
   void fitToParent(bool fit) { m_fitToParent=fit;}
   bool fitToParent() {return m_fitToParent;}
   bool greedyMouse() {return m_greedyMouse;}
-  void transparent(bool t) {m_alpha=t?0:255;}
-  void alpha(int a) {m_alpha=a;}
-  void border(bool drawBorder) {m_border = drawBorder?1:0;}
-  void show() { m_visible = true; }
-  void hide() { m_visible = false; }
+  void transparent(bool t) {m_alpha=t?0:255; dirty();}
+  void alpha(int a) {m_alpha=a; dirty();}
+  void border(bool drawBorder) {m_border = drawBorder?1:0; dirty();}
+  void show() { m_visible = true; dirty(); }
+  void hide() { m_visible = false; dirty(); }
+
+  // Something visible changed, the top level widget has to be drawn again
+  void dirty();
+  bool isDirty() const { return m_dirty; }
+  void clean() { m_dirty = false; }
 
   int width() { return m_pos.width(); }
   int height() { return m_pos.height(); }
@@ -113,6 +119,7 @@ class Widget
   bool          m_animating;
   std::function<void()> m_animation_done;
   bool          m_visible;
+  bool          m_dirty;
 };
 
 class Spacer : public Widget {
@@ -128,7 +135,7 @@ class Label : public Widget
   virtual void text( const Tr& s );
   //const std::string& text() const { return m_text; }
   virtual void draw( Canvas& screen, const Rect& area );
-  void font( const Font* f ) { m_font = f; }
+  void font( const Font* f ) { m_font = f; dirty(); }
 
   enum Alignment {
       ALIGN_CENTER = 0,
@@ -204,7 +211,7 @@ class StockIconButton : public Button {
   StockIconButton(const Tr &label, enum StockIcon::Kind icon, const Event &ev);
   ~StockIconButton();
   void align(int dir) { m_vertical = (dir == 0); }
-  void set(enum StockIcon::Kind icon) { m_icon = icon; }
+  void set(enum StockIcon::Kind icon) { m_icon = icon; dirty(); }
 
   const char *name() { return "StockIconButton"; }
   void draw(Canvas &screen, const Rect &area);
@@ -386,6 +393,7 @@ class Dialog : public Panel
 {
  public:
   Dialog( const Tr &title, Event left=Event::NOP, Event right=Event::NOP );
+  ~Dialog();
   const char* name() {return "Dialog";}
   void onTick( int tick );
   bool processEvent(ToolkitEvent &ev);
@@ -400,6 +408,13 @@ class Dialog : public Panel
   Button *m_left, *m_right;
   Container *m_content;
   bool m_closeRequested;
+ private:
+  void updateBackdrop(Image &offscreen, unsigned version);
+  // Blurred copy of what is behind the dialog, at a quarter of its size
+  RenderTarget *m_backdrop;
+  Image *m_backdropImage;
+  unsigned m_backdropVersion;
+  Rect m_backdropPos;
 };
 
 class MenuDialog : public Dialog, public virtual Menu